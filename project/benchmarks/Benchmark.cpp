@@ -0,0 +1,290 @@
+//Deterministic frame time benchmark
+//Renders every scene headless with a fixed camera and fixed time steps, then reports
+//mean/median/p95/p99 frame time, rays per second and peak memory as JSON
+//Peak memory is reported per scene where the high-water mark can be reset (Linux) and for the whole process
+
+//Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+//Project includes
+#include "../src/CommandLine.h"
+#include "../src/Renderer.h"
+#include "../src/Scene.h"
+#include "../src/Timer.h"
+#include "../src/Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	struct BenchmarkSettings
+	{
+		int width{ 640 };
+		int height{ 480 };
+		int frames{ 60 };
+		int warmupFrames{ 5 };
+		float timeStep{ 1.f / 60.f };
+		uint32_t threadCount{ 0 };
+		bool wavefront{ false };
+		float resolutionScale{ 1.f }; //fixed, dynamic resolution would make runs incomparable
+		Renderer::AntiAliasingMode antiAliasing{ Renderer::AntiAliasingMode::Off };
+		Tonemapper tonemapper{ Tonemapper::Clamp };
+		bool isSRGB{ false };
+		std::string outputPath{ "benchmark.json" };
+		std::vector<std::string> sceneNames{ "W1", "W2", "W3", "W4", "ReferenceScene", "BunnyScene" };
+	};
+
+	struct SceneResult
+	{
+		std::string sceneName{};
+		double meanMs{};
+		double medianMs{};
+		double p95Ms{};
+		double p99Ms{};
+		double raysPerSecond{};
+		double peakMemoryMB{}; //since just before the scene was created, only valid with hasPeakMemory
+		bool hasPeakMemory{};
+		double shadowCacheHitRate{};
+		double samplesPerPixel{};
+		uint32_t threadCount{};
+	};
+
+	//Starts a new high-water mark of resident memory, so the next scene does not inherit the peak of an earlier one
+	//False where the mark cannot be reset and GetPeakMemoryMB stays a value for the whole process
+	bool ResetPeakMemory()
+	{
+#if defined(__linux__)
+		// 5 resets VmHWM to the current resident set size
+		std::ofstream clearRefs{ "/proc/self/clear_refs" };
+		clearRefs << "5";
+		clearRefs.flush();
+		return static_cast<bool>(clearRefs);
+#else
+		// Windows has no way to reset PeakWorkingSetSize
+		return false;
+#endif
+	}
+
+	//Peak resident memory since the last ResetPeakMemory, or of the whole process
+	double GetPeakMemoryMB()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return double(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+		return 0.0;
+#else
+	#if defined(__linux__)
+		// ru_maxrss does not follow a reset, VmHWM does
+		std::ifstream status{ "/proc/self/status" };
+		std::string line{};
+		while (std::getline(status, line))
+		{
+			if (line.rfind("VmHWM:", 0) == 0)
+				return std::strtod(line.c_str() + 6, nullptr) / 1024.0; // kilobytes
+		}
+	#endif
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return double(usage.ru_maxrss) / 1024.0; // kilobytes on Linux
+#endif
+	}
+
+	//Nearest rank percentile, frameTimes has to be sorted
+	double Percentile(const std::vector<double>& frameTimes, double percentile)
+	{
+		const size_t rank{ static_cast<size_t>(std::ceil(percentile / 100.0 * double(frameTimes.size()))) };
+		return frameTimes[std::clamp(rank, size_t{ 1 }, frameTimes.size()) - 1];
+	}
+
+	bool RunScene(const std::string& sceneName, const BenchmarkSettings& settings, SceneResult& result)
+	{
+		// loading the scene counts towards its peak
+		result.hasPeakMemory = ResetPeakMemory();
+
+		Scene* pScene{ CreateScene(sceneName) };
+		if (!pScene)
+		{
+			std::cerr << "Unknown scene: " << sceneName << std::endl;
+			return false;
+		}
+
+		pScene->Initialize();
+		pScene->GetCamera().isInputEnabled = false;
+
+		Timer timer{};
+		timer.SetFixedTimeStep(settings.timeStep);
+		timer.Start();
+
+		Renderer renderer{ settings.width, settings.height };
+		if (settings.threadCount != 0)
+			renderer.SetThreadCount(settings.threadCount);
+		renderer.SetWavefrontEnabled(settings.wavefront);
+		renderer.SetResolutionScale(settings.resolutionScale);
+		renderer.SetAntiAliasingMode(settings.antiAliasing);
+		renderer.SetTonemapper(settings.tonemapper);
+		renderer.SetSRGBEnabled(settings.isSRGB);
+
+		std::vector<double> frameTimes{};
+		frameTimes.reserve(settings.frames);
+
+		for (int frame{}; frame < settings.warmupFrames + settings.frames; ++frame)
+		{
+			if (frame == settings.warmupFrames)
+				renderer.ResetRayCount();
+
+			// scene updates (animation, refits) are part of a frame
+			const auto frameStart{ std::chrono::steady_clock::now() };
+			pScene->Update(&timer);
+			renderer.Render(pScene);
+			const auto frameEnd{ std::chrono::steady_clock::now() };
+
+			timer.Update();
+
+			if (frame >= settings.warmupFrames)
+				frameTimes.emplace_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+		}
+
+		const double totalMs{ std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) };
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		result.sceneName = sceneName;
+		result.meanMs = totalMs / double(frameTimes.size());
+		result.medianMs = Percentile(frameTimes, 50.0);
+		result.p95Ms = Percentile(frameTimes, 95.0);
+		result.p99Ms = Percentile(frameTimes, 99.0);
+		result.raysPerSecond = double(renderer.GetRayCount()) / (totalMs / 1000.0);
+		result.peakMemoryMB = GetPeakMemoryMB();
+		result.shadowCacheHitRate = renderer.GetShadowCacheHitRate();
+		const double pixelCount{ double(renderer.GetRenderWidth()) * double(renderer.GetRenderHeight()) * double(settings.frames) };
+		result.samplesPerPixel = 1.0 + double(renderer.GetSupersampleCount()) / pixelCount;
+		result.threadCount = renderer.GetThreadCount();
+
+		delete pScene;
+		return true;
+	}
+
+	void WriteJson(std::ostream& stream, const BenchmarkSettings& settings, const std::vector<SceneResult>& results, double peakMemoryMB)
+	{
+		stream << "{\n";
+		stream << "  \"width\": " << settings.width << ",\n";
+		stream << "  \"height\": " << settings.height << ",\n";
+		stream << "  \"frames\": " << settings.frames << ",\n";
+		stream << "  \"warmupFrames\": " << settings.warmupFrames << ",\n";
+		stream << "  \"timeStep\": " << settings.timeStep << ",\n";
+		stream << "  \"threads\": " << results.front().threadCount << ",\n";
+		stream << "  \"mode\": \"" << (settings.wavefront ? "wavefront" : "tiles") << "\",\n";
+		stream << "  \"simd\": \"" << GetSIMDLevelName(GeometryUtils::GetSIMDLevel()) << "\",\n";
+		stream << "  \"resolutionScale\": " << settings.resolutionScale << ",\n";
+		stream << "  \"antiAliasing\": \"" << Renderer::GetAntiAliasingModeName(settings.antiAliasing) << "\",\n";
+		stream << "  \"tonemapper\": \"" << GetTonemapperName(settings.tonemapper) << "\",\n";
+		stream << "  \"srgb\": " << (settings.isSRGB ? "true" : "false") << ",\n";
+		stream << "  \"peakMemoryMB\": " << peakMemoryMB << ",\n";
+		stream << "  \"scenes\": [\n";
+
+		for (size_t i{}; i < results.size(); ++i)
+		{
+			const SceneResult& result{ results[i] };
+			stream << "    {\n";
+			stream << "      \"name\": \"" << result.sceneName << "\",\n";
+			stream << "      \"meanMs\": " << result.meanMs << ",\n";
+			stream << "      \"medianMs\": " << result.medianMs << ",\n";
+			stream << "      \"p95Ms\": " << result.p95Ms << ",\n";
+			stream << "      \"p99Ms\": " << result.p99Ms << ",\n";
+			stream << "      \"raysPerSecond\": " << result.raysPerSecond << ",\n";
+			// where the high-water mark cannot be reset only the top level value is meaningful
+			if (result.hasPeakMemory)
+				stream << "      \"peakMemoryMB\": " << result.peakMemoryMB << ",\n";
+			else
+				stream << "      \"peakMemoryMB\": null,\n";
+			stream << "      \"shadowCacheHitRate\": " << result.shadowCacheHitRate << ",\n";
+			stream << "      \"samplesPerPixel\": " << result.samplesPerPixel << "\n";
+			stream << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+
+		stream << "  ]\n";
+		stream << "}\n";
+	}
+}
+
+int main(int argc, char* args[])
+{
+	BenchmarkSettings settings{};
+	// levels the CPU lacks fall back to a narrower one, the JSON reports the one used
+	SIMDLevel simdLevel{};
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		if (argument == "--width" && hasValue && ParseArgument(args[++i], 1, settings.width)) continue;
+		else if (argument == "--height" && hasValue && ParseArgument(args[++i], 1, settings.height)) continue;
+		else if (argument == "--frames" && hasValue && ParseArgument(args[++i], 1, settings.frames)) continue;
+		else if (argument == "--warmup" && hasValue && ParseArgument(args[++i], 0, settings.warmupFrames)) continue;
+		else if (argument == "--timestep" && hasValue && ParseArgument(args[++i], 0.f, settings.timeStep)) continue;
+		else if (argument == "--threads" && hasValue && ParseArgument(args[++i], 0u, settings.threadCount)) continue;
+		else if (argument == "--wavefront") settings.wavefront = true;
+		else if (argument == "--scene" && hasValue) settings.sceneNames = { args[++i] };
+		else if (argument == "--output" && hasValue) settings.outputPath = args[++i];
+		else if (argument == "--scale" && hasValue && ParseArgument(args[++i], 0.f, settings.resolutionScale)) continue;
+		else if (argument == "--aa" && hasValue) settings.antiAliasing = Renderer::ParseAntiAliasingMode(args[++i]);
+		else if (argument == "--simd" && hasValue && ParseSIMDLevel(args[++i], simdLevel)) GeometryUtils::SetSIMDLevel(simdLevel);
+		else if (argument == "--tonemap" && hasValue) settings.tonemapper = ParseTonemapper(args[++i]);
+		else if (argument == "--srgb") settings.isSRGB = true;
+		else
+		{
+			// unknown options, values that do not parse and numbers out of range
+			std::cerr << "Usage: " << args[0] << " [--width 640] [--height 480] [--frames 60] [--warmup 5] [--timestep 0.0166]"
+				<< " [--threads 0] [--wavefront] [--scene name] [--output benchmark.json] [--aa off|adaptive|full] [--simd scalar|sse|avx2]"
+				<< " [--scale 1] [--tonemap clamp|reinhard|aces] [--srgb]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<SceneResult> results{};
+
+	for (const std::string& sceneName : settings.sceneNames)
+	{
+		std::cerr << "Benchmarking " << sceneName << "..." << std::endl;
+
+		SceneResult result{};
+		if (!RunScene(sceneName, settings, result))
+			return 1;
+
+		results.emplace_back(result);
+	}
+
+	// every reset lowers the mark, so the process peak is the highest one seen
+	double peakMemoryMB{ GetPeakMemoryMB() };
+	for (const SceneResult& result : results)
+		peakMemoryMB = std::max(peakMemoryMB, result.peakMemoryMB);
+
+	WriteJson(std::cout, settings, results, peakMemoryMB);
+
+	std::ofstream file{ settings.outputPath };
+	if (!file)
+	{
+		std::cerr << "Could not write " << settings.outputPath << std::endl;
+		return 1;
+	}
+	WriteJson(file, settings, results, peakMemoryMB);
+
+	return 0;
+}
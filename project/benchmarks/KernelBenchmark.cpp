@@ -0,0 +1,320 @@
+//Intersection kernel microbenchmark
+//Times every GeometryUtils hit test in isolation on reproducible random rays, split in hit, miss and grazing cases,
+//and reports ns per test and tests per second so changes to Utils.h can be compared run to run
+
+//Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "../src/CommandLine.h"
+#include "../src/Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	struct KernelSettings
+	{
+		uint32_t seed{ 1337 };
+		uint32_t rayCount{ 1 << 16 };
+		uint32_t repeats{ 7 };
+		std::string filter{};
+	};
+
+	enum class RayCase
+	{
+		Hit,
+		Miss,
+		Grazing
+	};
+
+	const char* GetCaseName(RayCase rayCase)
+	{
+		switch (rayCase)
+		{
+		case RayCase::Hit: return "hit";
+		case RayCase::Miss: return "miss";
+		default: return "grazing";
+		}
+	}
+
+	//Any unit vector perpendicular to direction
+	Vector3 GetPerpendicular(const Vector3& direction, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> component{ -1.f, 1.f };
+
+		Vector3 perpendicular{};
+		do
+		{
+			const Vector3 candidate{ component(rng), component(rng), component(rng) };
+			perpendicular = Vector3::Cross(direction, candidate);
+		} while (perpendicular.SqrMagnitude() < 1e-4f);
+
+		return perpendicular.Normalized();
+	}
+
+	//Rays from a shell around center that pass it at a distance picked by the case, relative to radius
+	//Works for anything roughly round: spheres, and the bounds and silhouette of a mesh
+	std::vector<Ray> CreateRaysAroundCenter(const Vector3& center, float radius, RayCase rayCase, uint32_t rayCount, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> component{ -1.f, 1.f };
+		std::uniform_real_distribution<float> shell{ 4.f * radius, 10.f * radius };
+		std::uniform_real_distribution<float> hitDistance{ 0.f, .9f * radius };
+		std::uniform_real_distribution<float> missDistance{ 1.8f * radius, 3.f * radius };
+		std::uniform_real_distribution<float> grazingDistance{ .995f * radius, 1.005f * radius };
+
+		std::vector<Ray> rays(rayCount);
+		for (Ray& ray : rays)
+		{
+			Vector3 offset{};
+			do
+			{
+				offset = { component(rng), component(rng), component(rng) };
+			} while (offset.SqrMagnitude() < 1e-4f);
+
+			// aim along the direction towards center, then shift sideways so the ray passes exactly at distance
+			const Vector3 direction{ -offset.Normalized() };
+
+			float distance{};
+			switch (rayCase)
+			{
+			case RayCase::Hit: distance = hitDistance(rng); break;
+			case RayCase::Miss: distance = missDistance(rng); break;
+			case RayCase::Grazing: distance = grazingDistance(rng); break;
+			}
+
+			ray.origin = center - direction * shell(rng) + GetPerpendicular(direction, rng) * distance;
+			ray.direction = direction;
+		}
+		return rays;
+	}
+
+	//Rays from above a y-up plane, heading into it, away from it or nearly parallel to it
+	std::vector<Ray> CreatePlaneRays(RayCase rayCase, uint32_t rayCount, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> horizontal{ -10.f, 10.f };
+		std::uniform_real_distribution<float> height{ 1.f, 5.f };
+		std::uniform_real_distribution<float> steep{ .2f, 1.f };
+		std::uniform_real_distribution<float> shallow{ -1e-3f, 1e-3f };
+
+		std::vector<Ray> rays(rayCount);
+		for (Ray& ray : rays)
+		{
+			ray.origin = { horizontal(rng), height(rng), horizontal(rng) };
+
+			float y{};
+			switch (rayCase)
+			{
+			case RayCase::Hit: y = -steep(rng); break;
+			case RayCase::Miss: y = steep(rng); break;
+			case RayCase::Grazing: y = shallow(rng); break;
+			}
+
+			ray.direction = Vector3{ horizontal(rng), y * 10.f, horizontal(rng) }.Normalized();
+		}
+		return rays;
+	}
+
+	//Rays from in front of a triangle aimed at its inside, past one of its edges, or right onto an edge
+	std::vector<Ray> CreateTriangleRays(const Triangle& triangle, RayCase rayCase, uint32_t rayCount, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+		std::uniform_real_distribution<float> jitter{ -2.f, 2.f };
+		std::uniform_real_distribution<float> outside{ -1.f, -.1f };
+		std::uniform_real_distribution<float> onEdge{ -1e-4f, 1e-4f };
+		std::uniform_int_distribution<int> edge{ 0, 2 };
+
+		std::vector<Ray> rays(rayCount);
+		for (Ray& ray : rays)
+		{
+			// barycentric coordinates, inside the triangle when all of them are positive
+			float weights[3]{};
+			do
+			{
+				weights[0] = unit(rng);
+				weights[1] = unit(rng);
+			} while (weights[0] + weights[1] > .9f);
+			weights[0] += .05f;
+			weights[1] += .05f;
+			weights[2] = 1.f - weights[0] - weights[1];
+
+			if (rayCase != RayCase::Hit)
+			{
+				const int edgeIndex{ edge(rng) };
+				const float edgeWeight{ rayCase == RayCase::Miss ? outside(rng) : onEdge(rng) };
+				const float rest{ weights[(edgeIndex + 1) % 3] + weights[(edgeIndex + 2) % 3] };
+
+				weights[(edgeIndex + 1) % 3] *= (1.f - edgeWeight) / rest;
+				weights[(edgeIndex + 2) % 3] *= (1.f - edgeWeight) / rest;
+				weights[edgeIndex] = edgeWeight;
+			}
+
+			const Vector3 target{ triangle.v0 * weights[0] + triangle.v1 * weights[1] + triangle.v2 * weights[2] };
+			ray.origin = target - triangle.normal * 5.f + Vector3{ jitter(rng), jitter(rng), 0.f };
+			ray.direction = (target - ray.origin).Normalized();
+		}
+		return rays;
+	}
+
+	//Closed UV sphere, about the triangle count of the bunny
+	TriangleMesh CreateSphereMesh(uint32_t rings, uint32_t segments)
+	{
+		std::vector<Vector3> positions{};
+		std::vector<int> indices{};
+
+		for (uint32_t ring{}; ring <= rings; ++ring)
+		{
+			const float theta{ PI * float(ring) / float(rings) };
+			for (uint32_t segment{}; segment <= segments; ++segment)
+			{
+				const float phi{ PI_2 * float(segment) / float(segments) };
+				positions.emplace_back(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			}
+		}
+
+		for (uint32_t ring{}; ring < rings; ++ring)
+		{
+			for (uint32_t segment{}; segment < segments; ++segment)
+			{
+				const int first{ static_cast<int>(ring * (segments + 1) + segment) };
+				const int second{ first + static_cast<int>(segments) + 1 };
+
+				indices.insert(indices.end(), { first, second, first + 1 });
+				indices.insert(indices.end(), { second, second + 1, first + 1 });
+			}
+		}
+
+		TriangleMesh mesh{ positions, indices, TriangleCullMode::NoCulling };
+		mesh.UpdateAABB();
+		mesh.UpdateTransforms();
+		return mesh;
+	}
+
+	struct KernelResult
+	{
+		std::string kernelName{};
+		RayCase rayCase{};
+		double nsPerTest{};
+		double hitRate{};
+	};
+
+	//Median of several timed passes over the same rays, one pass first to warm up the caches
+	//The kernel is a template argument so the call inlines, as it does in the renderer
+	template<typename Kernel>
+	KernelResult RunKernel(const std::string& kernelName, RayCase rayCase, const std::vector<Ray>& rays, const Kernel& kernel, const KernelSettings& settings)
+	{
+		uint32_t hitCount{};
+		for (const Ray& ray : rays)
+			hitCount += kernel(ray);
+
+		std::vector<double> passTimes{};
+		for (uint32_t repeat{}; repeat < settings.repeats; ++repeat)
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+			for (const Ray& ray : rays)
+				hitCount += kernel(ray);
+			const auto end{ std::chrono::steady_clock::now() };
+
+			passTimes.emplace_back(std::chrono::duration<double, std::nano>(end - start).count());
+		}
+		std::sort(passTimes.begin(), passTimes.end());
+
+		KernelResult result{};
+		result.kernelName = kernelName;
+		result.rayCase = rayCase;
+		result.nsPerTest = passTimes[passTimes.size() / 2] / double(rays.size());
+		result.hitRate = double(hitCount) / double(rays.size() * (settings.repeats + 1));
+		return result;
+	}
+
+	template<typename Kernel, typename CreateRays>
+	void BenchmarkKernel(const std::string& kernelName, const CreateRays& createRays, const Kernel& kernel, const KernelSettings& settings)
+	{
+		if (!settings.filter.empty() && kernelName.find(settings.filter) == std::string::npos)
+			return;
+
+		for (RayCase rayCase : { RayCase::Hit, RayCase::Miss, RayCase::Grazing })
+		{
+			// the rays only depend on the seed and the case, so filtering kernels does not change them
+			std::mt19937 rng{ settings.seed + static_cast<uint32_t>(rayCase) * 7919u };
+			const std::vector<Ray> rays{ createRays(rayCase, rng) };
+
+			const KernelResult result{ RunKernel(kernelName, rayCase, rays, kernel, settings) };
+
+			std::cout << std::left << std::setw(32) << result.kernelName << std::setw(10) << GetCaseName(result.rayCase)
+				<< std::right << std::fixed << std::setprecision(2) << std::setw(12) << result.nsPerTest
+				<< std::setw(16) << 1000.0 / result.nsPerTest
+				<< std::setw(11) << result.hitRate * 100.0 << "%\n";
+		}
+	}
+}
+
+int main(int argc, char* args[])
+{
+	KernelSettings settings{};
+	// levels the CPU lacks fall back to a narrower one, the SIMD path printed below is the one used
+	SIMDLevel simdLevel{};
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		if (argument == "--seed" && hasValue && ParseArgument(args[++i], 0u, settings.seed)) continue;
+		else if (argument == "--rays" && hasValue && ParseArgument(args[++i], 1u, settings.rayCount)) continue;
+		else if (argument == "--repeats" && hasValue && ParseArgument(args[++i], 1u, settings.repeats)) continue;
+		else if (argument == "--kernel" && hasValue) settings.filter = args[++i];
+		else if (argument == "--simd" && hasValue && ParseSIMDLevel(args[++i], simdLevel)) GeometryUtils::SetSIMDLevel(simdLevel);
+		else
+		{
+			// unknown options, values that do not parse and numbers out of range
+			std::cerr << "Usage: " << args[0] << " [--seed 1337] [--rays 65536] [--repeats 7] [--kernel name] [--simd scalar|sse|avx2]" << std::endl;
+			return 1;
+		}
+	}
+
+	const Sphere sphere{ { 0.f, 0.f, 0.f }, 1.f };
+	const Plane plane{ { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } };
+
+	Triangle triangle{ { -1.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.5f, 0.f } };
+	triangle.cullMode = TriangleCullMode::NoCulling;
+
+	const TriangleMesh mesh{ CreateSphereMesh(40, 64) };
+
+	const auto sphereRays{ [&](RayCase rayCase, std::mt19937& rng) { return CreateRaysAroundCenter(sphere.origin, sphere.radius, rayCase, settings.rayCount, rng); } };
+	const auto planeRays{ [&](RayCase rayCase, std::mt19937& rng) { return CreatePlaneRays(rayCase, settings.rayCount, rng); } };
+	const auto triangleRays{ [&](RayCase rayCase, std::mt19937& rng) { return CreateTriangleRays(triangle, rayCase, settings.rayCount, rng); } };
+	const auto meshRays{ [&](RayCase rayCase, std::mt19937& rng) { return CreateRaysAroundCenter({}, 1.f, rayCase, settings.rayCount, rng); } };
+
+	std::cout << "Seed " << settings.seed << ", " << settings.rayCount << " rays per case, median of " << settings.repeats << " passes\n";
+	std::cout << "Mesh: " << mesh.indices.size() / 3 << " triangles\n";
+	std::cout << "SIMD path: " << GetSIMDLevelName(GeometryUtils::GetSIMDLevel()) << "\n\n";
+	std::cout << std::left << std::setw(32) << "kernel" << std::setw(10) << "case"
+		<< std::right << std::setw(12) << "ns/test" << std::setw(16) << "Mtests/s" << std::setw(12) << "hit rate" << "\n";
+
+	// closest hit kernels start from a fresh record every test, like a primary ray does
+	HitRecord hitRecord{};
+	BenchmarkKernel("HitTest_Sphere", sphereRays,
+		[&](const Ray& ray) { hitRecord = {}; return GeometryUtils::HitTest_Sphere(sphere, ray, hitRecord); }, settings);
+	BenchmarkKernel("HitTest_Sphere (shadow)", sphereRays,
+		[&](const Ray& ray) { return GeometryUtils::HitTest_Sphere(sphere, ray); }, settings);
+	BenchmarkKernel("HitTest_Plane", planeRays,
+		[&](const Ray& ray) { hitRecord = {}; return GeometryUtils::HitTest_Plane(plane, ray, hitRecord); }, settings);
+	BenchmarkKernel("HitTest_Triangle", triangleRays,
+		[&](const Ray& ray) { hitRecord = {}; return GeometryUtils::HitTest_Triangle(triangle, ray, hitRecord); }, settings);
+	BenchmarkKernel("SlabTest_TriangleMesh", meshRays,
+		[&](const Ray& ray) { return GeometryUtils::SlabTest_TriangleMesh(mesh, ray); }, settings);
+	BenchmarkKernel("HitTest_TriangleMesh", meshRays,
+		[&](const Ray& ray) { hitRecord = {}; return GeometryUtils::HitTest_TriangleMesh(mesh, ray, hitRecord); }, settings);
+	BenchmarkKernel("HitTest_TriangleMesh (shadow)", meshRays,
+		[&](const Ray& ray) { return GeometryUtils::HitTest_TriangleMesh(mesh, ray); }, settings);
+
+	return 0;
+}
@@ -1,8 +1,21 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+
 #include "Maths.h"
+#include "SIMD.h"
 
 namespace dae
 {
+	//One light contribution of one hit, waiting to be shaded
+	struct ShadingSample
+	{
+		uint32_t materialIndex{}; //index in the array of its type
+		Vector3 normal{};
+		Vector3 l{}; //light direction
+		Vector3 v{}; //view direction
+	};
+
 	namespace BRDF
 	{
 		/**
@@ -113,5 +126,260 @@ namespace dae
 			return GeometryFunction_SchlickGGX(n, v, k) * GeometryFunction_SchlickGGX(n, l, k);
 		}
 
+		struct CookTorrenceParameters
+		{
+			ColorRGB albedo{ 0.955f, 0.637f, 0.538f }; //Copper
+			float metalness{ 1.0f };
+			float roughness{ 0.1f }; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
+		};
+
+		/**
+		 * \brief Cook-Torrance: Lambert diffuse plus a specular term of Fresnel (Schlick), GGX distribution and Smith geometry
+		 * \param material Albedo, metalness and roughness
+		 * \param n Normal of the surface
+		 * \param l Normalized light direction
+		 * \param v Normalized view direction
+		 * \return Cook-Torrance Color
+		 */
+		static ColorRGB CookTorrence(const CookTorrenceParameters& material, const Vector3& n, const Vector3& l, const Vector3& v)
+		{
+			const Vector3 h{ ((v + l) / (v + l).Magnitude()).Normalized() };
+
+			ColorRGB kd{};
+			ColorRGB f0{ ColorRGB{0.04f, 0.04f, 0.04f } };
+
+			if (material.metalness == 1.f)
+			{
+				f0 = material.albedo;
+			}
+
+			const ColorRGB F{ FresnelFunction_Schlick(h, v, f0) };
+			const float D{ NormalDistribution_GGX(n, h, material.roughness) };
+			const float G{ GeometryFunction_Smith(n, v, l, material.roughness) };
+
+			if (material.metalness == 0.f) {
+				kd = colors::White - F;
+			}
+
+			const ColorRGB specular{ (D * F * G) / (4 * (Vector3::Dot(v, n) * Vector3::Dot(l, n))) };
+			const ColorRGB diffuse{ Lambert(kd, material.albedo) };
+
+			return kd * diffuse + f0 * specular;
+		}
+
+		//Batched Cook-Torrance, shades count samples, pMaterials is indexed by the material index of each sample
+		//The wide kernels compute the same terms in the same order, Schlick's fifth power is multiplied out instead of calling powf
+		static void CookTorrence_Scalar(const CookTorrenceParameters* pMaterials, const ShadingSample* pSamples, ColorRGB* pColors, size_t count)
+		{
+			for (size_t i{}; i < count; ++i)
+			{
+				const ShadingSample& sample{ pSamples[i] };
+				pColors[i] = CookTorrence(pMaterials[sample.materialIndex], sample.normal, sample.l, sample.v);
+			}
+		}
+
+		//Width samples turned into one array per component
+		//Every sample looks its material up by index, so this is a gather either way, done once for all components
+		template<size_t Width>
+		struct CookTorrenceLanes
+		{
+			alignas(32) float n[3][Width];
+			alignas(32) float l[3][Width];
+			alignas(32) float v[3][Width];
+			alignas(32) float albedo[3][Width];
+			alignas(32) float metalness[Width];
+			alignas(32) float roughness[Width];
+
+			void Load(const CookTorrenceParameters* pMaterials, const ShadingSample* pSamples)
+			{
+				for (size_t lane{}; lane < Width; ++lane)
+				{
+					const ShadingSample& sample{ pSamples[lane] };
+					const CookTorrenceParameters& material{ pMaterials[sample.materialIndex] };
+					n[0][lane] = sample.normal.x; n[1][lane] = sample.normal.y; n[2][lane] = sample.normal.z;
+					l[0][lane] = sample.l.x; l[1][lane] = sample.l.y; l[2][lane] = sample.l.z;
+					v[0][lane] = sample.v.x; v[1][lane] = sample.v.y; v[2][lane] = sample.v.z;
+					albedo[0][lane] = material.albedo.r; albedo[1][lane] = material.albedo.g; albedo[2][lane] = material.albedo.b;
+					metalness[lane] = material.metalness;
+					roughness[lane] = material.roughness;
+				}
+			}
+		};
+
+#if defined(DAE_SIMD_SSE)
+		static __m128 Dot_SSE(const __m128 a[3], const __m128 b[3])
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+		}
+
+		//SchlickGGX of one direction, k is the already remapped roughness
+		static __m128 GeometryFunction_SchlickGGX_SSE(__m128 dot, __m128 k)
+		{
+			return _mm_div_ps(dot, _mm_add_ps(_mm_mul_ps(dot, _mm_sub_ps(_mm_set1_ps(1.f), k)), k));
+		}
+
+		static void CookTorrence_SSE(const CookTorrenceParameters* pMaterials, const ShadingSample* pSamples, ColorRGB* pColors, size_t count)
+		{
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128 eighth{ _mm_set1_ps(8.f) };
+			const __m128 pi{ _mm_set1_ps(PI) };
+
+			CookTorrenceLanes<4> lanes;
+			size_t i{};
+			for (; i + 4 <= count; i += 4)
+			{
+				lanes.Load(pMaterials, pSamples + i);
+				__m128 n[3], l[3], v[3], h[3];
+				for (int axis{}; axis < 3; ++axis)
+				{
+					n[axis] = _mm_load_ps(lanes.n[axis]);
+					l[axis] = _mm_load_ps(lanes.l[axis]);
+					v[axis] = _mm_load_ps(lanes.v[axis]);
+					h[axis] = _mm_add_ps(v[axis], l[axis]);
+				}
+
+				// normalized twice, like the single sample version
+				for (int pass{}; pass < 2; ++pass)
+				{
+					const __m128 magnitude{ _mm_sqrt_ps(Dot_SSE(h, h)) };
+					for (__m128& axis : h)
+						axis = _mm_div_ps(axis, magnitude);
+				}
+
+				const __m128 metalness{ _mm_load_ps(lanes.metalness) };
+				const __m128 isMetal{ _mm_cmpeq_ps(metalness, one) };
+				const __m128 isDielectric{ _mm_cmpeq_ps(metalness, zero) };
+
+				const __m128 x{ _mm_sub_ps(one, Dot_SSE(h, v)) };
+				const __m128 fresnel{ _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(x, x), x), x), x) };
+
+				const __m128 roughness{ _mm_load_ps(lanes.roughness) };
+				const __m128 alpha{ _mm_mul_ps(roughness, roughness) };
+				const __m128 alphaSquared{ _mm_mul_ps(alpha, alpha) };
+				const __m128 normalDotHalf{ Dot_SSE(n, h) };
+				const __m128 distributionTerm{ _mm_add_ps(_mm_mul_ps(_mm_mul_ps(normalDotHalf, normalDotHalf), _mm_sub_ps(alphaSquared, one)), one) };
+				const __m128 D{ _mm_div_ps(alphaSquared, _mm_mul_ps(pi, _mm_mul_ps(distributionTerm, distributionTerm))) };
+
+				// Smith remaps the roughness and SchlickGGX remaps it again
+				const __m128 alphaPlusOne{ _mm_add_ps(alpha, one) };
+				const __m128 k{ _mm_div_ps(_mm_mul_ps(alphaPlusOne, alphaPlusOne), eighth) };
+				const __m128 kSquaredPlusOne{ _mm_add_ps(_mm_mul_ps(k, k), one) };
+				const __m128 remappedK{ _mm_div_ps(_mm_mul_ps(kSquaredPlusOne, kSquaredPlusOne), eighth) };
+				const __m128 viewDotNormal{ Dot_SSE(v, n) };
+				const __m128 lightDotNormal{ Dot_SSE(l, n) };
+				const __m128 G{ _mm_mul_ps(GeometryFunction_SchlickGGX_SSE(viewDotNormal, remappedK), GeometryFunction_SchlickGGX_SSE(lightDotNormal, remappedK)) };
+				const __m128 specularDenominator{ _mm_mul_ps(_mm_set1_ps(4.f), _mm_mul_ps(viewDotNormal, lightDotNormal)) };
+
+				__m128 color[3];
+				for (int channel{}; channel < 3; ++channel)
+				{
+					const __m128 albedo{ _mm_load_ps(lanes.albedo[channel]) };
+					const __m128 f0{ _mm_or_ps(_mm_and_ps(isMetal, albedo), _mm_andnot_ps(isMetal, _mm_set1_ps(.04f))) };
+					const __m128 F{ _mm_add_ps(f0, _mm_mul_ps(_mm_sub_ps(one, f0), fresnel)) };
+					const __m128 kd{ _mm_and_ps(isDielectric, _mm_sub_ps(one, F)) };
+
+					const __m128 specular{ _mm_div_ps(_mm_mul_ps(_mm_mul_ps(F, D), G), specularDenominator) };
+					const __m128 diffuse{ _mm_div_ps(_mm_mul_ps(albedo, kd), pi) };
+					color[channel] = _mm_add_ps(_mm_mul_ps(kd, diffuse), _mm_mul_ps(f0, specular));
+				}
+
+				alignas(16) float channels[3][4];
+				for (int channel{}; channel < 3; ++channel)
+					_mm_store_ps(channels[channel], color[channel]);
+				for (size_t lane{}; lane < 4; ++lane)
+					pColors[i + lane] = { channels[0][lane], channels[1][lane], channels[2][lane] };
+			}
+
+			CookTorrence_Scalar(pMaterials, pSamples + i, pColors + i, count - i);
+		}
+#endif
+
+#if defined(DAE_SIMD_AVX2) || defined(DAE_SIMD_RUNTIME_DISPATCH)
+		DAE_TARGET_AVX2 static __m256 Dot_AVX2(const __m256 a[3], const __m256 b[3])
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1])), _mm256_mul_ps(a[2], b[2]));
+		}
+
+		DAE_TARGET_AVX2 static __m256 GeometryFunction_SchlickGGX_AVX2(__m256 dot, __m256 k)
+		{
+			return _mm256_div_ps(dot, _mm256_add_ps(_mm256_mul_ps(dot, _mm256_sub_ps(_mm256_set1_ps(1.f), k)), k));
+		}
+
+		DAE_TARGET_AVX2 static void CookTorrence_AVX2(const CookTorrenceParameters* pMaterials, const ShadingSample* pSamples, ColorRGB* pColors, size_t count)
+		{
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			const __m256 eighth{ _mm256_set1_ps(8.f) };
+			const __m256 pi{ _mm256_set1_ps(PI) };
+
+			CookTorrenceLanes<8> lanes;
+			size_t i{};
+			for (; i + 8 <= count; i += 8)
+			{
+				lanes.Load(pMaterials, pSamples + i);
+				__m256 n[3], l[3], v[3], h[3];
+				for (int axis{}; axis < 3; ++axis)
+				{
+					n[axis] = _mm256_load_ps(lanes.n[axis]);
+					l[axis] = _mm256_load_ps(lanes.l[axis]);
+					v[axis] = _mm256_load_ps(lanes.v[axis]);
+					h[axis] = _mm256_add_ps(v[axis], l[axis]);
+				}
+
+				for (int pass{}; pass < 2; ++pass)
+				{
+					const __m256 magnitude{ _mm256_sqrt_ps(Dot_AVX2(h, h)) };
+					for (__m256& axis : h)
+						axis = _mm256_div_ps(axis, magnitude);
+				}
+
+				const __m256 metalness{ _mm256_load_ps(lanes.metalness) };
+				const __m256 isMetal{ _mm256_cmp_ps(metalness, one, _CMP_EQ_OQ) };
+				const __m256 isDielectric{ _mm256_cmp_ps(metalness, zero, _CMP_EQ_OQ) };
+
+				const __m256 x{ _mm256_sub_ps(one, Dot_AVX2(h, v)) };
+				const __m256 fresnel{ _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(x, x), x), x), x) };
+
+				const __m256 roughness{ _mm256_load_ps(lanes.roughness) };
+				const __m256 alpha{ _mm256_mul_ps(roughness, roughness) };
+				const __m256 alphaSquared{ _mm256_mul_ps(alpha, alpha) };
+				const __m256 normalDotHalf{ Dot_AVX2(n, h) };
+				const __m256 distributionTerm{ _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(normalDotHalf, normalDotHalf), _mm256_sub_ps(alphaSquared, one)), one) };
+				const __m256 D{ _mm256_div_ps(alphaSquared, _mm256_mul_ps(pi, _mm256_mul_ps(distributionTerm, distributionTerm))) };
+
+				const __m256 alphaPlusOne{ _mm256_add_ps(alpha, one) };
+				const __m256 k{ _mm256_div_ps(_mm256_mul_ps(alphaPlusOne, alphaPlusOne), eighth) };
+				const __m256 kSquaredPlusOne{ _mm256_add_ps(_mm256_mul_ps(k, k), one) };
+				const __m256 remappedK{ _mm256_div_ps(_mm256_mul_ps(kSquaredPlusOne, kSquaredPlusOne), eighth) };
+				const __m256 viewDotNormal{ Dot_AVX2(v, n) };
+				const __m256 lightDotNormal{ Dot_AVX2(l, n) };
+				const __m256 G{ _mm256_mul_ps(GeometryFunction_SchlickGGX_AVX2(viewDotNormal, remappedK), GeometryFunction_SchlickGGX_AVX2(lightDotNormal, remappedK)) };
+				const __m256 specularDenominator{ _mm256_mul_ps(_mm256_set1_ps(4.f), _mm256_mul_ps(viewDotNormal, lightDotNormal)) };
+
+				__m256 color[3];
+				for (int channel{}; channel < 3; ++channel)
+				{
+					const __m256 albedo{ _mm256_load_ps(lanes.albedo[channel]) };
+					const __m256 f0{ _mm256_blendv_ps(_mm256_set1_ps(.04f), albedo, isMetal) };
+					const __m256 F{ _mm256_add_ps(f0, _mm256_mul_ps(_mm256_sub_ps(one, f0), fresnel)) };
+					const __m256 kd{ _mm256_and_ps(isDielectric, _mm256_sub_ps(one, F)) };
+
+					const __m256 specular{ _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(F, D), G), specularDenominator) };
+					const __m256 diffuse{ _mm256_div_ps(_mm256_mul_ps(albedo, kd), pi) };
+					color[channel] = _mm256_add_ps(_mm256_mul_ps(kd, diffuse), _mm256_mul_ps(f0, specular));
+				}
+
+				alignas(32) float channels[3][8];
+				for (int channel{}; channel < 3; ++channel)
+					_mm256_store_ps(channels[channel], color[channel]);
+				for (size_t lane{}; lane < 8; ++lane)
+					pColors[i + lane] = { channels[0][lane], channels[1][lane], channels[2][lane] };
+			}
+
+			CookTorrence_Scalar(pMaterials, pSamples + i, pColors + i, count - i);
+		}
+#endif
+
 	}
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace dae
+{
+	void BVH::Build(const std::vector<AABB>& primitiveBounds)
+	{
+		Clear();
+
+		const uint32_t primitiveCount{ static_cast<uint32_t>(primitiveBounds.size()) };
+		if (primitiveCount == 0)
+			return;
+
+		m_PrimitiveIndices.resize(primitiveCount);
+		std::iota(m_PrimitiveIndices.begin(), m_PrimitiveIndices.end(), 0);
+
+		std::vector<Vector3> centroids{};
+		centroids.reserve(primitiveCount);
+		for (const AABB& bounds : primitiveBounds)
+		{
+			centroids.emplace_back(bounds.GetCenter());
+		}
+
+		// A binary tree with N leaves never has more than 2N - 1 nodes
+		m_Nodes.reserve(2 * primitiveCount - 1);
+
+		BVHNode root{};
+		root.leftFirst = 0;
+		root.primitiveCount = primitiveCount;
+		m_Nodes.emplace_back(root);
+
+		UpdateNodeBounds(0, primitiveBounds);
+		Subdivide(0, 1, primitiveBounds, centroids);
+
+		m_Nodes.shrink_to_fit();
+	}
+
+	void BVH::Refit(const std::vector<AABB>& primitiveBounds)
+	{
+		// Children are always stored after their parent, so walking the nodes
+		// back to front visits every child before the node that contains it
+		for (int64_t nodeIndex{ static_cast<int64_t>(m_Nodes.size()) - 1 }; nodeIndex >= 0; --nodeIndex)
+		{
+			BVHNode& node{ m_Nodes[nodeIndex] };
+
+			if (node.IsLeaf())
+			{
+				UpdateNodeBounds(static_cast<uint32_t>(nodeIndex), primitiveBounds);
+				continue;
+			}
+
+			const BVHNode& leftChild{ m_Nodes[node.leftFirst] };
+			const BVHNode& rightChild{ m_Nodes[node.leftFirst + 1] };
+
+			node.minAABB = Vector3::Min(leftChild.minAABB, rightChild.minAABB);
+			node.maxAABB = Vector3::Max(leftChild.maxAABB, rightChild.maxAABB);
+		}
+	}
+
+	AABB BVH::GetBounds() const
+	{
+		if (m_Nodes.empty())
+			return {};
+
+		return { m_Nodes[0].minAABB, m_Nodes[0].maxAABB };
+	}
+
+	void BVH::Clear()
+	{
+		m_Nodes.clear();
+		m_PrimitiveIndices.clear();
+	}
+
+	void BVH::Assign(std::vector<BVHNode> nodes, std::vector<uint32_t> primitiveIndices)
+	{
+		m_Nodes = std::move(nodes);
+		m_PrimitiveIndices = std::move(primitiveIndices);
+	}
+
+	void BVH::UpdateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds)
+	{
+		BVHNode& node{ m_Nodes[nodeIndex] };
+
+		AABB bounds{};
+		for (uint32_t i{}; i < node.primitiveCount; ++i)
+		{
+			bounds.Grow(primitiveBounds[m_PrimitiveIndices[node.leftFirst + i]]);
+		}
+
+		node.minAABB = bounds.min;
+		node.maxAABB = bounds.max;
+	}
+
+	void BVH::Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids)
+	{
+		const BVHNode node{ m_Nodes[nodeIndex] };
+		if (node.primitiveCount <= 1 || depth >= MaxDepth)
+			return;
+
+		int axis{ -1 };
+		float splitPosition{};
+		const float splitCost{ FindBestSplit(node, primitiveBounds, centroids, axis, splitPosition) };
+
+		// All centroids coincide, there is no plane that separates them
+		if (axis < 0)
+			return;
+
+		const float leafCost{ m_IntersectionCost * node.primitiveCount };
+		if (splitCost >= leafCost && node.primitiveCount <= m_MaxLeafSize)
+			return;
+
+		// Partition the primitive indices in place around the split plane
+		uint32_t i{ node.leftFirst };
+		uint32_t j{ node.leftFirst + node.primitiveCount - 1 };
+		while (i <= j && j != UINT32_MAX)
+		{
+			if (centroids[m_PrimitiveIndices[i]][axis] < splitPosition)
+			{
+				++i;
+			}
+			else
+			{
+				std::swap(m_PrimitiveIndices[i], m_PrimitiveIndices[j]);
+				--j;
+			}
+		}
+
+		const uint32_t leftCount{ i - node.leftFirst };
+		if (leftCount == 0 || leftCount == node.primitiveCount)
+			return;
+
+		const uint32_t leftChildIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+
+		BVHNode leftChild{};
+		leftChild.leftFirst = node.leftFirst;
+		leftChild.primitiveCount = leftCount;
+
+		BVHNode rightChild{};
+		rightChild.leftFirst = i;
+		rightChild.primitiveCount = node.primitiveCount - leftCount;
+
+		m_Nodes.emplace_back(leftChild);
+		m_Nodes.emplace_back(rightChild);
+
+		m_Nodes[nodeIndex].leftFirst = leftChildIndex;
+		m_Nodes[nodeIndex].primitiveCount = 0;
+
+		UpdateNodeBounds(leftChildIndex, primitiveBounds);
+		UpdateNodeBounds(leftChildIndex + 1, primitiveBounds);
+
+		Subdivide(leftChildIndex, depth + 1, primitiveBounds, centroids);
+		Subdivide(leftChildIndex + 1, depth + 1, primitiveBounds, centroids);
+	}
+
+	float BVH::FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, int& axis, float& splitPosition) const
+	{
+		struct Bin
+		{
+			AABB bounds{};
+			uint32_t count{};
+		};
+
+		// Bin on the bounds of the centroids, not of the primitives themselves
+		AABB centroidBounds{};
+		for (uint32_t i{}; i < node.primitiveCount; ++i)
+		{
+			centroidBounds.Grow(centroids[m_PrimitiveIndices[node.leftFirst + i]]);
+		}
+
+		float bestCost{ FLT_MAX };
+		for (int a{}; a < 3; ++a)
+		{
+			const float boundsMin{ centroidBounds.min[a] };
+			const float boundsMax{ centroidBounds.max[a] };
+			if (boundsMax <= boundsMin)
+				continue;
+
+			Bin bins[m_BinCount]{};
+			const float scale{ m_BinCount / (boundsMax - boundsMin) };
+			for (uint32_t i{}; i < node.primitiveCount; ++i)
+			{
+				const uint32_t primitiveIndex{ m_PrimitiveIndices[node.leftFirst + i] };
+				const uint32_t binIndex{ std::min(m_BinCount - 1,
+					static_cast<uint32_t>((centroids[primitiveIndex][a] - boundsMin) * scale)) };
+
+				bins[binIndex].count++;
+				bins[binIndex].bounds.Grow(primitiveBounds[primitiveIndex]);
+			}
+
+			// Sweep from both sides so every plane between two bins is evaluated in O(bins)
+			float leftArea[m_BinCount - 1]{}, rightArea[m_BinCount - 1]{};
+			uint32_t leftCount[m_BinCount - 1]{}, rightCount[m_BinCount - 1]{};
+
+			AABB leftBounds{}, rightBounds{};
+			uint32_t leftSum{}, rightSum{};
+			for (uint32_t i{}; i < m_BinCount - 1; ++i)
+			{
+				leftSum += bins[i].count;
+				leftCount[i] = leftSum;
+				leftBounds.Grow(bins[i].bounds);
+				leftArea[i] = leftBounds.GetSurfaceArea();
+
+				rightSum += bins[m_BinCount - 1 - i].count;
+				rightCount[m_BinCount - 2 - i] = rightSum;
+				rightBounds.Grow(bins[m_BinCount - 1 - i].bounds);
+				rightArea[m_BinCount - 2 - i] = rightBounds.GetSurfaceArea();
+			}
+
+			const float binWidth{ (boundsMax - boundsMin) / m_BinCount };
+			for (uint32_t i{}; i < m_BinCount - 1; ++i)
+			{
+				if (leftCount[i] == 0 || rightCount[i] == 0)
+					continue;
+
+				const float cost{ leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i] };
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					axis = a;
+					splitPosition = boundsMin + binWidth * (i + 1);
+				}
+			}
+		}
+
+		if (axis < 0)
+			return FLT_MAX;
+
+		// Express the split in the same unit as the leaf cost (C_trav + C_int * SA-weighted count)
+		const AABB nodeBounds{ node.minAABB, node.maxAABB };
+		const float nodeArea{ nodeBounds.GetSurfaceArea() };
+		if (nodeArea <= 0.f)
+			return m_TraversalCost;
+
+		return m_TraversalCost + m_IntersectionCost * bestCost / nodeArea;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Maths.h"
+
+namespace dae
+{
+#pragma region AABB
+	struct AABB
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const Vector3& point)
+		{
+			min = Vector3::Min(min, point);
+			max = Vector3::Max(max, point);
+		}
+
+		void Grow(const AABB& other)
+		{
+			min = Vector3::Min(min, other.min);
+			max = Vector3::Max(max, other.max);
+		}
+
+		Vector3 GetCenter() const
+		{
+			return (min + max) * 0.5f;
+		}
+
+		//Bounds of the 8 transformed corners
+		AABB Transform(const Matrix& transform) const
+		{
+			AABB transformed{};
+			for (int corner{}; corner < 8; ++corner)
+			{
+				transformed.Grow(transform.TransformPoint(
+					corner & 1 ? max.x : min.x,
+					corner & 2 ? max.y : min.y,
+					corner & 4 ? max.z : min.z));
+			}
+
+			return transformed;
+		}
+
+		float GetSurfaceArea() const
+		{
+			const Vector3 extent{ max - min };
+			if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f)
+				return 0.f;
+
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+	};
+#pragma endregion
+
+#pragma region BVH
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+
+		// Inner node: index of the left child (right child is leftFirst + 1)
+		// Leaf node: index of the first primitive in the primitive index list
+		uint32_t leftFirst{};
+		uint32_t primitiveCount{};
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+
+	//Bounding Volume Hierarchy built with the binned Surface Area Heuristic
+	//The BVH only knows about primitive bounds, it is up to the owner to map the
+	//primitive indices back onto triangles, spheres, meshes, ...
+	class BVH final
+	{
+	public:
+		//Traversal stacks can be sized with this, the builder never goes deeper
+		static constexpr uint32_t MaxDepth{ 64 };
+
+		void Build(const std::vector<AABB>& primitiveBounds);
+		//Keeps the topology and only recomputes node bounds, primitive count must match the last Build
+		void Refit(const std::vector<AABB>& primitiveBounds);
+		void Clear();
+		//Takes over a hierarchy built earlier, like the one stored in a mesh cache
+		void Assign(std::vector<BVHNode> nodes, std::vector<uint32_t> primitiveIndices);
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		AABB GetBounds() const;
+
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+
+	private:
+		static constexpr uint32_t m_BinCount{ 12 };
+		static constexpr uint32_t m_MaxLeafSize{ 8 };
+		static constexpr float m_TraversalCost{ 1.f };
+		static constexpr float m_IntersectionCost{ 1.f };
+
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<uint32_t> m_PrimitiveIndices{};
+
+		void UpdateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds);
+		void Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids);
+		float FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, int& axis, float& splitPosition) const;
+	};
+#pragma endregion
+}
@@ -43,6 +43,9 @@ namespace dae
 
 		Matrix cameraToWorld{};
 
+		//Headless renders have no keyboard or mouse, the camera then stays where the scene put it
+		bool isInputEnabled{ true };
+
 		Matrix CalculateCameraToWorld()
 		{
 			////todo: W2
@@ -63,6 +66,10 @@ namespace dae
 
 		void Update(Timer* pTimer)
 		{
+			if (!isInputEnabled) {
+				return;
+			}
+
 			const float deltaTime = pTimer->GetElapsed();
 
 			//Matrix
@@ -0,0 +1,29 @@
+#pragma once
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace dae
+{
+	//Parses a whole command line value as a number no smaller than minValue
+	//Leaves value alone and returns false on trailing characters, overflow, NaN, infinity or a value below minValue
+	template<typename T>
+	bool ParseArgument(const char* pText, T minValue, T& value)
+	{
+		const char* pEnd{ pText + std::strlen(pText) };
+		T parsed{};
+		const auto [pLast, error] { std::from_chars(pText, pEnd, parsed) };
+		if (error != std::errc{} || pLast != pEnd || !(parsed >= minValue))
+			return false;
+
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			if (!std::isfinite(parsed))
+				return false;
+		}
+
+		value = parsed;
+		return true;
+	}
+}
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "Maths.h"
+#include "BVH.h"
 
 
 namespace dae
@@ -55,6 +56,19 @@ namespace dae
 		unsigned char materialIndex{};
 	};
 
+	//Structure of arrays layout of up to 8 triangles, tested against one ray at once.
+	//Unused lanes are zeroed, a degenerate triangle never reports a hit.
+	struct alignas(32) TrianglePack
+	{
+		static constexpr uint32_t Width{ 8 };
+
+		float v0x[Width]{}, v0y[Width]{}, v0z[Width]{};
+		float edge1x[Width]{}, edge1y[Width]{}, edge1z[Width]{};
+		float edge2x[Width]{}, edge2y[Width]{}, edge2z[Width]{};
+		float normalx[Width]{}, normaly[Width]{}, normalz[Width]{};
+		uint32_t triangleIndex[Width]{};
+	};
+
 	struct TriangleMesh
 	{
 		TriangleMesh() = default;
@@ -94,6 +108,13 @@ namespace dae
 		std::vector<Vector3> transformedPositions{};
 		std::vector<Vector3> transformedNormals{};
 
+		//Bottom level acceleration structure over the transformed triangles
+		BVH bvh{};
+
+		//Triangles of every BVH leaf packed for the SIMD kernel, leafPackOffsets is indexed by node
+		std::vector<TrianglePack> trianglePacks{};
+		std::vector<uint32_t> leafPackOffsets{};
+
 		void Translate(const Vector3& translation)
 		{
 			translationTransform = Matrix::CreateTranslation(translation);
@@ -235,6 +256,137 @@ namespace dae
 
 			// Update AABB
 			UpdateTransformedAABB(finalTransform);
+
+			// Update BVH
+			UpdateBVH();
+			UpdateTrianglePacks(transformedPositions, transformedNormals);
+		}
+
+		void UpdateBVH()
+		{
+			UpdateBVH(transformedPositions);
+		}
+
+		void RebuildBVH()
+		{
+			bvh.Clear();
+			UpdateBVH();
+			UpdateTrianglePacks(transformedPositions, transformedNormals);
+		}
+
+		//Instanced meshes are never transformed themselves, the instances transform the rays instead.
+		//Drops the transformed copy of the geometry and builds the BVH in object space.
+		void PrepareForInstancing()
+		{
+			transformedPositions.clear();
+			transformedPositions.shrink_to_fit();
+			transformedNormals.clear();
+			transformedNormals.shrink_to_fit();
+
+			UpdateAABB();
+			transformedMinAABB = minAABB;
+			transformedMaxAABB = maxAABB;
+
+			bvh.Clear();
+			UpdateBVH(positions);
+			UpdateTrianglePacks(positions, normals);
+		}
+
+		void UpdateBVH(const std::vector<Vector3>& vertexPositions)
+		{
+			std::vector<AABB> triangleBounds{};
+			triangleBounds.reserve(indices.size() / 3);
+
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				AABB bounds{};
+				bounds.Grow(vertexPositions[indices[i]]);
+				bounds.Grow(vertexPositions[indices[i + 1]]);
+				bounds.Grow(vertexPositions[indices[i + 2]]);
+
+				triangleBounds.emplace_back(bounds);
+			}
+
+			// Moving a mesh doesn't change which triangles belong together,
+			// only rebuild when the triangles themselves changed
+			if (bvh.GetPrimitiveIndices().size() == triangleBounds.size())
+				bvh.Refit(triangleBounds);
+			else
+				bvh.Build(triangleBounds);
+		}
+
+		void UpdateTrianglePacks(const std::vector<Vector3>& vertexPositions, const std::vector<Vector3>& triangleNormals)
+		{
+			const std::vector<BVHNode>& nodes{ bvh.GetNodes() };
+			const std::vector<uint32_t>& triangleIndices{ bvh.GetPrimitiveIndices() };
+
+			trianglePacks.clear();
+			leafPackOffsets.assign(nodes.size(), 0);
+
+			for (size_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex) {
+				const BVHNode& node{ nodes[nodeIndex] };
+				if (!node.IsLeaf())
+					continue;
+
+				leafPackOffsets[nodeIndex] = static_cast<uint32_t>(trianglePacks.size());
+
+				for (uint32_t first = 0; first < node.primitiveCount; first += TrianglePack::Width) {
+					TrianglePack pack{};
+
+					const uint32_t laneCount{ std::min(TrianglePack::Width, node.primitiveCount - first) };
+					for (uint32_t lane = 0; lane < laneCount; ++lane) {
+						const uint32_t triangleIndex{ triangleIndices[node.leftFirst + first + lane] };
+
+						const Vector3& v0{ vertexPositions[indices[triangleIndex * 3]] };
+						const Vector3 edge1{ vertexPositions[indices[triangleIndex * 3 + 1]] - v0 };
+						const Vector3 edge2{ vertexPositions[indices[triangleIndex * 3 + 2]] - v0 };
+						const Vector3& normal{ triangleNormals[triangleIndex] };
+
+						pack.v0x[lane] = v0.x;
+						pack.v0y[lane] = v0.y;
+						pack.v0z[lane] = v0.z;
+						pack.edge1x[lane] = edge1.x;
+						pack.edge1y[lane] = edge1.y;
+						pack.edge1z[lane] = edge1.z;
+						pack.edge2x[lane] = edge2.x;
+						pack.edge2y[lane] = edge2.y;
+						pack.edge2z[lane] = edge2.z;
+						pack.normalx[lane] = normal.x;
+						pack.normaly[lane] = normal.y;
+						pack.normalz[lane] = normal.z;
+						pack.triangleIndex[lane] = triangleIndex;
+					}
+
+					trianglePacks.emplace_back(pack);
+				}
+			}
+		}
+	};
+
+	//Places a shared TriangleMesh in the world without copying its geometry.
+	//The mesh has to be prepared with TriangleMesh::PrepareForInstancing, rays are
+	//transformed into its object space so only the top level BVH changes when an instance moves.
+	struct TriangleMeshInstance
+	{
+		const TriangleMesh* pMesh{ nullptr };
+		unsigned char materialIndex{};
+
+		Matrix worldToObject{};
+		AABB worldBounds{};
+
+		void SetTransform(const Matrix& objectToWorld)
+		{
+			worldToObject = Matrix::Inverse(objectToWorld);
+			worldBounds = pMesh->bvh.GetBounds().Transform(objectToWorld);
+		}
+
+		//Normals transform with the inverse transpose of the object to world matrix
+		Vector3 TransformNormal(const Vector3& normal) const
+		{
+			return Vector3{
+				Vector3::Dot(normal, worldToObject.GetAxisX()),
+				Vector3::Dot(normal, worldToObject.GetAxisY()),
+				Vector3::Dot(normal, worldToObject.GetAxisZ())
+			}.Normalized();
 		}
 	};
 #pragma endregion
@@ -265,6 +417,70 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	//Coherent rays sharing one origin, lane i is pixel (i % Size, i / Size) of a Size x Size screen block
+	struct alignas(16) RayPacket
+	{
+		static constexpr uint32_t Size{ 4 };
+		static constexpr uint32_t Width{ Size * Size };
+
+		// the arrays come first so every one of them stays 16 byte aligned for the SIMD kernels
+		float directionX[Width]{};
+		float directionY[Width]{};
+		float directionZ[Width]{};
+
+		float invDirectionX[Width]{};
+		float invDirectionY[Width]{};
+		float invDirectionZ[Width]{};
+
+		Vector3 origin{};
+
+		float min{ 0.0001f };
+		float max{ FLT_MAX };
+
+		//Planes through the origin that enclose every ray of the packet, normals point inwards
+		Vector3 frustumNormals[4]{};
+
+		void SetDirection(uint32_t lane, const Vector3& direction)
+		{
+			directionX[lane] = direction.x;
+			directionY[lane] = direction.y;
+			directionZ[lane] = direction.z;
+		}
+
+		Vector3 GetDirection(uint32_t lane) const
+		{
+			return { directionX[lane], directionY[lane], directionZ[lane] };
+		}
+
+		Ray GetRay(uint32_t lane) const
+		{
+			return { origin, GetDirection(lane), min, max };
+		}
+
+		//Has to be called once every direction is set
+		void Finalize()
+		{
+			for (uint32_t lane{}; lane < Width; ++lane)
+			{
+				invDirectionX[lane] = 1.f / directionX[lane];
+				invDirectionY[lane] = 1.f / directionY[lane];
+				invDirectionZ[lane] = 1.f / directionZ[lane];
+			}
+
+			// the lanes form a grid on a plane, so the corner rays span the whole packet
+			const Vector3 corners[4]{ GetDirection(0), GetDirection(Size - 1), GetDirection(Width - 1), GetDirection(Width - Size) };
+			const Vector3 center{ corners[0] + corners[1] + corners[2] + corners[3] };
+
+			for (int i{}; i < 4; ++i)
+			{
+				frustumNormals[i] = Vector3::Cross(corners[i], corners[(i + 1) % 4]);
+				if (Vector3::Dot(frustumNormals[i], center) < 0.f) {
+					frustumNormals[i] = -frustumNormals[i];
+				}
+			}
+		}
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -274,5 +490,19 @@ namespace dae
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
 	};
+
+	//Closest hits of every lane of a RayPacket, t mirrors records[lane].t so packet kernels can load it as a vector
+	struct alignas(16) RayPacketHit
+	{
+		float t[RayPacket::Width];
+		HitRecord records[RayPacket::Width]{};
+
+		RayPacketHit()
+		{
+			for (float& distance : t) {
+				distance = FLT_MAX;
+			}
+		}
+	};
 #pragma endregion
 }
\ No newline at end of file
@@ -0,0 +1,559 @@
+#include "ImageIO.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace dae
+{
+	namespace
+	{
+		//CRC-32 of the PNG chunks, start with 0xFFFFFFFF and invert the result
+		uint32_t UpdateCrc(uint32_t crc, const uint8_t* pData, size_t size)
+		{
+			static const std::array<uint32_t, 256> table{ [] {
+				std::array<uint32_t, 256> values{};
+				for (uint32_t n{}; n < 256; ++n)
+				{
+					uint32_t c{ n };
+					for (int k{}; k < 8; ++k)
+					{
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					}
+					values[n] = c;
+				}
+				return values;
+				}() };
+
+			for (size_t i{}; i < size; ++i)
+			{
+				crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return crc;
+		}
+
+		uint32_t GetAdler32(const uint8_t* pData, size_t size)
+		{
+			// 5552 bytes is the most that can be summed before the 32 bit sums can overflow
+			constexpr uint32_t Modulo{ 65521 };
+			uint32_t a{ 1 }, b{ 0 };
+			while (size > 0)
+			{
+				const size_t blockSize{ std::min(size, size_t{ 5552 }) };
+				for (size_t i{}; i < blockSize; ++i)
+				{
+					a += pData[i];
+					b += a;
+				}
+				a %= Modulo;
+				b %= Modulo;
+				pData += blockSize;
+				size -= blockSize;
+			}
+			return (b << 16) | a;
+		}
+
+		void AppendBigEndian(std::vector<uint8_t>& bytes, uint32_t value)
+		{
+			bytes.insert(bytes.end(), { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) });
+		}
+
+		//Deflate packs bits from the least significant bit up
+		class BitWriter final
+		{
+		public:
+			explicit BitWriter(std::vector<uint8_t>& bytes) : m_Bytes(bytes) {}
+
+			void Write(uint32_t bits, uint32_t count)
+			{
+				m_Buffer |= uint64_t(bits) << m_Count;
+				m_Count += count;
+				while (m_Count >= 8)
+				{
+					m_Bytes.emplace_back(uint8_t(m_Buffer));
+					m_Buffer >>= 8;
+					m_Count -= 8;
+				}
+			}
+
+			void Flush()
+			{
+				if (m_Count > 0)
+					m_Bytes.emplace_back(uint8_t(m_Buffer));
+				m_Buffer = 0;
+				m_Count = 0;
+			}
+
+		private:
+			std::vector<uint8_t>& m_Bytes;
+			uint64_t m_Buffer{};
+			uint32_t m_Count{};
+		};
+
+		//Huffman codes are sent most significant bit first, so they are stored reversed
+		uint32_t ReverseBits(uint32_t code, uint32_t length)
+		{
+			uint32_t reversed{};
+			for (uint32_t i{}; i < length; ++i)
+			{
+				reversed = (reversed << 1) | ((code >> i) & 1);
+			}
+			return reversed;
+		}
+
+		//The fixed literal/length code of RFC 1951 3.2.6, so no code tables have to be sent
+		struct FixedCode
+		{
+			uint32_t bits{};
+			uint32_t length{};
+		};
+
+		const std::array<FixedCode, 288>& GetFixedLiteralCodes()
+		{
+			static const std::array<FixedCode, 288> codes{ [] {
+				std::array<FixedCode, 288> values{};
+				for (uint32_t symbol{}; symbol < 288; ++symbol)
+				{
+					FixedCode& code{ values[symbol] };
+					if (symbol < 144) code = { 0x30 + symbol, 8 };
+					else if (symbol < 256) code = { 0x190 + symbol - 144, 9 };
+					else if (symbol < 280) code = { symbol - 256, 7 };
+					else code = { 0xC0 + symbol - 280, 8 };
+					code.bits = ReverseBits(code.bits, code.length);
+				}
+				return values;
+				}() };
+			return codes;
+		}
+
+		constexpr uint32_t LengthBases[29]{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		constexpr uint32_t LengthExtraBits[29]{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		constexpr uint32_t DistanceBases[30]{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		constexpr uint32_t DistanceExtraBits[30]{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		void WriteMatch(BitWriter& writer, uint32_t length, uint32_t distance)
+		{
+			const auto& literalCodes{ GetFixedLiteralCodes() };
+
+			const uint32_t lengthCode{ uint32_t(std::upper_bound(std::begin(LengthBases), std::end(LengthBases), length) - std::begin(LengthBases)) - 1 };
+			const FixedCode& code{ literalCodes[257 + lengthCode] };
+			writer.Write(code.bits, code.length);
+			writer.Write(length - LengthBases[lengthCode], LengthExtraBits[lengthCode]);
+
+			// the fixed distance codes are all 5 bits long
+			const uint32_t distanceCode{ uint32_t(std::upper_bound(std::begin(DistanceBases), std::end(DistanceBases), distance) - std::begin(DistanceBases)) - 1 };
+			writer.Write(ReverseBits(distanceCode, 5), 5);
+			writer.Write(distance - DistanceBases[distanceCode], DistanceExtraBits[distanceCode]);
+		}
+
+		//zlib stream of one fixed Huffman block, matches come from a hash of the next 3 bytes without chains
+		//Compresses rendered images a good deal less than zlib at level 6, at a fraction of the time
+		std::vector<uint8_t> Compress(const std::vector<uint8_t>& data)
+		{
+			constexpr uint32_t WindowSize{ 32768 };
+			constexpr uint32_t MinMatch{ 3 };
+			constexpr uint32_t MaxMatch{ 258 };
+			constexpr uint32_t HashBits{ 15 };
+
+			std::vector<uint8_t> bytes{ 0x78, 0x01 };
+			bytes.reserve(data.size() / 2);
+			BitWriter writer{ bytes };
+			writer.Write(1, 1); // last block
+			writer.Write(1, 2); // fixed Huffman codes
+
+			const auto& literalCodes{ GetFixedLiteralCodes() };
+			const auto getHash = [&](size_t i) {
+				const uint32_t key{ uint32_t(data[i]) | (uint32_t(data[i + 1]) << 8) | (uint32_t(data[i + 2]) << 16) };
+				return (key * 2654435761u) >> (32 - HashBits);
+				};
+
+			std::vector<int64_t> lastPositions(size_t(1) << HashBits, -1);
+			const size_t size{ data.size() };
+			size_t i{};
+			while (i < size)
+			{
+				uint32_t matchLength{};
+				uint32_t matchDistance{};
+				if (i + MinMatch <= size)
+				{
+					const uint32_t hash{ getHash(i) };
+					const int64_t candidate{ lastPositions[hash] };
+					lastPositions[hash] = int64_t(i);
+
+					if (candidate >= 0 && i - size_t(candidate) <= WindowSize)
+					{
+						const size_t maxLength{ std::min(size_t{ MaxMatch }, size - i) };
+						size_t length{};
+						while (length < maxLength && data[size_t(candidate) + length] == data[i + length])
+							++length;
+
+						if (length >= MinMatch)
+						{
+							matchLength = uint32_t(length);
+							matchDistance = uint32_t(i - size_t(candidate));
+						}
+					}
+				}
+
+				if (matchLength > 0)
+				{
+					WriteMatch(writer, matchLength, matchDistance);
+
+					// the skipped positions can still start later matches
+					for (size_t j{ i + 1 }; j < i + matchLength && j + MinMatch <= size; ++j)
+					{
+						lastPositions[getHash(j)] = int64_t(j);
+					}
+					i += matchLength;
+				}
+				else
+				{
+					const FixedCode& code{ literalCodes[data[i]] };
+					writer.Write(code.bits, code.length);
+					++i;
+				}
+			}
+
+			const FixedCode& endOfBlock{ literalCodes[256] };
+			writer.Write(endOfBlock.bits, endOfBlock.length);
+			writer.Flush();
+
+			AppendBigEndian(bytes, GetAdler32(data.data(), data.size()));
+			return bytes;
+		}
+
+		uint8_t GetPaethPredictor(uint8_t left, uint8_t up, uint8_t upLeft)
+		{
+			const int estimate{ int(left) + int(up) - int(upLeft) };
+			const int distanceLeft{ std::abs(estimate - int(left)) };
+			const int distanceUp{ std::abs(estimate - int(up)) };
+			const int distanceUpLeft{ std::abs(estimate - int(upLeft)) };
+
+			if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft)
+				return left;
+			return distanceUp <= distanceUpLeft ? up : upLeft;
+		}
+
+		//Every row gets the filter that leaves the smallest differences, the usual heuristic of PNG encoders
+		std::vector<uint8_t> FilterRows(const std::vector<uint8_t>& samples, size_t rowSize, uint32_t height, uint32_t bytesPerPixel)
+		{
+			std::vector<uint8_t> filtered((rowSize + 1) * height);
+			std::array<std::vector<uint8_t>, 5> candidates{};
+			for (std::vector<uint8_t>& candidate : candidates)
+			{
+				candidate.resize(rowSize);
+			}
+
+			const std::vector<uint8_t> emptyRow(rowSize);
+			for (uint32_t y{}; y < height; ++y)
+			{
+				const uint8_t* pRow{ samples.data() + y * rowSize };
+				const uint8_t* pUp{ y > 0 ? pRow - rowSize : emptyRow.data() };
+
+				uint32_t bestFilter{};
+				uint64_t bestCost{ UINT64_MAX };
+				for (uint32_t filter{}; filter < 5; ++filter)
+				{
+					uint64_t cost{};
+					for (size_t x{}; x < rowSize; ++x)
+					{
+						const uint8_t left{ x >= bytesPerPixel ? pRow[x - bytesPerPixel] : uint8_t{} };
+						const uint8_t upLeft{ x >= bytesPerPixel ? pUp[x - bytesPerPixel] : uint8_t{} };
+
+						uint8_t prediction{};
+						switch (filter)
+						{
+						case 1: prediction = left; break;
+						case 2: prediction = pUp[x]; break;
+						case 3: prediction = uint8_t((uint32_t(left) + pUp[x]) / 2); break;
+						case 4: prediction = GetPaethPredictor(left, pUp[x], upLeft); break;
+						default: break;
+						}
+
+						const uint8_t value{ uint8_t(pRow[x] - prediction) };
+						candidates[filter][x] = value;
+						cost += uint64_t(std::abs(int(int8_t(value))));
+					}
+
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestFilter = filter;
+					}
+				}
+
+				uint8_t* pFiltered{ filtered.data() + y * (rowSize + 1) };
+				pFiltered[0] = uint8_t(bestFilter);
+				std::copy(candidates[bestFilter].begin(), candidates[bestFilter].end(), pFiltered + 1);
+			}
+
+			return filtered;
+		}
+
+		void AppendChunk(std::vector<uint8_t>& bytes, const char type[4], const std::vector<uint8_t>& data)
+		{
+			AppendBigEndian(bytes, uint32_t(data.size()));
+			const size_t typeOffset{ bytes.size() };
+			bytes.insert(bytes.end(), type, type + 4);
+			bytes.insert(bytes.end(), data.begin(), data.end());
+
+			// the CRC covers the type and the data
+			const uint32_t crc{ UpdateCrc(0xFFFFFFFFu, bytes.data() + typeOffset, bytes.size() - typeOffset) ^ 0xFFFFFFFFu };
+			AppendBigEndian(bytes, crc);
+		}
+
+		bool WriteBytes(const std::string& fileName, const char* pData, size_t size)
+		{
+			std::ofstream file{ fileName, std::ios::binary | std::ios::trunc };
+			file.write(pData, std::streamsize(size));
+			return bool(file);
+		}
+
+		uint16_t ToSample(float value, float maxSample)
+		{
+			return uint16_t(std::clamp(value, 0.f, 1.f) * maxSample + .5f);
+		}
+
+		bool WritePNG(const std::string& fileName, const Image& image, uint32_t bitDepth)
+		{
+			const uint32_t bytesPerSample{ bitDepth / 8 };
+			const uint32_t bytesPerPixel{ bytesPerSample * 3 };
+			const size_t rowSize{ size_t(image.width) * bytesPerPixel };
+			const float maxSample{ float((1u << bitDepth) - 1) };
+
+			// samples are big endian
+			std::vector<uint8_t> samples(rowSize * image.height);
+			for (size_t i{}; i < image.pixels.size(); ++i)
+			{
+				const ColorRGB& color{ image.pixels[i] };
+				uint8_t* pSamples{ samples.data() + i * bytesPerPixel };
+				for (const float channel : { color.r, color.g, color.b })
+				{
+					const uint16_t sample{ ToSample(channel, maxSample) };
+					if (bytesPerSample == 2)
+						*pSamples++ = uint8_t(sample >> 8);
+					*pSamples++ = uint8_t(sample);
+				}
+			}
+
+			std::vector<uint8_t> header{};
+			AppendBigEndian(header, image.width);
+			AppendBigEndian(header, image.height);
+			header.insert(header.end(), { uint8_t(bitDepth), 2, 0, 0, 0 }); // RGB, deflate, adaptive filters, not interlaced
+
+			std::vector<uint8_t> bytes{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			AppendChunk(bytes, "IHDR", header);
+			AppendChunk(bytes, "IDAT", Compress(FilterRows(samples, rowSize, image.height, bytesPerPixel)));
+			AppendChunk(bytes, "IEND", {});
+
+			return WriteBytes(fileName, reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		}
+
+		bool WritePFM(const std::string& fileName, const Image& image)
+		{
+			// a negative scale marks little endian floats, rows go from the bottom up
+			const std::string header{ "PF\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n"
+				+ (std::endian::native == std::endian::little ? "-1.0\n" : "1.0\n") };
+
+			std::vector<float> rows(size_t(image.width) * image.height * 3);
+			for (uint32_t y{}; y < image.height; ++y)
+			{
+				const ColorRGB* pRow{ image.pixels.data() + size_t(image.height - 1 - y) * image.width };
+				float* pOutput{ rows.data() + size_t(y) * image.width * 3 };
+				for (uint32_t x{}; x < image.width; ++x)
+				{
+					pOutput[x * 3] = pRow[x].r;
+					pOutput[x * 3 + 1] = pRow[x].g;
+					pOutput[x * 3 + 2] = pRow[x].b;
+				}
+			}
+
+			std::ofstream file{ fileName, std::ios::binary | std::ios::trunc };
+			file << header;
+			file.write(reinterpret_cast<const char*>(rows.data()), std::streamsize(rows.size() * sizeof(float)));
+			return bool(file);
+		}
+
+		bool WritePPM(const std::string& fileName, const Image& image)
+		{
+			std::vector<uint8_t> rows(image.pixels.size() * 3);
+			for (size_t i{}; i < image.pixels.size(); ++i)
+			{
+				rows[i * 3] = uint8_t(ToSample(image.pixels[i].r, 255.f));
+				rows[i * 3 + 1] = uint8_t(ToSample(image.pixels[i].g, 255.f));
+				rows[i * 3 + 2] = uint8_t(ToSample(image.pixels[i].b, 255.f));
+			}
+
+			PPMStreamWriter writer{};
+			return writer.Open(fileName, image.width, image.height)
+				&& writer.WriteRows(rows.data(), image.height)
+				&& writer.Close();
+		}
+	}
+
+	const char* GetImageFormatName(ImageFormat format)
+	{
+		switch (format)
+		{
+		case ImageFormat::PNG16:
+			return "png16";
+		case ImageFormat::PFM:
+			return "pfm";
+		case ImageFormat::PPM:
+			return "ppm";
+		default:
+			return "png";
+		}
+	}
+
+	const char* GetImageFormatExtension(ImageFormat format)
+	{
+		return format == ImageFormat::PNG16 ? "png" : GetImageFormatName(format);
+	}
+
+	ImageFormat ParseImageFormat(const std::string& name)
+	{
+		if (name == "png16") return ImageFormat::PNG16;
+		if (name == "pfm") return ImageFormat::PFM;
+		if (name == "ppm") return ImageFormat::PPM;
+		return ImageFormat::PNG8;
+	}
+
+	bool WriteImage(const std::string& fileName, const Image& image, ImageFormat format)
+	{
+		if (image.pixels.size() != size_t(image.width) * image.height)
+			return false;
+
+		switch (format)
+		{
+		case ImageFormat::PNG16:
+			return WritePNG(fileName, image, 16);
+		case ImageFormat::PFM:
+			return WritePFM(fileName, image);
+		case ImageFormat::PPM:
+			return WritePPM(fileName, image);
+		default:
+			return WritePNG(fileName, image, 8);
+		}
+	}
+
+	bool PPMStreamWriter::Open(const std::string& fileName, uint32_t width, uint32_t height)
+	{
+		m_File.open(fileName, std::ios::binary | std::ios::trunc);
+		m_Width = width;
+		m_Height = height;
+		m_RowsWritten = 0;
+
+		m_File << "P6\n" << width << " " << height << "\n255\n";
+		return bool(m_File);
+	}
+
+	bool PPMStreamWriter::WriteRows(const uint8_t* pRows, uint32_t rowCount)
+	{
+		if (!m_File.is_open() || m_RowsWritten + rowCount > m_Height)
+			return false;
+
+		m_File.write(reinterpret_cast<const char*>(pRows), std::streamsize(size_t(m_Width) * 3 * rowCount));
+		m_RowsWritten += rowCount;
+		return bool(m_File);
+	}
+
+	bool PPMStreamWriter::Close()
+	{
+		if (!m_File.is_open())
+			return false;
+
+		m_File.close();
+		return !m_File.fail() && m_RowsWritten == m_Height;
+	}
+
+	AsyncImageWriter::AsyncImageWriter(uint32_t maxQueuedImages) :
+		m_MaxQueuedImages(std::max(1u, maxQueuedImages))
+	{
+		m_Worker = std::thread{ [this] { WorkerLoop(); } };
+	}
+
+	AsyncImageWriter::~AsyncImageWriter()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_Stop = true;
+		}
+		m_WakeCondition.notify_all();
+		m_Worker.join();
+	}
+
+	void AsyncImageWriter::Submit(Image image, const std::string& fileName, ImageFormat format)
+	{
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_DoneCondition.wait(lock, [this] { return m_Jobs.size() < m_MaxQueuedImages; });
+			m_Jobs.emplace_back(Job{ std::move(image), fileName, format });
+		}
+		m_WakeCondition.notify_one();
+	}
+
+	void AsyncImageWriter::Flush()
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_Jobs.empty() && !m_IsWriting; });
+	}
+
+	uint32_t AsyncImageWriter::GetWrittenCount() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		return m_WrittenCount;
+	}
+
+	uint32_t AsyncImageWriter::GetFailedCount() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		return m_FailedCount;
+	}
+
+	std::vector<std::string> AsyncImageWriter::TakeFailedFileNames()
+	{
+		std::lock_guard lock{ m_Mutex };
+		return std::exchange(m_FailedFileNames, {});
+	}
+
+	void AsyncImageWriter::WorkerLoop()
+	{
+		while (true)
+		{
+			Job job{};
+			{
+				// whatever is queued still gets written after a stop
+				std::unique_lock lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [this] { return m_Stop || !m_Jobs.empty(); });
+				if (m_Jobs.empty())
+					return;
+
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop_front();
+				m_IsWriting = true;
+			}
+			// a queue slot just opened up
+			m_DoneCondition.notify_all();
+
+			const bool isWritten{ WriteImage(job.fileName, job.image, job.format) };
+			{
+				std::lock_guard lock{ m_Mutex };
+				if (isWritten)
+				{
+					++m_WrittenCount;
+				}
+				else
+				{
+					++m_FailedCount;
+					m_FailedFileNames.emplace_back(job.fileName);
+				}
+				m_IsWriting = false;
+			}
+			m_DoneCondition.notify_all();
+		}
+	}
+}
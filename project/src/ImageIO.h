@@ -0,0 +1,116 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ColorRGB.h"
+
+namespace dae
+{
+	enum class ImageFormat
+	{
+		PNG8,	// 8 bit per channel PNG, the values as they are displayed
+		PNG16,	// 16 bit per channel PNG, the same values with more precision
+		PFM,	// 32 bit float per channel portable float map
+		PPM		// 8 bit binary PPM, uncompressed
+	};
+
+	const char* GetImageFormatName(ImageFormat format);
+	//Lowercase extension without the dot
+	const char* GetImageFormatExtension(ImageFormat format);
+	//"png", "png16", "pfm" or "ppm", anything else is PNG8
+	ImageFormat ParseImageFormat(const std::string& name);
+
+	//A copy of a framebuffer, row major from the top row down
+	struct Image
+	{
+		uint32_t width{};
+		uint32_t height{};
+		std::vector<ColorRGB> pixels{};
+	};
+
+	//Encodes and writes the whole image at once, false when the file could not be written
+	bool WriteImage(const std::string& fileName, const Image& image, ImageFormat format);
+
+	//Writes a binary PPM (P6) a few rows at a time, only the rows handed to WriteRows are ever in memory
+	class PPMStreamWriter final
+	{
+	public:
+		PPMStreamWriter() = default;
+		~PPMStreamWriter() = default;
+
+		PPMStreamWriter(const PPMStreamWriter&) = delete;
+		PPMStreamWriter(PPMStreamWriter&&) noexcept = delete;
+		PPMStreamWriter& operator=(const PPMStreamWriter&) = delete;
+		PPMStreamWriter& operator=(PPMStreamWriter&&) noexcept = delete;
+
+		//Creates the file and writes the header
+		bool Open(const std::string& fileName, uint32_t width, uint32_t height);
+		//rowCount rows of width RGB pixels, 3 bytes each, continuing below the rows written so far
+		bool WriteRows(const uint8_t* pRows, uint32_t rowCount);
+		//False when rows are missing or a write failed
+		bool Close();
+
+		uint32_t GetRowsWritten() const { return m_RowsWritten; }
+
+	private:
+		std::ofstream m_File{};
+		uint32_t m_Width{};
+		uint32_t m_Height{};
+		uint32_t m_RowsWritten{};
+	};
+
+	//Encodes and writes images on a background thread, so saving a frame sequence doesn't hold up rendering
+	//Submit only blocks while maxQueuedImages images are still waiting, which bounds the memory of a slow disk
+	class AsyncImageWriter final
+	{
+	public:
+		explicit AsyncImageWriter(uint32_t maxQueuedImages = 4);
+		//Writes everything still queued before returning
+		~AsyncImageWriter();
+
+		AsyncImageWriter(const AsyncImageWriter&) = delete;
+		AsyncImageWriter(AsyncImageWriter&&) noexcept = delete;
+		AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+		AsyncImageWriter& operator=(AsyncImageWriter&&) noexcept = delete;
+
+		void Submit(Image image, const std::string& fileName, ImageFormat format);
+		//Blocks until every submitted image is written
+		void Flush();
+
+		uint32_t GetWrittenCount() const;
+		//Images that could not be written, their file names are kept until the next call to TakeFailedFileNames
+		uint32_t GetFailedCount() const;
+		std::vector<std::string> TakeFailedFileNames();
+
+	private:
+		struct Job
+		{
+			Image image{};
+			std::string fileName{};
+			ImageFormat format{};
+		};
+
+		const uint32_t m_MaxQueuedImages;
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+		std::deque<Job> m_Jobs{};
+		bool m_IsWriting{ false };
+		bool m_Stop{ false };
+
+		uint32_t m_WrittenCount{};
+		uint32_t m_FailedCount{};
+		std::vector<std::string> m_FailedFileNames{};
+
+		std::thread m_Worker{};
+
+		void WorkerLoop();
+	};
+}
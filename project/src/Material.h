@@ -1,44 +1,39 @@
 #pragma once
+#include <array>
+#include <cassert>
+#include <climits>
+#include <vector>
+
 #include "Maths.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
+#include "Utils.h"
 
 namespace dae
 {
-#pragma region Material BASE
-	class Material
+#pragma region Material TYPES
+	//Every material is a plain record, the MaterialTable keeps one array per type and shades them by type tag
+	enum class MaterialType : unsigned char
 	{
-	public:
-		Material() = default;
-		virtual ~Material() = default;
-
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
-
-		/**
-		 * \brief Function used to calculate the correct color for the specific material and its parameters
-		 * \param hitRecord current hitrecord
-		 * \param l light direction
-		 * \param v view direction
-		 * \return color
-		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence
 	};
+	constexpr size_t MaterialTypeCount{ 4 };
 #pragma endregion
 
 #pragma region Material SOLID COLOR
 	//SOLID COLOR
 	//===========
-	class Material_SolidColor final : public Material
+	class Material_SolidColor final
 	{
 	public:
 		Material_SolidColor(const ColorRGB& color) : m_Color(color)
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+		ColorRGB Shade(const Vector3& n, const Vector3& l, const Vector3& v) const
 		{
 			return m_Color;
 		}
@@ -51,13 +46,13 @@ namespace dae
 #pragma region Material LAMBERT
 	//LAMBERT
 	//=======
-	class Material_Lambert final : public Material
+	class Material_Lambert final
 	{
 	public:
 		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
 			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance) {}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const Vector3& n = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			////todo: W3
 			//throw std::runtime_error("Not Implemented Yet");
@@ -73,7 +68,7 @@ namespace dae
 #pragma region Material LAMBERT PHONG
 	//LAMBERT-PHONG
 	//=============
-	class Material_LambertPhong final : public Material
+	class Material_LambertPhong final
 	{
 	public:
 		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent) :
@@ -82,12 +77,12 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const Vector3& n = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			////todo: W3
 			//throw std::runtime_error("Not Implemented Yet");
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) + 
-				BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
+				BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, n);
 		}
 
 	private:
@@ -100,49 +95,143 @@ namespace dae
 
 #pragma region Material COOK TORRENCE
 	//COOK TORRENCE
-	class Material_CookTorrence final : public Material
+	class Material_CookTorrence final
 	{
 	public:
 		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness) :
-			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
+			m_Parameters{ albedo, metalness, roughness }
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const Vector3& n = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
-			////todo: W3
-			//throw std::runtime_error("Not Implemented Yet");
-			const Vector3 h{ ((v + l) / (v + l).Magnitude()).Normalized()};
-			
-			ColorRGB kd{};
-			ColorRGB f0{ ColorRGB{0.04f, 0.04f, 0.04f } };
+			return BRDF::CookTorrence(m_Parameters, n, l, v);
+		}
+
+		const BRDF::CookTorrenceParameters& GetParameters() const { return m_Parameters; }
+
+	private:
+		BRDF::CookTorrenceParameters m_Parameters{};
+	};
+#pragma endregion
+
+#pragma region Material TABLE
+	//Type tag and index in the array of that type, what a material id of a HitRecord resolves to
+	struct MaterialHandle
+	{
+		MaterialType type{};
+		uint32_t index{};
+	};
+
+	//Flat, devirtualized material storage: one contiguous array per material type, material ids index the handles
+	class MaterialTable final
+	{
+	public:
+		unsigned char Add(const Material_SolidColor& material) { return AddMaterial(MaterialType::SolidColor, m_SolidColors, material); }
+		unsigned char Add(const Material_Lambert& material) { return AddMaterial(MaterialType::Lambert, m_Lamberts, material); }
+		unsigned char Add(const Material_LambertPhong& material) { return AddMaterial(MaterialType::LambertPhong, m_LambertPhongs, material); }
+		unsigned char Add(const Material_CookTorrence& material) { return AddMaterial(MaterialType::CookTorrence, m_CookTorrences, material.GetParameters()); }
+
+		const MaterialHandle& GetHandle(unsigned char materialId) const { return m_Handles[materialId]; }
+		size_t GetCount() const { return m_Handles.size(); }
+
+		//Shades samples that all use materials of the given type, one loop per type and no virtual calls
+		void Shade(MaterialType type, const std::vector<ShadingSample>& samples, std::vector<ColorRGB>& colors) const
+		{
+			colors.resize(samples.size());
+
+			switch (type)
+			{
+			case MaterialType::SolidColor:
+				ShadeSamples(m_SolidColors, samples, colors);
+				break;
+			case MaterialType::Lambert:
+				ShadeSamples(m_Lamberts, samples, colors);
+				break;
+			case MaterialType::LambertPhong:
+				ShadeSamples(m_LambertPhongs, samples, colors);
+				break;
+			case MaterialType::CookTorrence:
+				// the only BRDF with a wide kernel, Phong's powf with a per material exponent has no vector form here
+				BRDF::CookTorrence(m_CookTorrences.data(), samples.data(), colors.data(), samples.size());
+				break;
+			}
+		}
 
-			if (m_Metalness == 1.f)
+	private:
+		std::vector<MaterialHandle> m_Handles{};
+
+		std::vector<Material_SolidColor> m_SolidColors{};
+		std::vector<Material_Lambert> m_Lamberts{};
+		std::vector<Material_LambertPhong> m_LambertPhongs{};
+		std::vector<BRDF::CookTorrenceParameters> m_CookTorrences{};
+
+		template<typename TMaterial>
+		unsigned char AddMaterial(MaterialType type, std::vector<TMaterial>& materials, const TMaterial& material)
+		{
+			// material ids are stored as unsigned char in every primitive
+			assert(m_Handles.size() <= UCHAR_MAX);
+
+			m_Handles.push_back({ type, static_cast<uint32_t>(materials.size()) });
+			materials.push_back(material);
+			return static_cast<unsigned char>(m_Handles.size() - 1);
+		}
+
+		template<typename TMaterial>
+		static void ShadeSamples(const std::vector<TMaterial>& materials, const std::vector<ShadingSample>& samples, std::vector<ColorRGB>& colors)
+		{
+			for (size_t i{}; i < samples.size(); ++i)
 			{
-				f0 = m_Albedo;
+				const ShadingSample& sample{ samples[i] };
+				colors[i] = materials[sample.materialIndex].Shade(sample.normal, sample.l, sample.v);
 			}
+		}
+	};
+#pragma endregion
 
-			const ColorRGB F{ BRDF::FresnelFunction_Schlick(h, v, f0) };
-			const float D{ BRDF::NormalDistribution_GGX(hitRecord.normal, h, m_Roughness) };
-			const float G{ BRDF::GeometryFunction_Smith(hitRecord.normal, v, l, m_Roughness) };
+#pragma region Material BATCH
+	//Where the color of a queued sample ends up after ShadingBatch::Shade
+	struct ShadingSlot
+	{
+		MaterialType type{};
+		uint32_t index{};
+	};
+
+	//Collects the light samples of many hits, grouped by material type, so every type gets shaded in one tight loop
+	//Not thread safe, the renderer keeps one per tile like the ShadowCache
+	class ShadingBatch final
+	{
+	public:
+		ShadingSlot Add(const MaterialTable& materials, unsigned char materialId, const Vector3& n, const Vector3& l, const Vector3& v)
+		{
+			const MaterialHandle& handle{ materials.GetHandle(materialId) };
+			std::vector<ShadingSample>& samples{ m_Samples[size_t(handle.type)] };
 
-			if (m_Metalness == 0.f) {
-				kd = colors::White - F;
+			samples.push_back({ handle.index, n, l, v });
+			return { handle.type, static_cast<uint32_t>(samples.size() - 1) };
+		}
+
+		void Shade(const MaterialTable& materials)
+		{
+			for (size_t type{}; type < MaterialTypeCount; ++type)
+			{
+				if (!m_Samples[type].empty())
+					materials.Shade(static_cast<MaterialType>(type), m_Samples[type], m_Colors[type]);
 			}
+		}
 
-			const ColorRGB specular{ (D * F * G) / (4 * (Vector3::Dot(v, hitRecord.normal) * Vector3::Dot(l, hitRecord.normal))) };
-			const ColorRGB diffuse{ BRDF::Lambert(kd, m_Albedo) };
+		const ColorRGB& GetColor(const ShadingSlot& slot) const { return m_Colors[size_t(slot.type)][slot.index]; }
 
-			return kd * diffuse + f0 * specular;
-			//return D * colors::White;
-			//return F;
-			//return G * colors::White;
+		//Keeps the allocations for the next batch
+		void Clear()
+		{
+			for (std::vector<ShadingSample>& samples : m_Samples)
+				samples.clear();
 		}
 
 	private:
-		ColorRGB m_Albedo{ 0.955f, 0.637f, 0.538f }; //Copper
-		float m_Metalness{ 1.0f };
-		float m_Roughness{ 0.1f }; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
+		std::array<std::vector<ShadingSample>, MaterialTypeCount> m_Samples{};
+		std::array<std::vector<ColorRGB>, MaterialTypeCount> m_Colors{};
 	};
 #pragma endregion
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <cmath>
 #include <cfloat>
+#include <cstdint>
 
 namespace dae
 {
@@ -28,4 +29,50 @@ namespace dae
 	{
 		return abs(a - b) < epsilon;
 	}
+
+	//Interleaves the bits of x and y, sorting by the result walks a grid along a Z-order (Morton) curve
+	inline uint32_t MortonEncode2D(uint16_t x, uint16_t y)
+	{
+		auto spreadBits = [](uint32_t v)
+			{
+				v = (v | (v << 8)) & 0x00FF00FF;
+				v = (v | (v << 4)) & 0x0F0F0F0F;
+				v = (v | (v << 2)) & 0x33333333;
+				v = (v | (v << 1)) & 0x55555555;
+				return v;
+			};
+
+		return spreadBits(x) | (spreadBits(y) << 1);
+	}
+
+	//Interleaves the lower 20 bits of x, y and z, the 3D counterpart of MortonEncode2D
+	inline uint64_t MortonEncode3D(uint32_t x, uint32_t y, uint32_t z)
+	{
+		auto spreadBits = [](uint64_t v)
+			{
+				v &= 0xFFFFF;
+				v = (v | (v << 32)) & 0x001F00000000FFFF;
+				v = (v | (v << 16)) & 0x001F0000FF0000FF;
+				v = (v | (v << 8)) & 0x100F00F00F00F00F;
+				v = (v | (v << 4)) & 0x10C30C30C30C30C3;
+				v = (v | (v << 2)) & 0x1249249249249249;
+				return v;
+			};
+
+		return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+	}
+
+	//Radical inverse of index in the given base, a low discrepancy sequence in [0, 1)
+	inline float Halton(uint32_t index, uint32_t base)
+	{
+		float result{ 0.f };
+		float fraction{ 1.f / float(base) };
+		while (index > 0)
+		{
+			result += float(index % base) * fraction;
+			index /= base;
+			fraction /= float(base);
+		}
+		return result;
+	}
 }
@@ -1,7 +1,13 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+
+#include "SIMD.h"
 #include "Vector3.h"
 #include "Vector4.h"
 
+//Header only, so every transform can be inlined into the hot loops
+//Rows are Vector4s, products and transforms are linear combinations of whole rows on SSE with a scalar fallback
 namespace dae {
 	struct Matrix
 	{
@@ -10,43 +16,338 @@ namespace dae {
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
 		Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
-
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
-		const Matrix& Transpose();
-
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
-
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
-		static Matrix CreateRotationX(float pitch);
-		static Matrix CreateRotationY(float yaw);
-		static Matrix CreateRotationZ(float roll);
-		static Matrix CreateRotation(float pitch, float yaw, float roll);
-		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
-		bool operator==(const Matrix& m) const;
+			const Vector4& t)
+		{
+			data[0] = xAxis;
+			data[1] = yAxis;
+			data[2] = zAxis;
+			data[3] = t;
+		}
+
+		Matrix(const Matrix& m) = default;
+		Matrix& operator=(const Matrix& m) = default;
+
+		Vector3 TransformVector(const Vector3& v) const
+		{
+			return TransformVector(v.x, v.y, v.z);
+		}
+
+		Vector3 TransformVector(float x, float y, float z) const
+		{
+#if defined(DAE_SIMD_SSE)
+			const __m128 result{ _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(data[0].ToSIMD(), _mm_set1_ps(x)),
+				_mm_mul_ps(data[1].ToSIMD(), _mm_set1_ps(y))),
+				_mm_mul_ps(data[2].ToSIMD(), _mm_set1_ps(z))) };
+			return Vector4{ result };
+#else
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z,
+				data[0].y * x + data[1].y * y + data[2].y * z,
+				data[0].z * x + data[1].z * y + data[2].z * z
+			};
+#endif
+		}
+
+		Vector3 TransformPoint(const Vector3& p) const
+		{
+			return TransformPoint(p.x, p.y, p.z);
+		}
+
+		Vector3 TransformPoint(float x, float y, float z) const
+		{
+#if defined(DAE_SIMD_SSE)
+			const __m128 result{ _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(data[0].ToSIMD(), _mm_set1_ps(x)),
+				_mm_mul_ps(data[1].ToSIMD(), _mm_set1_ps(y))),
+				_mm_mul_ps(data[2].ToSIMD(), _mm_set1_ps(z))),
+				data[3].ToSIMD()) };
+			return Vector4{ result };
+#else
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+			};
+#endif
+		}
+
+		const Matrix& Transpose()
+		{
+#if defined(DAE_SIMD_SSE)
+			__m128 row0{ data[0].ToSIMD() };
+			__m128 row1{ data[1].ToSIMD() };
+			__m128 row2{ data[2].ToSIMD() };
+			__m128 row3{ data[3].ToSIMD() };
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+			data[0] = Vector4{ row0 };
+			data[1] = Vector4{ row1 };
+			data[2] = Vector4{ row2 };
+			data[3] = Vector4{ row3 };
+#else
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					result[r][c] = data[c][r];
+				}
+			}
+
+			data[0] = result[0];
+			data[1] = result[1];
+			data[2] = result[2];
+			data[3] = result[3];
+#endif
+
+			return *this;
+		}
+
+		const Matrix& Inverse()
+		{
+			// Affine inverse: the matrix is a 3x3 linear part A (rows 0-2) and a translation t (row 3)
+			// p' = p * A + t  >>  p = (p' - t) * A^-1
+			const Vector3 a{ data[0] };
+			const Vector3 b{ data[1] };
+			const Vector3 c{ data[2] };
+			const Vector3 t{ data[3] };
+
+			const Vector3 bc{ Vector3::Cross(b, c) };
+			const Vector3 ca{ Vector3::Cross(c, a) };
+			const Vector3 ab{ Vector3::Cross(a, b) };
+
+			const float invDeterminant{ 1.f / Vector3::Dot(a, bc) };
+
+			// columns of A^-1 are bc, ca and ab divided by the determinant
+			const Vector3 xAxis{ Vector3{ bc.x, ca.x, ab.x } * invDeterminant };
+			const Vector3 yAxis{ Vector3{ bc.y, ca.y, ab.y } * invDeterminant };
+			const Vector3 zAxis{ Vector3{ bc.z, ca.z, ab.z } * invDeterminant };
+			const Vector3 translation{ -(xAxis * t.x + yAxis * t.y + zAxis * t.z) };
+
+			data[0] = { xAxis, 0 };
+			data[1] = { yAxis, 0 };
+			data[2] = { zAxis, 0 };
+			data[3] = { translation, 1 };
+
+			return *this;
+		}
+
+		Vector3 GetAxisX() const
+		{
+			return data[0];
+		}
+
+		Vector3 GetAxisY() const
+		{
+			return data[1];
+		}
+
+		Vector3 GetAxisZ() const
+		{
+			return data[2];
+		}
+
+		Vector3 GetTranslation() const
+		{
+			return data[3];
+		}
+
+		static Matrix CreateTranslation(float x, float y, float z)
+		{
+			////todo W2
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+			Matrix translation{
+				Vector4{	1,	0,	0,	0	},
+				Vector4{	0,	1,	0,	0	},
+				Vector4{	0,	0,	1,	0	},
+				Vector4{	x,	y,	z,	1	}
+			};
+
+			return translation;
+		}
+
+		static Matrix CreateTranslation(const Vector3& t)
+		{
+			return { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, t };
+		}
+
+		static Matrix CreateRotationX(float pitch)
+		{
+			////todo W2
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+			Matrix rotationX{
+				Vector4{1,0,0,0},
+				Vector4{0,cos(pitch),sin(pitch),0},
+				Vector4{0,-sin(pitch),cos(pitch),0},
+				Vector4{0,0,0,1}
+			};
+
+			return rotationX;
+		}
+
+		static Matrix CreateRotationY(float yaw)
+		{
+			////todo W2
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+			Matrix rotationY{
+				Vector4{cos(yaw),0,-sin(yaw), 0},
+				Vector4{0,1,0,0},
+				Vector4{sin(yaw),0,cos(yaw),0},
+				Vector4{0,0,0,1}
+			};
+
+			return rotationY;
+		}
+
+		static Matrix CreateRotationZ(float roll)
+		{
+			////todo W2
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+			Matrix rotationZ{
+				Vector4{cos(roll),sin(roll),0, 0},
+				Vector4{-sin(roll),cos(roll),0, 0},
+				Vector4{0,0,1, 0},
+				Vector4{0,0,0, 1}
+			};
+
+			return rotationZ;
+		}
+
+		static Matrix CreateRotation(float pitch, float yaw, float roll)
+		{
+			return CreateRotation({ pitch, yaw, roll });
+		}
+
+		static Matrix CreateRotation(const Vector3& r)
+		{
+			////todo W2
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+			float cosX = cos(r[0]); // Pitch
+			float sinX = sin(r[0]);
+			float cosY = cos(r[1]); // Yaw
+			float sinY = sin(r[1]);
+			float cosZ = cos(r[2]); // Roll
+			float sinZ = sin(r[2]);
+
+			Matrix rotation{
+				Vector4{
+					cosY * cosZ,
+					cosY * sinZ,
+					-sinY,
+					0
+				},
+				Vector4{
+					sinX * sinY * cosZ - cosX * sinZ,
+					sinX * sinY * sinZ + cosX * cosZ,
+					sinX * cosY,
+					0
+				},
+				Vector4{
+					cosX * sinY * cosZ + sinX * sinZ,
+					cosX * sinY * sinZ - sinX * cosZ,
+					cosX * cosY,
+					0
+				},
+				Vector4{0, 0, 0, 1} // Homogeneous coordinate row
+			};
+
+			return rotation;
+		}
+
+		static Matrix CreateScale(float sx, float sy, float sz)
+		{
+			////todo W2
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+			Matrix scale{
+				Vector4{sx,0,0, 0},
+				Vector4{0,sy,0,0},
+				Vector4{0,0,sz,0},
+				Vector4{0,0,0,1}
+			};
+
+			return scale;
+		}
+
+		static Matrix CreateScale(const Vector3& s)
+		{
+			return CreateScale(s[0], s[1], s[2]);
+		}
+
+		static Matrix Transpose(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Transpose();
+
+			return out;
+		}
+
+		static Matrix Inverse(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Inverse();
+
+			return out;
+		}
+
+		Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		Vector4 operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		Matrix operator*(const Matrix& m) const
+		{
+			// every row of the result is a combination of the rows of m, no transposed copy needed
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				result.data[r] = CombineRows(data[r], m);
+			}
+
+			return result;
+		}
+
+		const Matrix& operator*=(const Matrix& m)
+		{
+			*this = *this * m;
+			return *this;
+		}
+
+		bool operator==(const Matrix& m) const
+		{
+			return data[0] == m.data[0]
+				&& data[1] == m.data[1]
+				&& data[2] == m.data[2]
+				&& data[3] == m.data[3];
+		}
 
 	private:
 
@@ -63,5 +364,20 @@ namespace dae {
 		// v1x v1y v1z v1w
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
+
+		//weights.x * m[0] + weights.y * m[1] + weights.z * m[2] + weights.w * m[3]
+		static Vector4 CombineRows(const Vector4& weights, const Matrix& m)
+		{
+#if defined(DAE_SIMD_SSE)
+			const __m128 row{ weights.ToSIMD() };
+			return Vector4{ _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), m.data[0].ToSIMD()),
+				_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), m.data[1].ToSIMD())),
+				_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), m.data[2].ToSIMD())),
+				_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), m.data[3].ToSIMD())) };
+#else
+			return m.data[0] * weights.x + m.data[1] * weights.y + m.data[2] * weights.z + m.data[3] * weights.w;
+#endif
+		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,651 @@
+#include "MeshIO.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ThreadPool.h"
+
+namespace dae
+{
+	namespace MeshIO
+	{
+		namespace
+		{
+			//Read only view of a whole file, pages are loaded by the OS as the parser touches them
+			class MappedFile final
+			{
+			public:
+				explicit MappedFile(const std::string& filename)
+				{
+#if defined(_WIN32)
+					m_File = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+					if (m_File == INVALID_HANDLE_VALUE)
+						return;
+
+					LARGE_INTEGER size{};
+					if (!GetFileSizeEx(m_File, &size))
+						return;
+
+					// an empty file maps nothing and is still valid
+					m_Size = static_cast<size_t>(size.QuadPart);
+					m_IsOpen = m_Size == 0;
+					if (m_IsOpen)
+						return;
+
+					m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+					if (m_Mapping)
+						m_pData = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+					m_File = open(filename.c_str(), O_RDONLY);
+					if (m_File < 0)
+						return;
+
+					struct stat status{};
+					if (fstat(m_File, &status) != 0)
+						return;
+
+					// an empty file maps nothing and is still valid
+					m_Size = static_cast<size_t>(status.st_size);
+					m_IsOpen = m_Size == 0;
+					if (m_IsOpen)
+						return;
+
+					void* pData{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0) };
+					if (pData != MAP_FAILED)
+					{
+						madvise(pData, m_Size, MADV_SEQUENTIAL);
+						m_pData = static_cast<const char*>(pData);
+					}
+#endif
+					m_IsOpen = m_pData != nullptr;
+				}
+
+				~MappedFile()
+				{
+#if defined(_WIN32)
+					if (m_pData)
+						UnmapViewOfFile(m_pData);
+					if (m_Mapping)
+						CloseHandle(m_Mapping);
+					if (m_File != INVALID_HANDLE_VALUE)
+						CloseHandle(m_File);
+#else
+					if (m_pData)
+						munmap(const_cast<char*>(m_pData), m_Size);
+					if (m_File >= 0)
+						close(m_File);
+#endif
+				}
+
+				MappedFile(const MappedFile&) = delete;
+				MappedFile(MappedFile&&) noexcept = delete;
+				MappedFile& operator=(const MappedFile&) = delete;
+				MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+				bool IsOpen() const { return m_IsOpen; }
+				const char* GetData() const { return m_pData; }
+				size_t GetSize() const { return m_Size; }
+
+			private:
+#if defined(_WIN32)
+				HANDLE m_File{ INVALID_HANDLE_VALUE };
+				HANDLE m_Mapping{};
+#else
+				int m_File{ -1 };
+#endif
+				const char* m_pData{};
+				size_t m_Size{};
+				bool m_IsOpen{ false };
+			};
+
+			//What one thread parsed from its range of lines
+			struct Chunk
+			{
+				const char* pBegin{};
+				const char* pEnd{};
+
+				std::vector<Vector3> positions{};
+				std::vector<int> indices{};
+				//Entries of indices that were negative in the file, they count from the positions of this chunk
+				//and get the positions of the chunks before it added once those are known
+				std::vector<size_t> relativeIndices{};
+				bool isValid{ true };
+			};
+
+			bool IsSpace(char c)
+			{
+				return c == ' ' || c == '\t';
+			}
+
+			bool IsLineEnd(char c)
+			{
+				return c == '\n' || c == '\r';
+			}
+
+			const char* SkipSpaces(const char* p, const char* pEnd)
+			{
+				while (p < pEnd && IsSpace(*p))
+					++p;
+				return p;
+			}
+
+			//Past the next '\n', no limit on the line length
+			const char* SkipLine(const char* p, const char* pEnd)
+			{
+				const char* pNewLine{ std::find(p, pEnd, '\n') };
+				return pNewLine == pEnd ? pEnd : pNewLine + 1;
+			}
+
+			template<typename T>
+			bool ParseNumber(const char*& p, const char* pEnd, T& value)
+			{
+				// from_chars takes a leading '-' but no '+'
+				if (p < pEnd && *p == '+')
+					++p;
+
+				const auto [pNext, error] { std::from_chars(p, pEnd, value) };
+				if (error != std::errc{})
+					return false;
+
+				p = pNext;
+				return true;
+			}
+
+			//One corner of a face: v, v/vt, v//vn or v/vt/vn, only v is kept
+			bool ParseFaceVertex(const char*& p, const char* pEnd, int& positionIndex)
+			{
+				if (!ParseNumber(p, pEnd, positionIndex) || positionIndex == 0)
+					return false;
+
+				int unusedIndex{};
+				for (int slash{}; slash < 2 && p < pEnd && *p == '/'; ++slash)
+				{
+					++p;
+					if (p < pEnd && *p != '/' && !ParseNumber(p, pEnd, unusedIndex))
+						return false;
+				}
+
+				return p == pEnd || IsSpace(*p) || IsLineEnd(*p);
+			}
+
+			struct FaceCorner
+			{
+				int index{};
+				bool isRelative{};
+			};
+
+			void ParseChunk(Chunk& chunk)
+			{
+				const char* p{ chunk.pBegin };
+				const char* pEnd{ chunk.pEnd };
+				std::vector<FaceCorner> face{};
+
+				while (p < pEnd && chunk.isValid)
+				{
+					p = SkipSpaces(p, pEnd);
+					if (p + 1 < pEnd && IsSpace(p[1]))
+					{
+						if (*p == 'v')
+						{
+							// a fourth (w) component is ignored with the rest of the line
+							Vector3 position{};
+							p += 2;
+							for (int axis{}; axis < 3 && chunk.isValid; ++axis)
+							{
+								p = SkipSpaces(p, pEnd);
+								chunk.isValid = ParseNumber(p, pEnd, position[axis]);
+							}
+							chunk.positions.emplace_back(position);
+						}
+						else if (*p == 'f')
+						{
+							face.clear();
+							p = SkipSpaces(p + 2, pEnd);
+							while (p < pEnd && !IsLineEnd(*p) && *p != '#')
+							{
+								int positionIndex{};
+								if (!ParseFaceVertex(p, pEnd, positionIndex))
+								{
+									chunk.isValid = false;
+									break;
+								}
+
+								// 1 based, negative counts back from the last position read so far
+								if (positionIndex < 0)
+									face.emplace_back(FaceCorner{ int(chunk.positions.size()) + positionIndex, true });
+								else
+									face.emplace_back(FaceCorner{ positionIndex - 1, false });
+								p = SkipSpaces(p, pEnd);
+							}
+
+							if (face.size() < 3)
+								chunk.isValid = false;
+
+							// fan around the first corner
+							for (size_t corner{ 1 }; chunk.isValid && corner + 1 < face.size(); ++corner)
+							{
+								for (const FaceCorner& faceCorner : { face[0], face[corner], face[corner + 1] })
+								{
+									if (faceCorner.isRelative)
+										chunk.relativeIndices.emplace_back(chunk.indices.size());
+									chunk.indices.emplace_back(faceCorner.index);
+								}
+							}
+						}
+					}
+
+					// comments, vt, vn, groups, materials and smoothing groups are skipped
+					p = SkipLine(p, pEnd);
+				}
+			}
+
+			bool ParseOBJ(const char* pData, size_t size, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+			{
+				// small files aren't worth starting threads for
+				constexpr size_t MinChunkSize{ 1 << 20 };
+				const uint32_t threadCount{ std::max(1u, std::thread::hardware_concurrency()) };
+				const uint32_t chunkCount{ static_cast<uint32_t>(std::clamp(size / MinChunkSize, size_t{ 1 }, size_t{ threadCount } * 4)) };
+
+				std::unique_ptr<ThreadPool> pThreadPool{};
+				if (chunkCount > 1)
+					pThreadPool = std::make_unique<ThreadPool>(threadCount);
+
+				const auto runJobs = [&](uint32_t jobCount, const std::function<void(uint32_t)>& job) {
+					if (pThreadPool)
+					{
+						pThreadPool->ParallelFor(jobCount, job);
+						return;
+					}
+
+					for (uint32_t jobIndex{}; jobIndex < jobCount; ++jobIndex)
+					{
+						job(jobIndex);
+					}
+					};
+
+				// every chunk starts at the beginning of a line
+				std::vector<Chunk> chunks(chunkCount);
+				for (uint32_t i{}; i < chunkCount; ++i)
+				{
+					chunks[i].pBegin = i == 0 ? pData : chunks[i - 1].pEnd;
+					chunks[i].pEnd = i + 1 == chunkCount ? pData + size
+						: std::max(chunks[i].pBegin, SkipLine(pData + size * (i + 1) / chunkCount, pData + size));
+				}
+
+				runJobs(chunkCount, [&](uint32_t chunkIndex) {
+					ParseChunk(chunks[chunkIndex]);
+					});
+
+				std::vector<size_t> positionOffsets(chunkCount + 1);
+				std::vector<size_t> indexOffsets(chunkCount + 1);
+				for (uint32_t i{}; i < chunkCount; ++i)
+				{
+					if (!chunks[i].isValid)
+						return false;
+
+					positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+					indexOffsets[i + 1] = indexOffsets[i] + chunks[i].indices.size();
+				}
+
+				const size_t basePosition{ positions.size() };
+				const size_t baseIndex{ indices.size() };
+				const size_t baseNormal{ normals.size() };
+				positions.resize(basePosition + positionOffsets[chunkCount]);
+				indices.resize(baseIndex + indexOffsets[chunkCount]);
+				normals.resize(baseNormal + indexOffsets[chunkCount] / 3);
+
+				// indices in the file count from the first position of the file, not of the mesh
+				std::vector<uint8_t> isChunkValid(chunkCount, 1);
+				runJobs(chunkCount, [&](uint32_t chunkIndex) {
+					Chunk& chunk{ chunks[chunkIndex] };
+					std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + basePosition + positionOffsets[chunkIndex]);
+
+					for (size_t relativeIndex : chunk.relativeIndices)
+					{
+						chunk.indices[relativeIndex] += int(positionOffsets[chunkIndex]);
+					}
+
+					const int positionCount{ int(positionOffsets[chunkCount]) };
+					int* pIndices{ indices.data() + baseIndex + indexOffsets[chunkIndex] };
+					for (size_t i{}; i < chunk.indices.size(); ++i)
+					{
+						const int index{ chunk.indices[i] };
+						if (index < 0 || index >= positionCount)
+							isChunkValid[chunkIndex] = 0;
+						pIndices[i] = index + int(basePosition);
+					}
+					});
+
+				if (std::find(isChunkValid.begin(), isChunkValid.end(), 0) != isChunkValid.end())
+				{
+					positions.resize(basePosition);
+					indices.resize(baseIndex);
+					normals.resize(baseNormal);
+					return false;
+				}
+
+				//Precompute normals
+				runJobs(chunkCount, [&](uint32_t chunkIndex) {
+					const size_t firstTriangle{ indexOffsets[chunkIndex] / 3 };
+					const size_t lastTriangle{ indexOffsets[chunkIndex + 1] / 3 };
+					for (size_t triangle{ firstTriangle }; triangle < lastTriangle; ++triangle)
+					{
+						const int* pTriangle{ indices.data() + baseIndex + triangle * 3 };
+						const Vector3 edgeV0V1{ positions[pTriangle[1]] - positions[pTriangle[0]] };
+						const Vector3 edgeV0V2{ positions[pTriangle[2]] - positions[pTriangle[0]] };
+						normals[baseNormal + triangle] = Vector3::Cross(edgeV0V1, edgeV0V2).Normalized();
+					}
+					});
+
+				return true;
+			}
+
+			enum class MeshCacheSection : uint32_t
+			{
+				Positions,
+				Normals,
+				Indices,
+				Nodes,
+				PrimitiveIndices,
+				TrianglePacks,
+				LeafPackOffsets,
+				Count
+			};
+
+			constexpr size_t MeshCacheSectionCount{ size_t(MeshCacheSection::Count) };
+			//Enough for every stored type, TrianglePack included, so a mapped section can be read in place
+			constexpr uint64_t MeshCacheAlignment{ 32 };
+			constexpr char MeshCacheMagic[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+
+			struct MeshCacheHeader
+			{
+				char magic[8]{};
+				uint32_t version{};
+				//Layout of the stored structures, a cache from a build with other sizes is rebuilt
+				uint32_t nodeSize{};
+				uint32_t packSize{};
+				uint32_t packWidth{};
+				uint64_t sourceSize{};
+				uint64_t sourceHash{};
+				Vector3 minAABB{};
+				Vector3 maxAABB{};
+
+				struct Section
+				{
+					uint64_t offset{}; //from the start of the file
+					uint64_t count{}; //elements
+				};
+				Section sections[MeshCacheSectionCount]{};
+			};
+
+			//FNV-1a over 8 byte words, only has to notice that the OBJ changed, not resist anyone
+			uint64_t HashBytes(const char* pData, size_t size)
+			{
+				constexpr uint64_t Prime{ 0x100000001B3ull };
+				uint64_t hash{ 0xCBF29CE484222325ull };
+
+				size_t i{};
+				for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+				{
+					uint64_t word{};
+					std::memcpy(&word, pData + i, sizeof(uint64_t));
+					hash = (hash ^ word) * Prime;
+				}
+				for (; i < size; ++i)
+				{
+					hash = (hash ^ uint64_t(uint8_t(pData[i]))) * Prime;
+				}
+
+				return hash;
+			}
+
+			MeshCacheHeader CreateMeshCacheHeader(uint64_t sourceSize, uint64_t sourceHash)
+			{
+				MeshCacheHeader header{};
+				std::memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+				header.version = MeshCacheVersion;
+				header.nodeSize = sizeof(BVHNode);
+				header.packSize = sizeof(TrianglePack);
+				header.packWidth = TrianglePack::Width;
+				header.sourceSize = sourceSize;
+				header.sourceHash = sourceHash;
+				return header;
+			}
+
+			template<typename T>
+			bool ReadSection(const char* pData, size_t size, const MeshCacheHeader::Section& section, std::vector<T>& values)
+			{
+				if (section.offset % MeshCacheAlignment != 0 || section.offset > size || section.count > (size - section.offset) / sizeof(T))
+					return false;
+
+				values.resize(section.count);
+				std::memcpy(values.data(), pData + section.offset, section.count * sizeof(T));
+				return true;
+			}
+
+			//Fills the mesh like PrepareForInstancing would, false when the cache is stale or doesn't add up
+			bool ReadMeshCache(const std::string& cacheFilename, uint64_t sourceSize, uint64_t sourceHash, TriangleMesh& mesh)
+			{
+				const MappedFile file{ cacheFilename };
+				if (!file.IsOpen() || file.GetSize() < sizeof(MeshCacheHeader))
+					return false;
+
+				MeshCacheHeader header{};
+				std::memcpy(&header, file.GetData(), sizeof(MeshCacheHeader));
+
+				const MeshCacheHeader expected{ CreateMeshCacheHeader(sourceSize, sourceHash) };
+				if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version
+					|| header.nodeSize != expected.nodeSize || header.packSize != expected.packSize || header.packWidth != expected.packWidth
+					|| header.sourceSize != expected.sourceSize || header.sourceHash != expected.sourceHash)
+					return false;
+
+				const auto getSection = [&](MeshCacheSection section) -> const MeshCacheHeader::Section& {
+					return header.sections[size_t(section)];
+					};
+
+				std::vector<BVHNode> nodes{};
+				std::vector<uint32_t> primitiveIndices{};
+				const char* pData{ file.GetData() };
+				const size_t size{ file.GetSize() };
+				if (!ReadSection(pData, size, getSection(MeshCacheSection::Positions), mesh.positions)
+					|| !ReadSection(pData, size, getSection(MeshCacheSection::Normals), mesh.normals)
+					|| !ReadSection(pData, size, getSection(MeshCacheSection::Indices), mesh.indices)
+					|| !ReadSection(pData, size, getSection(MeshCacheSection::Nodes), nodes)
+					|| !ReadSection(pData, size, getSection(MeshCacheSection::PrimitiveIndices), primitiveIndices)
+					|| !ReadSection(pData, size, getSection(MeshCacheSection::TrianglePacks), mesh.trianglePacks)
+					|| !ReadSection(pData, size, getSection(MeshCacheSection::LeafPackOffsets), mesh.leafPackOffsets))
+					return false;
+
+				// the hash only covers the OBJ, a damaged cache must not send traversal out of bounds
+				const size_t triangleCount{ mesh.indices.size() / 3 };
+				if (mesh.indices.size() % 3 != 0 || mesh.normals.size() != triangleCount || primitiveIndices.size() != triangleCount
+					|| mesh.leafPackOffsets.size() != nodes.size())
+					return false;
+
+				const auto isOutOfRange = [](size_t index, size_t count) { return index >= count; };
+				for (int index : mesh.indices)
+				{
+					if (index < 0 || isOutOfRange(size_t(index), mesh.positions.size()))
+						return false;
+				}
+				for (uint32_t index : primitiveIndices)
+				{
+					if (isOutOfRange(index, triangleCount))
+						return false;
+				}
+				for (size_t nodeIndex{}; nodeIndex < nodes.size(); ++nodeIndex)
+				{
+					const BVHNode& node{ nodes[nodeIndex] };
+					const bool isValid{ node.IsLeaf()
+						? size_t(node.leftFirst) + node.primitiveCount <= triangleCount
+							&& size_t(mesh.leafPackOffsets[nodeIndex]) + (node.primitiveCount + TrianglePack::Width - 1) / TrianglePack::Width <= mesh.trianglePacks.size()
+						: node.leftFirst > nodeIndex && size_t(node.leftFirst) + 1 < nodes.size() };
+					if (!isValid)
+						return false;
+				}
+				for (const TrianglePack& pack : mesh.trianglePacks)
+				{
+					for (uint32_t triangleIndex : pack.triangleIndex)
+					{
+						if (isOutOfRange(triangleIndex, triangleCount))
+							return false;
+					}
+				}
+
+				mesh.bvh.Assign(std::move(nodes), std::move(primitiveIndices));
+				mesh.minAABB = header.minAABB;
+				mesh.maxAABB = header.maxAABB;
+				mesh.transformedMinAABB = header.minAABB;
+				mesh.transformedMaxAABB = header.maxAABB;
+				mesh.transformedPositions = {};
+				mesh.transformedNormals = {};
+				return true;
+			}
+
+			template<typename T>
+			void AddSection(MeshCacheHeader& header, MeshCacheSection section, const std::vector<T>& values, uint64_t& offset)
+			{
+				offset = (offset + MeshCacheAlignment - 1) / MeshCacheAlignment * MeshCacheAlignment;
+				header.sections[size_t(section)] = { offset, values.size() };
+				offset += values.size() * sizeof(T);
+			}
+
+			template<typename T>
+			void WriteSection(std::ofstream& file, const MeshCacheHeader& header, MeshCacheSection section, const std::vector<T>& values)
+			{
+				// zero padding up to the aligned offset
+				constexpr char Padding[MeshCacheAlignment]{};
+				const uint64_t position{ static_cast<uint64_t>(file.tellp()) };
+				file.write(Padding, std::streamsize(header.sections[size_t(section)].offset - position));
+				file.write(reinterpret_cast<const char*>(values.data()), std::streamsize(values.size() * sizeof(T)));
+			}
+
+			//Written to a temporary file first and renamed, so a reader never maps a half written cache
+			bool WriteMeshCache(const std::string& cacheFilename, uint64_t sourceSize, uint64_t sourceHash, const TriangleMesh& mesh)
+			{
+				MeshCacheHeader header{ CreateMeshCacheHeader(sourceSize, sourceHash) };
+				header.minAABB = mesh.minAABB;
+				header.maxAABB = mesh.maxAABB;
+
+				uint64_t offset{ sizeof(MeshCacheHeader) };
+				AddSection(header, MeshCacheSection::Positions, mesh.positions, offset);
+				AddSection(header, MeshCacheSection::Normals, mesh.normals, offset);
+				AddSection(header, MeshCacheSection::Indices, mesh.indices, offset);
+				AddSection(header, MeshCacheSection::Nodes, mesh.bvh.GetNodes(), offset);
+				AddSection(header, MeshCacheSection::PrimitiveIndices, mesh.bvh.GetPrimitiveIndices(), offset);
+				AddSection(header, MeshCacheSection::TrianglePacks, mesh.trianglePacks, offset);
+				AddSection(header, MeshCacheSection::LeafPackOffsets, mesh.leafPackOffsets, offset);
+
+				const std::string temporaryFilename{ cacheFilename + ".tmp" };
+				{
+					std::ofstream file{ temporaryFilename, std::ios::binary | std::ios::trunc };
+					if (!file)
+						return false;
+
+					file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+					WriteSection(file, header, MeshCacheSection::Positions, mesh.positions);
+					WriteSection(file, header, MeshCacheSection::Normals, mesh.normals);
+					WriteSection(file, header, MeshCacheSection::Indices, mesh.indices);
+					WriteSection(file, header, MeshCacheSection::Nodes, mesh.bvh.GetNodes());
+					WriteSection(file, header, MeshCacheSection::PrimitiveIndices, mesh.bvh.GetPrimitiveIndices());
+					WriteSection(file, header, MeshCacheSection::TrianglePacks, mesh.trianglePacks);
+					WriteSection(file, header, MeshCacheSection::LeafPackOffsets, mesh.leafPackOffsets);
+
+					if (!file)
+						return false;
+				}
+
+				std::error_code error{};
+				std::filesystem::rename(temporaryFilename, cacheFilename, error);
+				if (error)
+					std::filesystem::remove(temporaryFilename, error);
+				return !error;
+			}
+		}
+
+		bool LoadOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices,
+			LoadStatistics* pStatistics)
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+
+			const MappedFile file{ filename };
+			if (!file.IsOpen())
+				return false;
+
+			const size_t triangleCount{ indices.size() / 3 };
+			const size_t vertexCount{ positions.size() };
+			if (!ParseOBJ(file.GetData(), file.GetSize(), positions, normals, indices))
+				return false;
+
+			if (pStatistics)
+			{
+				pStatistics->byteCount = file.GetSize();
+				pStatistics->vertexCount = positions.size() - vertexCount;
+				pStatistics->triangleCount = indices.size() / 3 - triangleCount;
+				pStatistics->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				pStatistics->isFromCache = false;
+			}
+
+			return true;
+		}
+
+		std::string GetMeshCacheFilename(const std::string& filename)
+		{
+			return filename + ".meshcache";
+		}
+
+		bool LoadInstancedOBJ(const std::string& filename, TriangleMesh& mesh, LoadStatistics* pStatistics)
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+
+			const MappedFile file{ filename };
+			if (!file.IsOpen())
+				return false;
+
+			const uint64_t sourceHash{ HashBytes(file.GetData(), file.GetSize()) };
+			const std::string cacheFilename{ GetMeshCacheFilename(filename) };
+
+			const bool isFromCache{ ReadMeshCache(cacheFilename, file.GetSize(), sourceHash, mesh) };
+			if (!isFromCache)
+			{
+				mesh.positions.clear();
+				mesh.normals.clear();
+				mesh.indices.clear();
+				if (!ParseOBJ(file.GetData(), file.GetSize(), mesh.positions, mesh.normals, mesh.indices))
+					return false;
+
+				mesh.PrepareForInstancing();
+
+				// a read only folder only costs the next start its cache
+				WriteMeshCache(cacheFilename, file.GetSize(), sourceHash, mesh);
+			}
+
+			if (pStatistics)
+			{
+				pStatistics->byteCount = file.GetSize();
+				pStatistics->vertexCount = mesh.positions.size();
+				pStatistics->triangleCount = mesh.indices.size() / 3;
+				pStatistics->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				pStatistics->isFromCache = isFromCache;
+			}
+
+			return true;
+		}
+	}
+}
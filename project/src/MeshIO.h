@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Maths.h"
+
+namespace dae
+{
+	namespace MeshIO
+	{
+		struct LoadStatistics
+		{
+			size_t byteCount{};
+			size_t vertexCount{};
+			size_t triangleCount{};
+			double seconds{};
+			bool isFromCache{};
+
+			double GetMegabytesPerSecond() const
+			{
+				return seconds > 0.0 ? double(byteCount) / (1024.0 * 1024.0) / seconds : 0.0;
+			}
+		};
+
+		//Memory maps the file and parses it in parallel chunks
+		//Faces may use the v, v/vt, v//vn and v/vt/vn forms and negative (relative) indices, polygons are triangulated as fans
+		//Only positions are kept, normals gets one normal per triangle, like TriangleMesh::CalculateNormals
+		//Returns false when the file can't be opened, a line can't be parsed or a face points past the vertices
+		bool LoadOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices,
+			LoadStatistics* pStatistics = nullptr);
+
+		//Bumped whenever the layout of the mesh cache or of a structure stored in it changes
+		constexpr uint32_t MeshCacheVersion{ 1 };
+
+		//LoadOBJ followed by TriangleMesh::PrepareForInstancing, with the result cached in <filename>.meshcache next to the OBJ
+		//The cache holds the positions, normals, indices, BVH and triangle packs as aligned arrays in their in-memory layout,
+		//it is used while the size and hash of the OBJ match and rewritten when they don't or the cache is damaged
+		bool LoadInstancedOBJ(const std::string& filename, TriangleMesh& mesh, LoadStatistics* pStatistics = nullptr);
+		std::string GetMeshCacheFilename(const std::string& filename);
+	}
+}
@@ -9,73 +9,569 @@
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
+#include "ImageIO.h"
 
-#include "execution"
+#include <algorithm>
+#include <array>
 #define PARALLEL_EXECUTION
 
 using namespace dae;
 
+namespace
+{
+	PixelPacking GetPixelPacking(const SDL_PixelFormat* pFormat)
+	{
+		return { pFormat->Rshift, pFormat->Gshift, pFormat->Bshift, pFormat->Amask };
+	}
+}
+
+namespace dae
+{
+	//Light samples of the pixels traced since the last flush
+	//Not thread safe, the renderer keeps one per tile like the ShadowCache
+	struct ShadingQueue
+	{
+		struct LightSample
+		{
+			uint32_t pixel{}; //index in pixels
+			ColorRGB radiance{};
+			float observedArea{};
+			ShadingSlot slot{};
+		};
+
+		ShadingBatch batch{};
+		std::vector<LightSample> lightSamples{};
+		std::vector<uint32_t> pixels{}; //framebuffer indices
+		std::vector<ColorRGB> colors{};
+
+		//Returns the index of the pixel in pixels
+		uint32_t AddPixel(uint32_t pixelIndex)
+		{
+			pixels.push_back(pixelIndex);
+			return static_cast<uint32_t>(pixels.size() - 1);
+		}
+
+		void Clear()
+		{
+			batch.Clear();
+			lightSamples.clear();
+			pixels.clear();
+		}
+	};
+
+	//Ray buffers of the wavefront mode, every stage reads the buffers the previous one wrote
+	struct WavefrontBuffers
+	{
+		static constexpr uint32_t NoPixel{ UINT32_MAX };
+		//Rays, or hits, per job of every stage
+		static constexpr uint32_t ChunkSize{ 1024 };
+
+		struct CameraRay
+		{
+			Vector3 direction{};
+			uint32_t pixel{ NoPixel }; //NoPixel for the lanes of a screen block that fall outside the image
+		};
+
+		struct Hit
+		{
+			HitRecord record{};
+			Vector3 rayDirection{};
+			uint32_t pixel{};
+		};
+
+		struct ShadowRay
+		{
+			Ray ray{};
+			uint32_t lightIndex{};
+		};
+
+		std::vector<uint32_t> tileOffsets{}; //first camera ray of every tile
+		std::vector<CameraRay> cameraRays{}; //RayPacket::Width per screen block, in tile order
+		std::vector<HitRecord> hitRecords{}; //one per camera ray
+		std::vector<Hit> hits{}; //compacted, only the camera rays that hit something
+		std::vector<ShadowRay> shadowRays{}; //one per hit and light
+		std::vector<uint16_t> shadowKeys{}; //direction octant and coarse Morton code of the origin, one per shadow ray
+		std::vector<uint32_t> shadowOrder{}; //indices in shadowRays, sorted by key
+		std::vector<uint32_t> sortScratch{};
+		std::vector<uint8_t> occluded{}; //one per shadow ray
+	};
+}
+
 Renderer::Renderer(SDL_Window * pWindow) :
 	m_pWindow(pWindow),
 	m_pBuffer(SDL_GetWindowSurface(pWindow))
 {
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_OutputWidth = m_Width;
+	m_OutputHeight = m_Height;
+	m_ImageHeight = m_Height;
+	m_pOutputPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_pBufferPixels = m_pOutputPixels;
+	m_PixelPacking = GetPixelPacking(m_pBuffer->format);
+
+	m_pThreadPool = std::make_unique<ThreadPool>();
+	BuildTiles();
+}
+
+Renderer::Renderer(int width, int height) :
+	m_HeadlessPixels(size_t(width) * size_t(height)),
+	m_Width(width),
+	m_Height(height),
+	m_OutputWidth(width),
+	m_OutputHeight(height),
+	m_ImageHeight(height)
+{
+	// A plain software surface needs no video subsystem, SDL_SaveBMP keeps working on it
+	m_pBuffer = SDL_CreateRGBSurfaceWithFormatFrom(m_HeadlessPixels.data(), width, height, 32,
+		width * int(sizeof(uint32_t)), SDL_PIXELFORMAT_ARGB8888);
+	m_pOutputPixels = m_HeadlessPixels.data();
+	m_pBufferPixels = m_pOutputPixels;
+	m_PixelPacking = GetPixelPacking(m_pBuffer->format);
+
+	m_pThreadPool = std::make_unique<ThreadPool>();
+	BuildTiles();
+}
+
+Renderer::~Renderer()
+{
+	// the window surface belongs to the window
+	if (!m_pWindow) {
+		SDL_FreeSurface(m_pBuffer);
+	}
 }
 
 void Renderer::Render(Scene* pScene) const
 {
+	// has to be asked before the update clears it
+	const bool hasSceneChanged{ pScene->IsDirty() };
+	pScene->UpdateAccelerationStructure();
+
 	Camera& camera  = pScene->GetCamera();
 	const Matrix& cameraToWorld = camera.CalculateCameraToWorld();
 
+	if (!UpdateAccumulation(hasSceneChanged, cameraToWorld, camera.fovAngle)) {
+		// the finished frame only needs tonemapping again
+		if (m_IsTonemapDirty) {
+			PresentFrame();
+		}
+		return;
+	}
+
 	// Convert angle to radians
 	const float radFOV{ camera.fovAngle * PI / 180.f };
 
 	// calculate FOV with radians NOT ANGLE
 	const float FOV{ tan(radFOV / 2) };
 
-	const float aspectRatio{ float(m_Width) / float(m_Height) };
+	const float aspectRatio{ float(m_Width) / float(m_ImageHeight) };
+
+	m_HDRPixels.resize(size_t(m_Width) * size_t(m_Height));
+	if (m_AntiAliasingMode != AntiAliasingMode::Off) {
+		m_BaseColors.resize(size_t(m_Width) * size_t(m_Height));
+	}
 
+	const auto runTiles = [&](const std::function<void(uint32_t)>& job) {
 #if defined(PARALLEL_EXECUTION)
-	//	Parallel logic
-	uint32_t amountOfPixels{ uint32_t(m_Width * m_Height) };
-	std::vector<uint32_t> pixelIndices{};
+		//	Parallel logic, the pool is kept alive between frames
+		m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_Tiles.size()), job);
+#else
+		// Synchronous logic (no threading)
+		for (uint32_t tileIndex{}; tileIndex < m_Tiles.size(); ++tileIndex)
+		{
+			job(tileIndex);
+		}
+#endif
+		};
 
-	pixelIndices.reserve(amountOfPixels);
-	for (uint32_t idx{}; idx < amountOfPixels; idx++) pixelIndices.emplace_back(idx);
+	if (m_WavefrontEnabled) {
+		RenderWavefront(pScene, FOV, aspectRatio, cameraToWorld, camera.origin);
+	}
+	else {
+		runTiles([&](uint32_t tileIndex) {
+			RenderTile(pScene, m_Tiles[tileIndex], FOV, aspectRatio, cameraToWorld, camera.origin);
+			});
+	}
 
-	std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](int i) {
-		RenderPixel(pScene, i, FOV, aspectRatio, cameraToWorld, camera.origin);
-		});
-#else
-	// Synchronous logic (no threading)
-	uint32_t amountOfPixels{ uint32_t(m_Width * m_Height) };
+	// needs the whole first pass, the contrast of a pixel on a tile edge looks at the neighbouring tiles
+	if (m_AntiAliasingMode != AntiAliasingMode::Off) {
+		runTiles([&](uint32_t tileIndex) {
+			AntiAliasTile(pScene, m_Tiles[tileIndex], FOV, aspectRatio, cameraToWorld, camera.origin);
+			});
+	}
+
+	PresentFrame();
+}
+
+void Renderer::PresentFrame() const
+{
+	// in blocks of pixels instead of rows, a band or a scaled down frame can be only a few rows high
+	constexpr size_t PixelsPerJob{ 16384 };
+	const size_t pixelCount{ m_HDRPixels.size() };
+	const auto tonemapPixels = [&](uint32_t jobIndex) {
+		const size_t first{ size_t(jobIndex) * PixelsPerJob };
+		ColorUtils::TonemapPixels(m_HDRPixels.data() + first, m_pBufferPixels + first, std::min(PixelsPerJob, pixelCount - first),
+			m_Tonemapper, m_SRGBEnabled, m_PixelPacking);
+		};
 
-	for (uint16_t pixelIndex{}; pixelIndex < amountOfPixels; ++pixelIndex)
+	const uint32_t jobCount{ static_cast<uint32_t>((pixelCount + PixelsPerJob - 1) / PixelsPerJob) };
+#if defined(PARALLEL_EXECUTION)
+	m_pThreadPool->ParallelFor(jobCount, tonemapPixels);
+#else
+	for (uint32_t jobIndex{}; jobIndex < jobCount; ++jobIndex)
 	{
-		RenderPixel(pScene, pixelIndex, FOV, aspectRatio, cameraToWorld, camera.origin);
+		tonemapPixels(jobIndex);
 	}
 #endif
+	m_IsTonemapDirty = false;
 
+	if (m_pBufferPixels != m_pOutputPixels) {
+		Upscale();
+	}
 
 	//@END
 	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	if (m_pWindow) {
+		SDL_UpdateWindowSurface(m_pWindow);
+	}
 }
 
-void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+void Renderer::RenderWavefront(Scene* pScene, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+{
+	if (!m_pWavefront) {
+		m_pWavefront = std::make_unique<WavefrontBuffers>();
+	}
+	WavefrontBuffers& buffers{ *m_pWavefront };
+
+	const auto& lights{ pScene->GetLights() };
+	const uint32_t lightCount{ static_cast<uint32_t>(lights.size()) };
+
+	const auto runStage = [&](size_t itemCount, const std::function<void(uint32_t)>& job) {
+		const uint32_t jobCount{ static_cast<uint32_t>((itemCount + WavefrontBuffers::ChunkSize - 1) / WavefrontBuffers::ChunkSize) };
+#if defined(PARALLEL_EXECUTION)
+		m_pThreadPool->ParallelFor(jobCount, job);
+#else
+		for (uint32_t jobIndex{}; jobIndex < jobCount; ++jobIndex)
+		{
+			job(jobIndex);
+		}
+#endif
+		};
+	const auto getChunk = [](uint32_t jobIndex, size_t itemCount) {
+		const size_t first{ size_t(jobIndex) * WavefrontBuffers::ChunkSize };
+		return std::pair<size_t, size_t>{ first, std::min(first + WavefrontBuffers::ChunkSize, itemCount) };
+		};
+
+	// 1. Camera rays, RayPacket::Width per screen block in tile order, so the intersection stage can trace them as packets
+	buffers.tileOffsets.resize(m_Tiles.size());
+	size_t cameraRayCount{};
+	for (size_t tileIndex{}; tileIndex < m_Tiles.size(); ++tileIndex)
+	{
+		const Tile& tile{ m_Tiles[tileIndex] };
+		buffers.tileOffsets[tileIndex] = static_cast<uint32_t>(cameraRayCount);
+		cameraRayCount += size_t((tile.width + RayPacket::Size - 1) / RayPacket::Size) * ((tile.height + RayPacket::Size - 1) / RayPacket::Size) * RayPacket::Width;
+	}
+	buffers.cameraRays.resize(cameraRayCount);
+
+	const auto generateCameraRays = [&](uint32_t tileIndex) {
+		const Tile& tile{ m_Tiles[tileIndex] };
+		WavefrontBuffers::CameraRay* pRay{ &buffers.cameraRays[buffers.tileOffsets[tileIndex]] };
+
+		for (uint32_t blockY{ tile.y }; blockY < tile.y + tile.height; blockY += RayPacket::Size)
+		{
+			for (uint32_t blockX{ tile.x }; blockX < tile.x + tile.width; blockX += RayPacket::Size)
+			{
+				for (uint32_t lane{}; lane < RayPacket::Width; ++lane, ++pRay)
+				{
+					const uint32_t px{ blockX + lane % RayPacket::Size };
+					const uint32_t py{ blockY + lane / RayPacket::Size };
+					const bool isInside{ px < uint32_t(m_Width) && py < uint32_t(m_Height) };
+
+					// lanes outside the image repeat the last pixel, like RenderPacket
+					pRay->direction = GetViewDirection(std::min(px, uint32_t(m_Width) - 1), std::min(py, uint32_t(m_Height) - 1), fov, aspectRatio, cameraToWorld);
+					pRay->pixel = isInside ? px + (py * m_Width) : WavefrontBuffers::NoPixel;
+				}
+			}
+		}
+		};
+#if defined(PARALLEL_EXECUTION)
+	m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_Tiles.size()), generateCameraRays);
+#else
+	for (uint32_t tileIndex{}; tileIndex < m_Tiles.size(); ++tileIndex)
+	{
+		generateCameraRays(tileIndex);
+	}
+#endif
+
+	// 2. Intersection
+	buffers.hitRecords.assign(cameraRayCount, HitRecord{});
+	runStage(cameraRayCount, [&](uint32_t jobIndex) {
+		const auto [first, last] { getChunk(jobIndex, cameraRayCount) };
+		for (size_t blockStart{ first }; blockStart < last; blockStart += RayPacket::Width)
+		{
+			const WavefrontBuffers::CameraRay* pRays{ &buffers.cameraRays[blockStart] };
+			HitRecord* pRecords{ &buffers.hitRecords[blockStart] };
+
+			if (m_PacketTracingEnabled)
+			{
+				RayPacket packet{};
+				packet.origin = cameraOrigin;
+				for (uint32_t lane{}; lane < RayPacket::Width; ++lane)
+				{
+					packet.SetDirection(lane, pRays[lane].direction);
+				}
+				packet.Finalize();
+
+				RayPacketHit hit{};
+				pScene->GetClosestHits(packet, hit);
+				std::copy(std::begin(hit.records), std::end(hit.records), pRecords);
+			}
+			else
+			{
+				for (uint32_t lane{}; lane < RayPacket::Width; ++lane)
+				{
+					if (pRays[lane].pixel != WavefrontBuffers::NoPixel) {
+						pScene->GetClosestHit(Ray{ cameraOrigin, pRays[lane].direction }, pRecords[lane]);
+					}
+				}
+			}
+		}
+		});
+
+	// 3. Compaction, only hits need shadow rays and shading, misses are written black right away
+	buffers.hits.clear();
+	Vector3 minOrigin{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 maxOrigin{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	uint64_t primaryRayCount{};
+
+	for (size_t rayIndex{}; rayIndex < cameraRayCount; ++rayIndex)
+	{
+		const WavefrontBuffers::CameraRay& cameraRay{ buffers.cameraRays[rayIndex] };
+		if (cameraRay.pixel == WavefrontBuffers::NoPixel)
+			continue;
+
+		++primaryRayCount;
+		const HitRecord& record{ buffers.hitRecords[rayIndex] };
+		if (!record.didHit) {
+			StorePixel(cameraRay.pixel, ColorRGB{});
+			continue;
+		}
+
+		buffers.hits.push_back({ record, cameraRay.direction, cameraRay.pixel });
+		minOrigin = Vector3::Min(minOrigin, record.origin);
+		maxOrigin = Vector3::Max(maxOrigin, record.origin);
+	}
+	// packets trace their outside lanes too
+	m_RayCount += m_PacketTracingEnabled ? cameraRayCount : primaryRayCount;
+
+	// 4. Shadow rays, keyed by direction octant and then by origin along a Morton curve
+	const size_t hitCount{ buffers.hits.size() };
+	const size_t shadowRayCount{ hitCount * lightCount };
+	buffers.shadowRays.resize(shadowRayCount);
+	buffers.shadowKeys.resize(shadowRayCount);
+
+	const Vector3 extent{ maxOrigin - minOrigin };
+	constexpr float MaxCell{ float((1 << 20) - 1) };
+	const Vector3 originScale{ MaxCell / std::max(extent.x, 1e-6f), MaxCell / std::max(extent.y, 1e-6f), MaxCell / std::max(extent.z, 1e-6f) };
+
+	runStage(hitCount, [&](uint32_t jobIndex) {
+		const auto [first, last] { getChunk(jobIndex, hitCount) };
+		for (size_t hitIndex{ first }; hitIndex < last; ++hitIndex)
+		{
+			const HitRecord& record{ buffers.hits[hitIndex].record };
+			const Vector3 cell{ (record.origin.x - minOrigin.x) * originScale.x, (record.origin.y - minOrigin.y) * originScale.y,
+				(record.origin.z - minOrigin.z) * originScale.z };
+			const uint64_t morton{ MortonEncode3D(uint32_t(std::min(cell.x, MaxCell)), uint32_t(std::min(cell.y, MaxCell)), uint32_t(std::min(cell.z, MaxCell))) };
+			// the top 13 of the 60 Morton bits, rays in one bucket start in the same cell of a 16x16x32 grid
+			const uint16_t originKey{ static_cast<uint16_t>(morton >> 47) };
+
+			for (uint32_t lightIndex{}; lightIndex < lightCount; ++lightIndex)
+			{
+				const uint32_t rayIndex{ static_cast<uint32_t>(hitIndex * lightCount + lightIndex) };
+				const Ray ray{ CreateShadowRay(lights[lightIndex], record) };
+				const uint16_t octant{ static_cast<uint16_t>((ray.direction.x < 0.f) | ((ray.direction.y < 0.f) << 1) | ((ray.direction.z < 0.f) << 2)) };
+
+				buffers.shadowRays[rayIndex] = { ray, lightIndex };
+				buffers.shadowKeys[rayIndex] = static_cast<uint16_t>((octant << 13) | originKey);
+			}
+		}
+		});
+
+	// LSD radix sort of the 16 bit keys in two 8 bit passes, linear in the ray count and stable, so equal keys keep their hit order
+	buffers.shadowOrder.resize(shadowRayCount);
+	buffers.sortScratch.resize(shadowRayCount);
+	for (uint32_t pass{}; pass < 2; ++pass)
+	{
+		const uint32_t shift{ pass * 8 };
+		std::vector<uint32_t>& destination{ pass == 0 ? buffers.sortScratch : buffers.shadowOrder };
+
+		std::array<uint32_t, 256> offsets{};
+		for (uint16_t key : buffers.shadowKeys)
+		{
+			++offsets[(key >> shift) & 0xFF];
+		}
+
+		uint32_t offset{};
+		for (uint32_t& bucket : offsets)
+		{
+			const uint32_t count{ bucket };
+			bucket = offset;
+			offset += count;
+		}
+
+		for (size_t orderIndex{}; orderIndex < shadowRayCount; ++orderIndex)
+		{
+			const uint32_t rayIndex{ pass == 0 ? static_cast<uint32_t>(orderIndex) : buffers.sortScratch[orderIndex] };
+			destination[offsets[(buffers.shadowKeys[rayIndex] >> shift) & 0xFF]++] = rayIndex;
+		}
+	}
+
+	// 5. Occlusion, in sorted order
+	if (m_ShadowsEnabled)
+	{
+		buffers.occluded.assign(shadowRayCount, 0);
+		runStage(shadowRayCount, [&](uint32_t jobIndex) {
+			const auto [first, last] { getChunk(jobIndex, shadowRayCount) };
+
+			// one job runs on one thread, like a tile
+			ShadowCache shadowCache{};
+			for (size_t orderIndex{ first }; orderIndex < last; ++orderIndex)
+			{
+				const uint32_t rayIndex{ buffers.shadowOrder[orderIndex] };
+				const WavefrontBuffers::ShadowRay& shadowRay{ buffers.shadowRays[rayIndex] };
+
+				const bool isOccluded{ m_ShadowCacheEnabled ? pScene->DoesHit(shadowRay.ray, shadowCache, shadowRay.lightIndex) : pScene->DoesHit(shadowRay.ray) };
+				buffers.occluded[rayIndex] = isOccluded;
+			}
+
+			m_ShadowQueryCount += shadowCache.queryCount;
+			m_ShadowCacheHitCount += shadowCache.hitCount;
+			});
+		m_RayCount += shadowRayCount;
+	}
+
+	// 6. Shading, batched by material type per chunk of hits
+	runStage(hitCount, [&](uint32_t jobIndex) {
+		const auto [first, last] { getChunk(jobIndex, hitCount) };
+
+		ShadingQueue shadingQueue{};
+		for (size_t hitIndex{ first }; hitIndex < last; ++hitIndex)
+		{
+			const WavefrontBuffers::Hit& hit{ buffers.hits[hitIndex] };
+			const uint32_t pixel{ shadingQueue.AddPixel(hit.pixel) };
+
+			for (uint32_t lightIndex{}; lightIndex < lightCount; ++lightIndex)
+			{
+				const size_t rayIndex{ hitIndex * lightCount + lightIndex };
+				if (m_ShadowsEnabled && buffers.occluded[rayIndex]) {
+					continue;
+				}
+
+				QueueLightSample(pScene, pixel, lights[lightIndex], hit.record, buffers.shadowRays[rayIndex].ray.direction, hit.rayDirection, shadingQueue);
+			}
+		}
+
+		FlushShading(pScene, shadingQueue);
+		});
+}
+
+uint32_t Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin,
+	ShadowCache& shadowCache, ShadingQueue& shadingQueue) const
 {
-	auto& materials{ pScene->GetMaterials() };
-	auto& lights{ pScene->GetLights() };
-	
 	const uint32_t px{ pixelIndex % m_Width };
 	const uint32_t py{ pixelIndex / m_Width };
 	
-	float rx{ px + 0.5f }, ry{ py + 0.5f };
+	const Vector3 rayDirection{ GetViewDirection(px, py, fov, aspectRatio, cameraToWorld) };
+	
+	// Ray we are casting from the camera towards each pixel
+	Ray viewRay{ cameraOrigin, rayDirection };
+	
+	//hitrecord containing more information about a potential hit
+	HitRecord closestHit{};
+	pScene->GetClosestHit(viewRay, closestHit);
 	
+	return 1 + QueuePixel(pScene, px, py, rayDirection, closestHit, shadowCache, shadingQueue);
+}
+
+void Renderer::RenderTile(Scene* pScene, const Tile& tile, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+{
+	// counted per tile, one atomic add per tile keeps the threads from fighting over the counter
+	uint64_t rayCount{};
+
+	// the whole tile runs on one thread, so its shadow cache and shading queue need no synchronization
+	ShadowCache shadowCache{};
+	ShadingQueue shadingQueue{};
+
+	if (m_PacketTracingEnabled)
+	{
+		for (uint32_t blockY{ tile.y }; blockY < tile.y + tile.height; blockY += RayPacket::Size)
+		{
+			for (uint32_t blockX{ tile.x }; blockX < tile.x + tile.width; blockX += RayPacket::Size)
+			{
+				rayCount += RenderPacket(pScene, blockX, blockY, fov, aspectRatio, cameraToWorld, cameraOrigin, shadowCache, shadingQueue);
+			}
+		}
+	}
+	else
+	{
+		for (uint32_t py{ tile.y }; py < tile.y + tile.height; ++py)
+		{
+			for (uint32_t px{ tile.x }; px < tile.x + tile.width; ++px)
+			{
+				rayCount += RenderPixel(pScene, px + (py * m_Width), fov, aspectRatio, cameraToWorld, cameraOrigin, shadowCache, shadingQueue);
+			}
+
+			// a row of the tile is shaded as one batch
+			FlushShading(pScene, shadingQueue);
+		}
+	}
+
+	m_RayCount += rayCount;
+	m_ShadowQueryCount += shadowCache.queryCount;
+	m_ShadowCacheHitCount += shadowCache.hitCount;
+}
+
+uint32_t Renderer::RenderPacket(Scene* pScene, uint32_t blockX, uint32_t blockY, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin,
+	ShadowCache& shadowCache, ShadingQueue& shadingQueue) const
+{
+	// blocks on the right and bottom edge repeat the last pixel, those lanes are traced but never written
+	RayPacket packet{};
+	packet.origin = cameraOrigin;
+	for (uint32_t lane{}; lane < RayPacket::Width; ++lane)
+	{
+		const uint32_t px{ std::min(blockX + lane % RayPacket::Size, uint32_t(m_Width) - 1) };
+		const uint32_t py{ std::min(blockY + lane / RayPacket::Size, uint32_t(m_Height) - 1) };
+		packet.SetDirection(lane, GetViewDirection(px, py, fov, aspectRatio, cameraToWorld));
+	}
+	packet.Finalize();
+
+	RayPacketHit hit{};
+	pScene->GetClosestHits(packet, hit);
+
+	uint32_t rayCount{ RayPacket::Width };
+	for (uint32_t lane{}; lane < RayPacket::Width; ++lane)
+	{
+		const uint32_t px{ blockX + lane % RayPacket::Size };
+		const uint32_t py{ blockY + lane / RayPacket::Size };
+		if (px >= uint32_t(m_Width) || py >= uint32_t(m_Height))
+			continue;
+
+		rayCount += QueuePixel(pScene, px, py, packet.GetDirection(lane), hit.records[lane], shadowCache, shadingQueue);
+	}
+
+	FlushShading(pScene, shadingQueue);
+	return rayCount;
+}
+
+Vector3 Renderer::GetViewDirection(uint32_t px, uint32_t py, float fov, float aspectRatio, const Matrix& cameraToWorld) const
+{
+	return GetViewDirection(px + m_Accumulation.jitterX, (py + m_ImageOffsetY) + m_Accumulation.jitterY, fov, aspectRatio, cameraToWorld);
+}
+
+Vector3 Renderer::GetViewDirection(float rx, float ry, float fov, float aspectRatio, const Matrix& cameraToWorld) const
+{
 	float cx{ (2.f * (rx / float(m_Width)) - 1.f) * aspectRatio * fov };
-	float cy{ (1 - (2.f * (ry / float(m_Height)))) * fov};
+	float cy{ (1 - (2.f * (ry / float(m_ImageHeight)))) * fov};
 	
 	Vector3 rayDirection{cx, cy, 1.f};
 	
@@ -88,70 +584,550 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float
 	rayDirection.Normalize();
 	
 	// Transform raydirection with up, forward and right vector
-	rayDirection = cameraToWorld.TransformVector(rayDirection);
-	
-	// Ray we are casting from the camera towards each pixel
-	Ray viewRay{ cameraOrigin, rayDirection };
-	
-	//color to write to the color buffer (Default = black)
-	ColorRGB finalColor{};
-	
-	//hitrecord containing more information about a potential hit
-	HitRecord closestHit{};
-	pScene->GetClosestHit(viewRay, closestHit);
+	return cameraToWorld.TransformVector(rayDirection);
+}
+
+uint32_t Renderer::QueuePixel(Scene* pScene, uint32_t px, uint32_t py, const Vector3& rayDirection, const HitRecord& closestHit,
+	ShadowCache& shadowCache, ShadingQueue& shadingQueue) const
+{
+	auto& lights{ pScene->GetLights() };
+
+	const uint32_t pixel{ shadingQueue.AddPixel(px + (py * m_Width)) };
+	uint32_t shadowRayCount{};
 	
 	if (closestHit.didHit) {
 	
-		for (auto& light : lights) {
-	
-			Vector3 lightDirection{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
-			Ray lightRay{};
+		for (uint32_t lightIndex{}; lightIndex < lights.size(); ++lightIndex) {
 	
-			lightRay.origin = closestHit.origin + (closestHit.normal * 0.0001f);
-			lightRay.direction = lightDirection.Normalized();
-			lightRay.min = 0.00001f;
-			lightRay.max = lightDirection.Normalize();
+			const Light& light{ lights[lightIndex] };
+			++shadowRayCount;
+			const Ray lightRay{ CreateShadowRay(light, closestHit) };
 	
-	
-			if (pScene->DoesHit(lightRay) && m_ShadowsEnabled) {
+			const bool isOccluded{ m_ShadowCacheEnabled ? pScene->DoesHit(lightRay, shadowCache, lightIndex) : pScene->DoesHit(lightRay) };
+			if (isOccluded && m_ShadowsEnabled) {
 				continue;
 			}
 	
-			const float observedArea{ std::max(0.0f,Vector3::Dot(lightDirection.Normalized(), closestHit.normal)) };
-			const ColorRGB& radiance{ LightUtils::GetRadiance(light, closestHit.origin) };
-			const ColorRGB& shade{ materials[closestHit.materialIndex]->Shade(closestHit, lightDirection, -rayDirection) };
-	
-			switch (m_LightingMode)
+			QueueLightSample(pScene, pixel, light, closestHit, lightRay.direction, rayDirection, shadingQueue);
+		}
+	}
+
+	return shadowRayCount;
+}
+
+void Renderer::QueueLightSample(const Scene* pScene, uint32_t pixel, const Light& light, const HitRecord& closestHit, const Vector3& lightDirection,
+	const Vector3& rayDirection, ShadingQueue& shadingQueue) const
+{
+	ShadingQueue::LightSample sample{};
+	sample.pixel = pixel;
+	sample.observedArea = std::max(0.0f, Vector3::Dot(lightDirection.Normalized(), closestHit.normal));
+	sample.radiance = LightUtils::GetRadiance(light, closestHit.origin);
+
+	// the other modes never look at the BRDF
+	if (m_LightingMode == LightingMode::BRDF || m_LightingMode == LightingMode::Combined) {
+		sample.slot = shadingQueue.batch.Add(pScene->GetMaterials(), closestHit.materialIndex, closestHit.normal, lightDirection, -rayDirection);
+	}
+
+	shadingQueue.lightSamples.push_back(sample);
+}
+
+Ray Renderer::CreateShadowRay(const Light& light, const HitRecord& closestHit)
+{
+	Vector3 lightDirection{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
+	Ray lightRay{};
+
+	lightRay.origin = closestHit.origin + (closestHit.normal * 0.0001f);
+	lightRay.direction = lightDirection.Normalized();
+	lightRay.min = 0.00001f;
+	lightRay.max = lightDirection.Normalize();
+
+	return lightRay;
+}
+
+void Renderer::FlushShading(const Scene* pScene, ShadingQueue& shadingQueue) const
+{
+	ResolveShading(pScene, shadingQueue);
+
+	for (size_t i{}; i < shadingQueue.pixels.size(); ++i)
+	{
+		StorePixel(shadingQueue.pixels[i], shadingQueue.colors[i]);
+	}
+
+	shadingQueue.Clear();
+}
+
+void Renderer::ResolveShading(const Scene* pScene, ShadingQueue& shadingQueue) const
+{
+	shadingQueue.batch.Shade(pScene->GetMaterials());
+
+	//color to write to the color buffer (Default = black)
+	shadingQueue.colors.assign(shadingQueue.pixels.size(), ColorRGB{});
+
+	// samples are accumulated in the order they were queued, so every pixel sums its lights in light order
+	for (const ShadingQueue::LightSample& sample : shadingQueue.lightSamples)
+	{
+		ColorRGB& finalColor{ shadingQueue.colors[sample.pixel] };
+
+		switch (m_LightingMode)
+		{
+		case dae::Renderer::LightingMode::ObservedArea:
+			finalColor += colors::White * sample.observedArea;
+			break;
+		case dae::Renderer::LightingMode::Radiance:
+			finalColor += sample.radiance;
+			break;
+		case dae::Renderer::LightingMode::BRDF:
+			finalColor += shadingQueue.batch.GetColor(sample.slot);
+			break;
+		case dae::Renderer::LightingMode::Combined:
+			finalColor += sample.radiance * shadingQueue.batch.GetColor(sample.slot) * sample.observedArea;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void Renderer::WritePixel(uint32_t pixelIndex, ColorRGB color) const
+{
+	if (m_Accumulation.sampleCount > 0) {
+		// the first sample overwrites whatever an earlier accumulation left behind
+		ColorRGB& sum{ m_Accumulation.sums[pixelIndex] };
+		sum = m_Accumulation.sampleCount == 1 ? color : sum + color;
+		color = sum * (1.f / float(m_Accumulation.sampleCount));
+	}
+
+	m_HDRPixels[pixelIndex] = color;
+}
+
+void Renderer::StorePixel(uint32_t pixelIndex, ColorRGB color) const
+{
+	if (m_AntiAliasingMode == AntiAliasingMode::Off) {
+		WritePixel(pixelIndex, color);
+		return;
+	}
+
+	m_BaseColors[pixelIndex] = color;
+}
+
+bool Renderer::UpdateAccumulation(bool hasSceneChanged, const Matrix& cameraToWorld, float fovAngle) const
+{
+	Accumulation& accumulation{ m_Accumulation };
+	accumulation.isIdle = false;
+
+	if (!m_ProgressiveEnabled) {
+		accumulation.sampleCount = 0;
+		accumulation.jitterX = .5f;
+		accumulation.jitterY = .5f;
+		return true;
+	}
+
+	const bool hasCameraChanged{ !(cameraToWorld == accumulation.cameraToWorld) || fovAngle != accumulation.fovAngle };
+	if (hasSceneChanged || hasCameraChanged || accumulation.isDirty) {
+		accumulation.sampleCount = 0;
+		accumulation.cameraToWorld = cameraToWorld;
+		accumulation.fovAngle = fovAngle;
+		accumulation.isDirty = false;
+	}
+
+	if (accumulation.sampleCount >= MaxProgressiveSamples) {
+		accumulation.isIdle = true;
+		return false;
+	}
+
+	accumulation.sums.resize(size_t(m_Width) * size_t(m_Height));
+
+	// the first sample goes through the pixel centers, like a frame without accumulation, the next ones follow a Halton (2, 3) sequence
+	const uint32_t sampleIndex{ accumulation.sampleCount++ };
+	accumulation.jitterX = sampleIndex == 0 ? .5f : Halton(sampleIndex, 2);
+	accumulation.jitterY = sampleIndex == 0 ? .5f : Halton(sampleIndex, 3);
+
+	return true;
+}
+
+bool Renderer::SaveBufferToImage(const char* fileName) const
+{
+	return SDL_SaveBMP(m_pBuffer, fileName) == 0;
+}
+
+Image Renderer::CaptureImage(bool isLinear) const
+{
+	Image image{ uint32_t(m_Width), uint32_t(m_Height), m_HDRPixels };
+	// black before the first frame
+	image.pixels.resize(size_t(m_Width) * size_t(m_Height));
+
+	if (!isLinear)
+	{
+		for (ColorRGB& color : image.pixels)
+		{
+			color = ColorUtils::ApplyTonemapper(color, m_Tonemapper);
+			if (m_SRGBEnabled) {
+				color = { ColorUtils::EncodeSRGB(color.r), ColorUtils::EncodeSRGB(color.g), ColorUtils::EncodeSRGB(color.b) };
+			}
+		}
+	}
+
+	return image;
+}
+
+bool Renderer::RenderToPPM(Scene* pScene, const std::string& fileName, int imageHeight)
+{
+	SetTargetFrameTime(0.f);
+
+	PPMStreamWriter writer{};
+	if (!writer.Open(fileName, uint32_t(m_Width), uint32_t(imageHeight))) {
+		return false;
+	}
+
+	// every band is a new view, accumulating them would blend bands together
+	const bool isProgressiveEnabled{ m_ProgressiveEnabled };
+	m_ProgressiveEnabled = false;
+	m_ImageHeight = imageHeight;
+
+	const SDL_PixelFormat* pFormat{ m_pBuffer->format };
+	std::vector<uint8_t> rows(size_t(m_Width) * size_t(m_Height) * 3);
+
+	bool isWritten{ true };
+	for (int bandY{}; bandY < imageHeight && isWritten; bandY += m_Height)
+	{
+		// the last band is rendered whole, only its rows inside the image are written
+		m_ImageOffsetY = bandY;
+		Render(pScene);
+
+		const int rowCount{ std::min(m_Height, imageHeight - bandY) };
+		const size_t pixelCount{ size_t(m_Width) * size_t(rowCount) };
+		for (size_t i{}; i < pixelCount; ++i)
+		{
+			const uint32_t pixel{ m_pBufferPixels[i] };
+			rows[i * 3] = static_cast<uint8_t>(pixel >> pFormat->Rshift);
+			rows[i * 3 + 1] = static_cast<uint8_t>(pixel >> pFormat->Gshift);
+			rows[i * 3 + 2] = static_cast<uint8_t>(pixel >> pFormat->Bshift);
+		}
+
+		isWritten = writer.WriteRows(rows.data(), uint32_t(rowCount));
+	}
+
+	m_ImageHeight = m_Height;
+	m_ImageOffsetY = 0;
+	m_ProgressiveEnabled = isProgressiveEnabled;
+	m_Accumulation.isDirty = true;
+
+	return writer.Close() && isWritten;
+}
+
+namespace
+{
+	//Rotated grid positions of 8x MSAA in 1/16 pixel, every row and column of the pixel gets one sample
+	//The first four are spread over the whole pixel on their own
+	constexpr int StratifiedSamples[8][2]{ { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+
+	//Luminance as the Clamp tonemapper shows the color, the thresholds stay in display units however bright the scene is
+	float GetLuminance(ColorRGB color)
+	{
+		color.MaxToOne();
+		return .2126f * color.r + .7152f * color.g + .0722f * color.b;
+	}
+}
+
+float Renderer::GetLocalContrast(uint32_t px, uint32_t py) const
+{
+	float minLuminance{ FLT_MAX };
+	float maxLuminance{ 0.f };
+
+	for (uint32_t y{ py > 0 ? py - 1 : 0 }; y <= std::min(py + 1, uint32_t(m_Height) - 1); ++y)
+	{
+		for (uint32_t x{ px > 0 ? px - 1 : 0 }; x <= std::min(px + 1, uint32_t(m_Width) - 1); ++x)
+		{
+			const float luminance{ GetLuminance(m_BaseColors[x + (y * m_Width)]) };
+			minLuminance = std::min(minLuminance, luminance);
+			maxLuminance = std::max(maxLuminance, luminance);
+		}
+	}
+
+	return maxLuminance - minLuminance;
+}
+
+void Renderer::AntiAliasTile(Scene* pScene, const Tile& tile, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+{
+	constexpr uint32_t SamplesPerStep{ 4 };
+	const bool isFull{ m_AntiAliasingMode == AntiAliasingMode::Full };
+
+	uint64_t rayCount{};
+	uint64_t supersampleCount{};
+	ShadowCache shadowCache{};
+	ShadingQueue shadingQueue{};
+
+	for (uint32_t py{ tile.y }; py < tile.y + tile.height; ++py)
+	{
+		for (uint32_t px{ tile.x }; px < tile.x + tile.width; ++px)
+		{
+			const uint32_t pixelIndex{ px + (py * m_Width) };
+			ColorRGB color{ m_BaseColors[pixelIndex] };
+
+			if (isFull || GetLocalContrast(px, py) > m_ContrastThreshold)
 			{
-			case dae::Renderer::LightingMode::ObservedArea:
-				finalColor += colors::White * observedArea;
-				break;
-			case dae::Renderer::LightingMode::Radiance:
-				finalColor += radiance;
-				break;
-			case dae::Renderer::LightingMode::BRDF:
-				finalColor += shade;
-				break;
-			case dae::Renderer::LightingMode::Combined:
-				finalColor += radiance * shade * observedArea;
-				break;
-			default:
-				break;
+				ColorRGB sum{ color };
+				float luminanceSum{ GetLuminance(color) };
+				float luminanceSquareSum{ Square(luminanceSum) };
+				uint32_t sampleCount{ 1 };
+
+				for (uint32_t first{}; first < 8; first += SamplesPerStep)
+				{
+					for (uint32_t sample{ first }; sample < first + SamplesPerStep; ++sample)
+					{
+						// shifted along with the progressive jitter so every accumulated frame adds new positions
+						const float offsetX{ std::fmod(StratifiedSamples[sample][0] / 16.f + m_Accumulation.jitterX + 1.f, 1.f) };
+						const float offsetY{ std::fmod(StratifiedSamples[sample][1] / 16.f + m_Accumulation.jitterY + 1.f, 1.f) };
+						const Vector3 rayDirection{ GetViewDirection(px + offsetX, (py + m_ImageOffsetY) + offsetY, fov, aspectRatio, cameraToWorld) };
+
+						HitRecord closestHit{};
+						pScene->GetClosestHit(Ray{ cameraOrigin, rayDirection }, closestHit);
+						rayCount += 1 + QueuePixel(pScene, px, py, rayDirection, closestHit, shadowCache, shadingQueue);
+					}
+
+					ResolveShading(pScene, shadingQueue);
+					for (const ColorRGB& sampleColor : shadingQueue.colors)
+					{
+						sum += sampleColor;
+
+						const float luminance{ GetLuminance(sampleColor) };
+						luminanceSum += luminance;
+						luminanceSquareSum += Square(luminance);
+					}
+					sampleCount += SamplesPerStep;
+					shadingQueue.Clear();
+
+					// smooth gradients stop here, edges and shadow boundaries keep going
+					const float mean{ luminanceSum / float(sampleCount) };
+					const float variance{ luminanceSquareSum / float(sampleCount) - Square(mean) };
+					if (!isFull && variance <= m_VarianceThreshold) {
+						break;
+					}
+				}
+
+				supersampleCount += sampleCount - 1;
+				color = sum * (1.f / float(sampleCount));
 			}
+
+			WritePixel(pixelIndex, color);
 		}
 	}
-	
-	finalColor.MaxToOne();
-	
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+
+	m_RayCount += rayCount;
+	m_SupersampleCount += supersampleCount;
+	m_ShadowQueryCount += shadowCache.queryCount;
+	m_ShadowCacheHitCount += shadowCache.hitCount;
+}
+
+void Renderer::SetTargetFrameTime(float targetFrameTime)
+{
+	m_DynamicResolution.targetFrameTime = std::max(targetFrameTime, 0.f);
+	m_DynamicResolution.averageFrameTime = 0.f;
+
+	if (m_DynamicResolution.targetFrameTime == 0.f) {
+		SetResolutionScale(1.f);
+	}
+}
+
+void Renderer::UpdateResolutionScale(float frameTime)
+{
+	DynamicResolution& resolution{ m_DynamicResolution };
+
+	// an idle frame rendered nothing, its time says nothing about the next one
+	if (resolution.targetFrameTime == 0.f || m_Accumulation.isIdle || frameTime <= 0.f) {
+		return;
+	}
+
+	// smoothed, so a single slow frame does not throw the resolution around
+	constexpr float Smoothing{ .25f };
+	resolution.averageFrameTime = resolution.averageFrameTime == 0.f ? frameTime
+		: resolution.averageFrameTime + (frameTime - resolution.averageFrameTime) * Smoothing;
+
+	// the frame time follows the pixel count, the square of the scale
+	const float idealScale{ resolution.scale * std::sqrt(resolution.targetFrameTime / resolution.averageFrameTime) };
+	const float scale{ std::clamp(std::floor(idealScale / ResolutionScaleStep) * ResolutionScaleStep, MinResolutionScale, 1.f) };
+
+	// growing waits for some headroom, otherwise a frame time right on the target flips between two sizes
+	constexpr float GrowHeadroom{ .9f };
+	const bool shouldShrink{ scale < resolution.scale && resolution.averageFrameTime > resolution.targetFrameTime };
+	const bool shouldGrow{ scale > resolution.scale && resolution.averageFrameTime < resolution.targetFrameTime * GrowHeadroom };
+
+	if (shouldShrink || shouldGrow) {
+		// what the average would have been at the new size, instead of waiting for it to catch up
+		resolution.averageFrameTime *= Square(scale / resolution.scale);
+		ApplyResolutionScale(scale);
+	}
 }
 
-bool Renderer::SaveBufferToImage() const
+void Renderer::SetResolutionScale(float scale)
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	ApplyResolutionScale(std::clamp(std::round(scale / ResolutionScaleStep) * ResolutionScaleStep, MinResolutionScale, 1.f));
+}
+
+void Renderer::ApplyResolutionScale(float scale)
+{
+	const int width{ std::max(1, int(std::lround(m_OutputWidth * scale))) };
+	const int height{ std::max(1, int(std::lround(m_OutputHeight * scale))) };
+
+	m_DynamicResolution.scale = scale;
+	if (width == m_Width && height == m_Height) {
+		return;
+	}
+
+	m_Width = width;
+	m_Height = height;
+	m_ImageHeight = height;
+	m_ImageOffsetY = 0;
+
+	// at the output size the renderer writes straight into the surface again
+	if (width == m_OutputWidth && height == m_OutputHeight) {
+		m_ScaledPixels = {};
+		m_pBufferPixels = m_pOutputPixels;
+	}
+	else {
+		m_ScaledPixels.resize(size_t(width) * size_t(height));
+		m_pBufferPixels = m_ScaledPixels.data();
+	}
+
+	m_Accumulation.isDirty = true;
+	BuildTiles();
+}
+
+namespace
+{
+	//Blends every 8 bit channel of two packed pixels, weight 0 is a and 256 is b
+	//Two channels at a time in the 0x00FF00FF lanes, the channel order of the pixel format does not matter
+	uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight)
+	{
+		const uint32_t inverseWeight{ 256 - weight };
+		const uint32_t evenChannels{ (((a & 0x00FF00FF) * inverseWeight + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF };
+		const uint32_t oddChannels{ (((a >> 8) & 0x00FF00FF) * inverseWeight + ((b >> 8) & 0x00FF00FF) * weight) & 0xFF00FF00 };
+		return evenChannels | oddChannels;
+	}
+
+	struct UpscaleSample
+	{
+		uint32_t first{};
+		uint32_t second{};
+		uint32_t weight{}; //of second, out of 256
+	};
+
+	//Where the center of every output pixel lands on an axis of the source image, the pixel centers of both line up
+	std::vector<UpscaleSample> GetUpscaleSamples(uint32_t outputSize, uint32_t sourceSize)
+	{
+		std::vector<UpscaleSample> samples(outputSize);
+		const float scale{ float(sourceSize) / float(outputSize) };
+
+		for (uint32_t i{}; i < outputSize; ++i)
+		{
+			const float position{ std::clamp((i + .5f) * scale - .5f, 0.f, float(sourceSize - 1)) };
+			const uint32_t first{ static_cast<uint32_t>(position) };
+			samples[i].first = first;
+			samples[i].second = std::min(first + 1, sourceSize - 1);
+			samples[i].weight = static_cast<uint32_t>((position - float(first)) * 256.f + .5f);
+		}
+
+		return samples;
+	}
+}
+
+void Renderer::Upscale() const
+{
+	const std::vector<UpscaleSample> columns{ GetUpscaleSamples(uint32_t(m_OutputWidth), uint32_t(m_Width)) };
+	const std::vector<UpscaleSample> rows{ GetUpscaleSamples(uint32_t(m_OutputHeight), uint32_t(m_Height)) };
+
+	constexpr uint32_t RowsPerJob{ 16 };
+	const auto upscaleRows = [&](uint32_t jobIndex) {
+		const uint32_t lastRow{ std::min((jobIndex + 1) * RowsPerJob, uint32_t(m_OutputHeight)) };
+		for (uint32_t y{ jobIndex * RowsPerJob }; y < lastRow; ++y)
+		{
+			const uint32_t* pTopRow{ m_pBufferPixels + size_t(rows[y].first) * m_Width };
+			const uint32_t* pBottomRow{ m_pBufferPixels + size_t(rows[y].second) * m_Width };
+			uint32_t* pOutput{ m_pOutputPixels + size_t(y) * m_OutputWidth };
+
+			for (uint32_t x{}; x < uint32_t(m_OutputWidth); ++x)
+			{
+				const UpscaleSample& column{ columns[x] };
+				const uint32_t top{ LerpPixel(pTopRow[column.first], pTopRow[column.second], column.weight) };
+				const uint32_t bottom{ LerpPixel(pBottomRow[column.first], pBottomRow[column.second], column.weight) };
+				pOutput[x] = LerpPixel(top, bottom, rows[y].weight);
+			}
+		}
+		};
+
+	const uint32_t jobCount{ (uint32_t(m_OutputHeight) + RowsPerJob - 1) / RowsPerJob };
+#if defined(PARALLEL_EXECUTION)
+	m_pThreadPool->ParallelFor(jobCount, upscaleRows);
+#else
+	for (uint32_t jobIndex{}; jobIndex < jobCount; ++jobIndex)
+	{
+		upscaleRows(jobIndex);
+	}
+#endif
+}
+
+void Renderer::SetTileSize(uint32_t tileSize)
+{
+	m_TileSize = std::max(RayPacket::Size, (tileSize + RayPacket::Size - 1) / RayPacket::Size * RayPacket::Size);
+	BuildTiles();
+}
+
+void Renderer::SetThreadCount(uint32_t threadCount)
+{
+	m_pThreadPool = std::make_unique<ThreadPool>(threadCount);
+}
+
+void Renderer::BuildTiles()
+{
+	const uint32_t tilesX{ (uint32_t(m_Width) + m_TileSize - 1) / m_TileSize };
+	const uint32_t tilesY{ (uint32_t(m_Height) + m_TileSize - 1) / m_TileSize };
+
+	std::vector<std::pair<uint32_t, Tile>> orderedTiles{};
+	orderedTiles.reserve(tilesX * tilesY);
+
+	for (uint32_t tileY{}; tileY < tilesY; ++tileY)
+	{
+		for (uint32_t tileX{}; tileX < tilesX; ++tileX)
+		{
+			Tile tile{};
+			tile.x = tileX * m_TileSize;
+			tile.y = tileY * m_TileSize;
+			tile.width = std::min(m_TileSize, uint32_t(m_Width) - tile.x);
+			tile.height = std::min(m_TileSize, uint32_t(m_Height) - tile.y);
+
+			orderedTiles.emplace_back(MortonEncode2D(uint16_t(tileX), uint16_t(tileY)), tile);
+		}
+	}
+
+	// neighbouring tiles end up close in the list, and so on the same thread, until work gets stolen
+	std::sort(orderedTiles.begin(), orderedTiles.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	m_Tiles.clear();
+	m_Tiles.reserve(orderedTiles.size());
+	for (const auto& orderedTile : orderedTiles)
+	{
+		m_Tiles.emplace_back(orderedTile.second);
+	}
+}
+
+float Renderer::GetShadowCacheHitRate() const
+{
+	const uint64_t queryCount{ m_ShadowQueryCount };
+	return queryCount > 0 ? float(m_ShadowCacheHitCount) / float(queryCount) : 0.f;
+}
+
+void Renderer::ResetRayCount()
+{
+	m_RayCount = 0;
+	m_ShadowQueryCount = 0;
+	m_ShadowCacheHitCount = 0;
+	m_SupersampleCount = 0;
+}
+
+void dae::Renderer::TogglePacketTracing()
+{
+	m_PacketTracingEnabled = !m_PacketTracingEnabled;
+	std::cout << (m_PacketTracingEnabled ? "Packet tracing" : "Single ray tracing") << std::endl;
 }
 
 void dae::Renderer::CycleLightingMode()
@@ -166,6 +1142,7 @@ void dae::Renderer::CycleLightingMode()
 	else {
 		m_LightingMode = static_cast<LightingMode>(reset);
 	}
+	m_Accumulation.isDirty = true;
 
 	switch (m_LightingMode)
 	{
@@ -185,3 +1162,103 @@ void dae::Renderer::CycleLightingMode()
 		break;
 	}
 }
+
+void dae::Renderer::ToggleWavefront()
+{
+	m_WavefrontEnabled = !m_WavefrontEnabled;
+	std::cout << (m_WavefrontEnabled ? "Wavefront rendering" : "Tile rendering") << std::endl;
+}
+
+void dae::Renderer::ToggleProgressive()
+{
+	SetProgressiveEnabled(!m_ProgressiveEnabled);
+	std::cout << (m_ProgressiveEnabled ? "Progressive rendering on" : "Progressive rendering off") << std::endl;
+}
+
+void dae::Renderer::SetProgressiveEnabled(bool isEnabled)
+{
+	m_ProgressiveEnabled = isEnabled;
+	m_Accumulation.isDirty = true;
+}
+
+void dae::Renderer::CycleAntiAliasing()
+{
+	switch (m_AntiAliasingMode)
+	{
+	case AntiAliasingMode::Off:
+		SetAntiAliasingMode(AntiAliasingMode::Adaptive);
+		std::cout << "Adaptive anti-aliasing" << std::endl;
+		break;
+	case AntiAliasingMode::Adaptive:
+		SetAntiAliasingMode(AntiAliasingMode::Full);
+		std::cout << "Full 8x anti-aliasing" << std::endl;
+		break;
+	default:
+		SetAntiAliasingMode(AntiAliasingMode::Off);
+		std::cout << "Anti-aliasing off" << std::endl;
+		break;
+	}
+}
+
+void dae::Renderer::SetAntiAliasingMode(AntiAliasingMode mode)
+{
+	m_AntiAliasingMode = mode;
+	m_Accumulation.isDirty = true;
+}
+
+const char* dae::Renderer::GetAntiAliasingModeName(AntiAliasingMode mode)
+{
+	switch (mode)
+	{
+	case AntiAliasingMode::Adaptive:
+		return "adaptive";
+	case AntiAliasingMode::Full:
+		return "full";
+	default:
+		return "off";
+	}
+}
+
+dae::Renderer::AntiAliasingMode dae::Renderer::ParseAntiAliasingMode(const std::string& name)
+{
+	if (name == "adaptive") return AntiAliasingMode::Adaptive;
+	if (name == "full") return AntiAliasingMode::Full;
+	return AntiAliasingMode::Off;
+}
+
+void dae::Renderer::CycleTonemapper()
+{
+	SetTonemapper(static_cast<Tonemapper>((static_cast<int>(m_Tonemapper) + 1) % (static_cast<int>(Tonemapper::ACES) + 1)));
+	std::cout << GetTonemapperName(m_Tonemapper) << " tonemapping" << std::endl;
+}
+
+void dae::Renderer::SetTonemapper(Tonemapper tonemapper)
+{
+	m_Tonemapper = tonemapper;
+	m_IsTonemapDirty = true;
+}
+
+void dae::Renderer::ToggleSRGB()
+{
+	SetSRGBEnabled(!m_SRGBEnabled);
+	std::cout << (m_SRGBEnabled ? "sRGB output" : "Linear output") << std::endl;
+}
+
+void dae::Renderer::SetSRGBEnabled(bool isEnabled)
+{
+	m_SRGBEnabled = isEnabled;
+	m_IsTonemapDirty = true;
+}
+
+void dae::Renderer::SetAntiAliasingThresholds(float contrastThreshold, float varianceThreshold)
+{
+	m_ContrastThreshold = contrastThreshold;
+	m_VarianceThreshold = varianceThreshold;
+	m_Accumulation.isDirty = true;
+}
+
+void dae::Renderer::ToggleShadowCache()
+{
+	m_ShadowCacheEnabled = !m_ShadowCacheEnabled;
+	std::cout << (m_ShadowCacheEnabled ? "Shadow cache on" : "Shadow cache off") << std::endl;
+}
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ColorRGB.h"
 #include "Matrix.h"
+#include "ThreadPool.h"
+#include "Tonemap.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -9,24 +17,129 @@ struct SDL_Surface;
 namespace dae
 {
 	class Scene;
+	struct HitRecord;
+	struct ShadowCache;
+	struct ShadingQueue;
+	struct WavefrontBuffers;
+	struct Light;
+	struct Ray;
+	struct Image;
 
 	class Renderer final
 	{
 	public:
+		enum class AntiAliasingMode
+		{
+			Off,		// one sample per pixel
+			Adaptive,	// extra stratified samples where the local contrast and then the variance of the samples ask for them
+			Full		// every pixel gets all the stratified samples, the quality reference for Adaptive
+		};
+
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		//Headless, renders into a framebuffer owned by the renderer, SDL video never gets initialized
+		Renderer(int width, int height);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
+		//With progressive rendering on, a frame where camera, scene and settings did not change adds a jittered sample
+		//to the previous ones instead of starting over, and nothing is rendered once MaxProgressiveSamples is reached
 		void Render(Scene* pScene) const;
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;
-		bool SaveBufferToImage() const;
+		//RenderPixel and RenderPacket return the number of rays they traced
+		//RenderPixel only queues the shading of its pixel, the pixel is written by the next FlushShading
+		uint32_t RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin,
+			ShadowCache& shadowCache, ShadingQueue& shadingQueue) const;
+		//Traces the RayPacket::Size x RayPacket::Size block of primary rays starting at pixel (blockX, blockY) together
+		uint32_t RenderPacket(Scene* pScene, uint32_t blockX, uint32_t blockY, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin,
+			ShadowCache& shadowCache, ShadingQueue& shadingQueue) const;
+		//Shades every queued light sample, grouped by material type, and writes the queued pixels
+		void FlushShading(const Scene* pScene, ShadingQueue& shadingQueue) const;
+		//Writes the output surface as a BMP on the calling thread, true when it was saved
+		bool SaveBufferToImage(const char* fileName = "RayTracing_Buffer.bmp") const;
+		//Copy of the last frame at the render size to hand to an AsyncImageWriter, so the next frame can render while it is written
+		//The tonemapped colors the surface shows at float precision, or with isLinear the linear colors before tonemapping
+		Image CaptureImage(bool isLinear = false) const;
+		//Renders a GetWidth() x imageHeight image in bands of GetHeight() rows and appends every band to a binary PPM as soon
+		//as it is done, so memory stays at one band however large the image is
+		//Turns dynamic resolution off, progressive rendering is skipped while it runs
+		bool RenderToPPM(Scene* pScene, const std::string& fileName, int imageHeight);
+
+		//Primary and shadow rays traced since the last reset
+		uint64_t GetRayCount() const { return m_RayCount; }
+		//Camera rays the anti-aliasing pass added on top of the one per pixel since the last reset
+		uint64_t GetSupersampleCount() const { return m_SupersampleCount; }
+		//Share of shadow rays since the last reset that were answered by the occluder cache, without traversing the scene
+		float GetShadowCacheHitRate() const;
+		void ResetRayCount();
+
+		//Linear colors of the last frame before tonemapping, at the render size
+		const std::vector<ColorRGB>& GetHDRPixels() const { return m_HDRPixels; }
+		//Row major, in the pixel format of the SDL surface, at the output size
+		const uint32_t* GetPixels() const { return m_pOutputPixels; }
+		int GetWidth() const { return m_OutputWidth; }
+		int GetHeight() const { return m_OutputHeight; }
+		//Size the rays are traced at, smaller than the output while dynamic resolution scales it down
+		int GetRenderWidth() const { return m_Width; }
+		int GetRenderHeight() const { return m_Height; }
 
 		void CycleLightingMode();
-		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; };
+		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; m_Accumulation.isDirty = true; };
+		void TogglePacketTracing();
+		void ToggleShadowCache();
+		void ToggleWavefront();
+		void SetWavefrontEnabled(bool isEnabled) { m_WavefrontEnabled = isEnabled; }
+		bool IsWavefrontEnabled() const { return m_WavefrontEnabled; }
+		void ToggleProgressive();
+		void SetProgressiveEnabled(bool isEnabled);
+		//Samples averaged in the framebuffer, 1 without progressive rendering
+		uint32_t GetSampleCount() const { return std::max(m_Accumulation.sampleCount, 1u); }
+		//True when the last Render call had nothing left to add and returned without rendering
+		bool IsIdle() const { return m_Accumulation.isIdle; }
+
+		static constexpr uint32_t MaxProgressiveSamples{ 256 };
+
+		void CycleAntiAliasing();
+		void SetAntiAliasingMode(AntiAliasingMode mode);
+		AntiAliasingMode GetAntiAliasingMode() const { return m_AntiAliasingMode; }
+		static const char* GetAntiAliasingModeName(AntiAliasingMode mode);
+		//"off", "adaptive" or "full", anything else is Off
+		static AntiAliasingMode ParseAntiAliasingMode(const std::string& name);
+		//contrastThreshold is the luminance range of a 3x3 neighbourhood that earns a pixel its first extra samples,
+		//varianceThreshold the luminance variance of those samples that earns it the rest
+		void SetAntiAliasingThresholds(float contrastThreshold, float varianceThreshold);
+
+		//The frame is rendered into a linear float buffer and tonemapped into the surface in a pass of its own,
+		//changing how it is tonemapped shows up on the next Render without tracing the frame again
+		void CycleTonemapper();
+		void SetTonemapper(Tonemapper tonemapper);
+		Tonemapper GetTonemapper() const { return m_Tonemapper; }
+		//sRGB encodes the tonemapped colors, off by default since the scenes were lit for a plain 0 to 1 display
+		void ToggleSRGB();
+		void SetSRGBEnabled(bool isEnabled);
+		bool IsSRGBEnabled() const { return m_SRGBEnabled; }
+
+		//Dynamic resolution, the render size follows the measured frame time to hold the target and is upscaled bilinearly
+		//0 turns it off and renders at the output size again
+		void SetTargetFrameTime(float targetFrameTime);
+		float GetTargetFrameTime() const { return m_DynamicResolution.targetFrameTime; }
+		//Called once per frame with the time the frame took, picks the render size of the next frame
+		void UpdateResolutionScale(float frameTime);
+		//Render size relative to the output, on both axes, kept between MinResolutionScale and 1 in ResolutionScaleStep steps
+		void SetResolutionScale(float scale);
+		float GetResolutionScale() const { return m_DynamicResolution.scale; }
+
+		static constexpr float MinResolutionScale{ .25f };
+		static constexpr float ResolutionScaleStep{ 1.f / 16.f };
+
+		//Rounded up to a multiple of RayPacket::Size so packets never straddle two tiles
+		void SetTileSize(uint32_t tileSize);
+		uint32_t GetTileSize() const { return m_TileSize; }
+		//0 uses every hardware thread
+		void SetThreadCount(uint32_t threadCount);
+		uint32_t GetThreadCount() const { return m_pThreadPool->GetThreadCount(); }
 
 	private:
 		enum class LightingMode {
@@ -38,15 +151,126 @@ namespace dae
 
 		LightingMode m_LightingMode{ LightingMode::Combined };
 		bool m_ShadowsEnabled{ true };
+		bool m_PacketTracingEnabled{ true };
+		bool m_ShadowCacheEnabled{ true };
+		bool m_WavefrontEnabled{ false };
+		bool m_ProgressiveEnabled{ false };
+
+		AntiAliasingMode m_AntiAliasingMode{ AntiAliasingMode::Off };
+		float m_ContrastThreshold{ .1f };
+		float m_VarianceThreshold{ .0025f };
+		//Colors of the one sample per pixel pass, the anti-aliasing pass reads them and writes the framebuffer
+		mutable std::vector<ColorRGB> m_BaseColors{};
+
+		Tonemapper m_Tonemapper{ Tonemapper::Clamp };
+		bool m_SRGBEnabled{ false };
+		//Set when the tonemapping changed, an idle Render still tonemaps the finished frame again
+		mutable bool m_IsTonemapDirty{ false };
+		//Render size framebuffer of linear, unclamped colors, averaged over the accumulated samples
+		mutable std::vector<ColorRGB> m_HDRPixels{};
+		//Channel positions of the surface format
+		PixelPacking m_PixelPacking{};
 
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
+		//The pixels the renderer writes, the surface itself or m_ScaledPixels while the render size is scaled down
 		uint32_t* m_pBufferPixels{};
+		uint32_t* m_pOutputPixels{};
 
+		//Only used without a window, m_pBuffer then wraps these pixels
+		std::vector<uint32_t> m_HeadlessPixels{};
+		//Render size image of a scaled down frame, in the surface pixel format, upscaled into the surface after rendering
+		std::vector<uint32_t> m_ScaledPixels{};
+
+		//Render size
 		int m_Width{};
 		int m_Height{};
+		//Size of the surface
+		int m_OutputWidth{};
+		int m_OutputHeight{};
+		//The framebuffer is the band of rows starting at m_ImageOffsetY of an m_Width x m_ImageHeight image,
+		//the whole image unless RenderToPPM is rendering it band by band
+		int m_ImageHeight{};
+		int m_ImageOffsetY{};
+
+		struct DynamicResolution
+		{
+			float targetFrameTime{}; //seconds, 0 while turned off
+			float scale{ 1.f };
+			float averageFrameTime{}; //smoothed over a few frames, 0 until the first one
+		};
+		DynamicResolution m_DynamicResolution{};
+
+		struct Tile
+		{
+			uint32_t x{};
+			uint32_t y{};
+			uint32_t width{};
+			uint32_t height{};
+		};
+
+		//Tiles in Morton order, rebuilt when the tile size changes and handed to the pool every frame
+		std::vector<Tile> m_Tiles{};
+		uint32_t m_TileSize{ 16 };
+		std::unique_ptr<ThreadPool> m_pThreadPool{};
+
+		//Ray buffers of the wavefront mode, allocated on its first frame and reused after that
+		mutable std::unique_ptr<WavefrontBuffers> m_pWavefront{};
+
+		//Running sum of the samples of every pixel, and what they were rendered with
+		struct Accumulation
+		{
+			std::vector<ColorRGB> sums{};
+			uint32_t sampleCount{}; //0 while not accumulating
+			Matrix cameraToWorld{};
+			float fovAngle{};
+			bool isDirty{ true }; //a setting changed, the next frame starts over
+			bool isIdle{ false };
+
+			//Sub pixel position of the camera rays this frame, the center for the first sample
+			float jitterX{ .5f };
+			float jitterY{ .5f };
+		};
+		mutable Accumulation m_Accumulation{};
+
+		mutable std::atomic<uint64_t> m_RayCount{};
+		mutable std::atomic<uint64_t> m_ShadowQueryCount{};
+		mutable std::atomic<uint64_t> m_ShadowCacheHitCount{};
+		mutable std::atomic<uint64_t> m_SupersampleCount{};
 
+		void BuildTiles();
+		//Resizes the render buffers and tiles to the output size times the scale
+		void ApplyResolutionScale(float scale);
+		//Bilinear filter of the render size image into the surface
+		void Upscale() const;
+		//Tonemaps m_HDRPixels into the surface, upscaling when the render size is scaled down, and shows it
+		void PresentFrame() const;
+		//Starts a new sample, or returns false when the accumulated image is complete
+		bool UpdateAccumulation(bool hasSceneChanged, const Matrix& cameraToWorld, float fovAngle) const;
+		//Writes the final linear color of a pixel, averaged with its earlier samples while accumulating
+		void WritePixel(uint32_t pixelIndex, ColorRGB color) const;
+		//Writes the pixel, or keeps it for the anti-aliasing pass
+		void StorePixel(uint32_t pixelIndex, ColorRGB color) const;
+		//Shades every queued light sample into shadingQueue.colors, one color per queued pixel
+		void ResolveShading(const Scene* pScene, ShadingQueue& shadingQueue) const;
+		//Renders the frame stage by stage instead of pixel by pixel: camera rays, intersection, compaction,
+		//shadow rays sorted by octant and origin, occlusion, shading
+		void RenderWavefront(Scene* pScene, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;
+		void RenderTile(Scene* pScene, const Tile& tile, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;
+		Vector3 GetViewDirection(uint32_t px, uint32_t py, float fov, float aspectRatio, const Matrix& cameraToWorld) const;
+		//rx and ry in pixels, (px + .5f, py + .5f) is the center of pixel (px, py)
+		Vector3 GetViewDirection(float rx, float ry, float fov, float aspectRatio, const Matrix& cameraToWorld) const;
+		//Adds stratified samples to the pixels of the tile that need them and writes every pixel of the tile
+		void AntiAliasTile(Scene* pScene, const Tile& tile, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;
+		float GetLocalContrast(uint32_t px, uint32_t py) const;
+		//Traces the shadow rays of a hit and queues its light samples, returns the number of shadow rays
+		uint32_t QueuePixel(Scene* pScene, uint32_t px, uint32_t py, const Vector3& rayDirection, const HitRecord& closestHit,
+			ShadowCache& shadowCache, ShadingQueue& shadingQueue) const;
+		//Queues the contribution of one unoccluded light, lightDirection is normalized
+		void QueueLightSample(const Scene* pScene, uint32_t pixel, const Light& light, const HitRecord& closestHit, const Vector3& lightDirection,
+			const Vector3& rayDirection, ShadingQueue& shadingQueue) const;
+		static Ray CreateShadowRay(const Light& light, const HitRecord& closestHit);
 
 	};
 }
@@ -0,0 +1,94 @@
+#pragma once
+#include <string_view>
+
+//SIMD configuration shared by the vectorized kernels
+//Define DAE_SIMD_DISABLE to force the scalar code paths
+#if !defined(DAE_SIMD_DISABLE)
+	#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define DAE_SIMD_SSE 1
+		#include <immintrin.h>
+	#endif
+
+	#if defined(DAE_SIMD_SSE) && defined(__AVX2__)
+		#define DAE_SIMD_AVX2 1
+	#endif
+#endif
+
+//A baseline SSE build still compiles the AVX2 kernels, for their own functions only, and picks them at runtime
+//when the CPU supports them (see GeometryUtils::GetKernelTable). An AVX2 build compiles everything for AVX2
+//but still goes through the table, so a narrower path can be forced for comparison.
+#if defined(DAE_SIMD_SSE) && !defined(DAE_SIMD_AVX2)
+	#define DAE_SIMD_RUNTIME_DISPATCH 1
+	#if defined(_MSC_VER) && !defined(__clang__)
+		// MSVC allows AVX2 intrinsics anywhere
+		#define DAE_TARGET_AVX2
+		#include <intrin.h>
+	#else
+		#define DAE_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#else
+	#define DAE_TARGET_AVX2
+#endif
+
+namespace dae
+{
+	enum class SIMDLevel
+	{
+		Scalar,
+		SSE,
+		AVX2
+	};
+
+	inline const char* GetSIMDLevelName(SIMDLevel level)
+	{
+		switch (level)
+		{
+		case SIMDLevel::AVX2: return "AVX2";
+		case SIMDLevel::SSE: return "SSE";
+		default: return "Scalar";
+		}
+	}
+
+	//"scalar", "sse" or "avx2", false and level left alone on anything else
+	inline bool ParseSIMDLevel(std::string_view name, SIMDLevel& level)
+	{
+		if (name == "scalar") level = SIMDLevel::Scalar;
+		else if (name == "sse") level = SIMDLevel::SSE;
+		else if (name == "avx2") level = SIMDLevel::AVX2;
+		else return false;
+		return true;
+	}
+
+	//Widest kernels this build can run on this CPU
+	inline SIMDLevel DetectSIMDLevel()
+	{
+#if defined(DAE_SIMD_AVX2)
+		return SIMDLevel::AVX2;
+#elif defined(DAE_SIMD_RUNTIME_DISPATCH)
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int registers[4]{};
+		__cpuid(registers, 0);
+		if (registers[0] < 7)
+			return SIMDLevel::SSE;
+
+		// AVX needs the OS to save the ymm registers on a context switch
+		__cpuid(registers, 1);
+		const bool hasOSXSave{ (registers[2] & (1 << 27)) != 0 };
+		const bool hasAVX{ (registers[2] & (1 << 28)) != 0 };
+		if (!hasOSXSave || !hasAVX || (_xgetbv(0) & 0x6) != 0x6)
+			return SIMDLevel::SSE;
+
+		__cpuidex(registers, 7, 0);
+		const bool hasAVX2{ (registers[1] & (1 << 5)) != 0 };
+		return hasAVX2 ? SIMDLevel::AVX2 : SIMDLevel::SSE;
+	#else
+		// also checks that the OS saves the ymm registers
+		return __builtin_cpu_supports("avx2") ? SIMDLevel::AVX2 : SIMDLevel::SSE;
+	#endif
+#elif defined(DAE_SIMD_SSE)
+		return SIMDLevel::SSE;
+#else
+		return SIMDLevel::Scalar;
+#endif
+	}
+}
@@ -1,85 +1,461 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "MeshIO.h"
+
+#include <iostream>
 
 namespace dae {
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
-	Scene::Scene() :
-		m_Materials({ new Material_SolidColor({1,0,0}) })
+	Scene::Scene()
 	{
+		m_Materials.Add(Material_SolidColor{ { 1, 0, 0 } });
+
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
 		m_Lights.reserve(32);
 	}
 
-	Scene::~Scene()
+	Scene::~Scene() = default;
+
+	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
-		for (auto& pMaterial : m_Materials)
-		{
-			delete pMaterial;
-			pMaterial = nullptr;
+		////todo W1
+		//throw std::runtime_error("Not Implemented Yet");
+
+		// planes are infinite, they can't be bounded by the top level BVH
+		for (auto& plane : m_PlaneGeometries) {
+			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
 		}
 
-		m_Materials.clear();
+		TraverseTopLevel(ray, closestHit);
 	}
 
-	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	bool Scene::DoesHit(const Ray& ray) const
 	{
-		////todo W1
+		////todo W2
 		//throw std::runtime_error("Not Implemented Yet");
+		//return false;
+
+		uint32_t occluder{};
+		return FindOccluder(ray, occluder);
+	}
+
+	bool Scene::DoesHit(const Ray& ray, ShadowCache& shadowCache, uint32_t lightIndex) const
+	{
+		if (lightIndex >= shadowCache.lastOccluders.size()) {
+			shadowCache.lastOccluders.resize(lightIndex + 1, ShadowCache::NoOccluder);
+		}
+
+		++shadowCache.queryCount;
+
+		uint32_t& lastOccluder{ shadowCache.lastOccluders[lightIndex] };
+		if (lastOccluder != ShadowCache::NoOccluder && OcclusionTest_Occluder(lastOccluder, ray)) {
+			++shadowCache.hitCount;
+			return true;
+		}
+
+		// lit pixels forget the occluder, otherwise every lit pixel would pay for testing it
+		if (!FindOccluder(ray, lastOccluder)) {
+			lastOccluder = ShadowCache::NoOccluder;
+			return false;
+		}
+		return true;
+	}
+
+	void Scene::GetClosestHits(const RayPacket& packet, RayPacketHit& hit) const
+	{
+		constexpr uint32_t allLanes{ (1u << RayPacket::Width) - 1 };
 
 		for (auto& plane : m_PlaneGeometries) {
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
+			GeometryUtils::HitTest_PlanePacket(plane, packet, allLanes, hit);
+		}
+
+		TraverseTopLevelPacket(packet, hit);
+	}
+
+	void Scene::UpdateAccelerationStructure()
+	{
+		const size_t primitiveCount{ m_SphereGeometries.size() + m_TriangleMeshGeometries.size() +
+			m_TriangleMeshInstances.size() + m_Triangles.size() };
+		const bool needsRebuild{ m_TopLevelPrimitives.size() != primitiveCount };
+
+		if (!needsRebuild && !m_TopLevelDirty) {
+			return;
 		}
 
-		for (auto& sphere : m_SphereGeometries) {
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
+		if (needsRebuild) {
+			m_TopLevelPrimitives.clear();
+			m_TopLevelPrimitives.reserve(primitiveCount);
+
+			for (uint32_t i{}; i < m_SphereGeometries.size(); ++i) {
+				m_TopLevelPrimitives.push_back({ PrimitiveType::Sphere, i });
+			}
+			for (uint32_t i{}; i < m_TriangleMeshGeometries.size(); ++i) {
+				m_TopLevelPrimitives.push_back({ PrimitiveType::TriangleMesh, i });
+			}
+			for (uint32_t i{}; i < m_TriangleMeshInstances.size(); ++i) {
+				m_TopLevelPrimitives.push_back({ PrimitiveType::TriangleMeshInstance, i });
+			}
+			for (uint32_t i{}; i < m_Triangles.size(); ++i) {
+				m_TopLevelPrimitives.push_back({ PrimitiveType::Triangle, i });
+			}
 		}
 
-		for (auto& triangle : m_TriangleMeshGeometries) {
-			GeometryUtils::HitTest_TriangleMesh(triangle, ray, closestHit);
+		std::vector<AABB> bounds{};
+		GatherTopLevelBounds(bounds);
+
+		if (needsRebuild) {
+			m_TopLevelBVH.Build(bounds);
+			m_TopLevelBuildArea = m_TopLevelBVH.GetBounds().GetSurfaceArea();
 		}
+		else {
+			m_TopLevelBVH.Refit(bounds);
 
-		for (auto& triangle : m_Triangles) {
-			GeometryUtils::HitTest_Triangle(triangle, ray, closestHit);
+			// a refit keeps the old topology, once the tree got too loose a rebuild pays for itself
+			if (m_TopLevelBVH.GetBounds().GetSurfaceArea() > 2.f * m_TopLevelBuildArea) {
+				m_TopLevelBVH.Build(bounds);
+				m_TopLevelBuildArea = m_TopLevelBVH.GetBounds().GetSurfaceArea();
+			}
 		}
+
+		m_TopLevelDirty = false;
 	}
 
-	bool Scene::DoesHit(const Ray& ray) const
+	void Scene::GatherTopLevelBounds(std::vector<AABB>& bounds) const
 	{
-		////todo W2
-		//throw std::runtime_error("Not Implemented Yet");
-		//return false;
+		bounds.clear();
+		bounds.reserve(m_TopLevelPrimitives.size());
 
-		for (auto& sphere : m_SphereGeometries) {
-			if (GeometryUtils::HitTest_Sphere(sphere, ray)) {
-				return true;
+		for (const TopLevelPrimitive& primitive : m_TopLevelPrimitives)
+		{
+			AABB primitiveBounds{};
+
+			switch (primitive.type)
+			{
+			case PrimitiveType::Sphere:
+			{
+				const Sphere& sphere{ m_SphereGeometries[primitive.index] };
+				const Vector3 extent{ sphere.radius, sphere.radius, sphere.radius };
+				primitiveBounds.Grow(sphere.origin - extent);
+				primitiveBounds.Grow(sphere.origin + extent);
+				break;
+			}
+			case PrimitiveType::TriangleMesh:
+				primitiveBounds = m_TriangleMeshGeometries[primitive.index].bvh.GetBounds();
+				break;
+			case PrimitiveType::TriangleMeshInstance:
+				primitiveBounds = m_TriangleMeshInstances[primitive.index].worldBounds;
+				break;
+			case PrimitiveType::Triangle:
+			{
+				const Triangle& triangle{ m_Triangles[primitive.index] };
+				primitiveBounds.Grow(triangle.v0);
+				primitiveBounds.Grow(triangle.v1);
+				primitiveBounds.Grow(triangle.v2);
+				break;
 			}
+			}
+
+			bounds.emplace_back(primitiveBounds);
 		}
+	}
 
-		for (auto& plane : m_PlaneGeometries) {
-			if (GeometryUtils::HitTest_Plane(plane, ray)) {
-				return true;
+	bool Scene::TraverseTopLevel(const Ray& ray, HitRecord& hitRecord, uint32_t startNodeIndex) const
+	{
+		const std::vector<BVHNode>& nodes{ m_TopLevelBVH.GetNodes() };
+		if (nodes.empty()) {
+			return false;
+		}
+
+		const std::vector<uint32_t>& primitiveIndices{ m_TopLevelBVH.GetPrimitiveIndices() };
+		const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+		if (GeometryUtils::SlabTest_BVHNode(nodes[startNodeIndex], ray, invDirection, std::min(ray.max, hitRecord.t)) == FLT_MAX) {
+			return false;
+		}
+
+		bool didHit{ false };
+
+		uint32_t stack[BVH::MaxDepth];
+		uint32_t stackSize{};
+		uint32_t nodeIndex{ startNodeIndex };
+
+		while (true)
+		{
+			const BVHNode& node{ nodes[nodeIndex] };
+
+			if (node.IsLeaf())
+			{
+				for (uint32_t i{}; i < node.primitiveCount; ++i)
+				{
+					const TopLevelPrimitive& primitive{ m_TopLevelPrimitives[primitiveIndices[node.leftFirst + i]] };
+					if (HitTest_TopLevelPrimitive(primitive, ray, hitRecord))
+					{
+						didHit = true;
+					}
+				}
+
+				if (stackSize == 0) {
+					break;
+				}
+				nodeIndex = stack[--stackSize];
+				continue;
+			}
+
+			uint32_t nearIndex{ node.leftFirst };
+			uint32_t farIndex{ node.leftFirst + 1 };
+
+			const float tMax{ std::min(ray.max, hitRecord.t) };
+			float nearDistance{ GeometryUtils::SlabTest_BVHNode(nodes[nearIndex], ray, invDirection, tMax) };
+			float farDistance{ GeometryUtils::SlabTest_BVHNode(nodes[farIndex], ray, invDirection, tMax) };
+
+			if (farDistance < nearDistance) {
+				std::swap(nearIndex, farIndex);
+				std::swap(nearDistance, farDistance);
+			}
+
+			if (nearDistance == FLT_MAX) {
+				if (stackSize == 0) {
+					break;
+				}
+				nodeIndex = stack[--stackSize];
+				continue;
+			}
+
+			nodeIndex = nearIndex;
+			if (farDistance != FLT_MAX) {
+				stack[stackSize++] = farIndex;
 			}
 		}
 
-		for (auto& triangle : m_TriangleMeshGeometries) {
-			if (GeometryUtils::HitTest_TriangleMesh(triangle, ray)) {
+		return didHit;
+	}
+
+	bool Scene::HitTest_TopLevelPrimitive(const TopLevelPrimitive& primitive, const Ray& ray, HitRecord& hitRecord) const
+	{
+		switch (primitive.type)
+		{
+		case PrimitiveType::Sphere:
+			return GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], ray, hitRecord);
+		case PrimitiveType::TriangleMesh:
+			return GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitive.index], ray, hitRecord);
+		case PrimitiveType::TriangleMeshInstance:
+			return GeometryUtils::HitTest_TriangleMeshInstance(m_TriangleMeshInstances[primitive.index], ray, hitRecord);
+		case PrimitiveType::Triangle:
+		{
+			HitRecord hitRec{};
+			if (GeometryUtils::HitTest_Triangle(m_Triangles[primitive.index], ray, hitRec) && hitRec.t < hitRecord.t) {
+				hitRecord = hitRec;
 				return true;
 			}
+			return false;
+		}
+		default:
+			return false;
 		}
+	}
 
-		for (auto& triangle : m_Triangles) {
-			if (GeometryUtils::HitTest_Triangle(triangle, ray)) {
+	bool Scene::FindOccluder(const Ray& ray, uint32_t& occluder) const
+	{
+		const uint32_t planeCount{ static_cast<uint32_t>(m_PlaneGeometries.size()) };
+		for (uint32_t i{}; i < planeCount; ++i) {
+			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[i], ray)) {
+				occluder = i;
 				return true;
 			}
 		}
+
+		uint32_t primitiveIndex{};
+		if (TraverseTopLevelOcclusion(ray, primitiveIndex)) {
+			occluder = planeCount + primitiveIndex;
+			return true;
+		}
+		return false;
+	}
+
+	bool Scene::TraverseTopLevelOcclusion(const Ray& ray, uint32_t& primitiveIndex) const
+	{
+		const std::vector<BVHNode>& nodes{ m_TopLevelBVH.GetNodes() };
+		if (nodes.empty()) {
+			return false;
+		}
+
+		const std::vector<uint32_t>& primitiveIndices{ m_TopLevelBVH.GetPrimitiveIndices() };
+		const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+		if (GeometryUtils::SlabTest_BVHNode(nodes[0], ray, invDirection, ray.max) == FLT_MAX) {
+			return false;
+		}
+
+		// any occluder will do, so children are not sorted by distance
+		uint32_t stack[BVH::MaxDepth];
+		uint32_t stackSize{};
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const BVHNode& node{ nodes[stack[--stackSize]] };
+
+			if (node.IsLeaf())
+			{
+				for (uint32_t i{}; i < node.primitiveCount; ++i)
+				{
+					const uint32_t index{ primitiveIndices[node.leftFirst + i] };
+					if (OcclusionTest_TopLevelPrimitive(m_TopLevelPrimitives[index], ray)) {
+						primitiveIndex = index;
+						return true;
+					}
+				}
+				continue;
+			}
+
+			for (uint32_t childIndex{ node.leftFirst }; childIndex < node.leftFirst + 2; ++childIndex)
+			{
+				if (GeometryUtils::SlabTest_BVHNode(nodes[childIndex], ray, invDirection, ray.max) != FLT_MAX) {
+					stack[stackSize++] = childIndex;
+				}
+			}
+		}
+
 		return false;
 	}
 
+	bool Scene::OcclusionTest_Occluder(uint32_t occluder, const Ray& ray) const
+	{
+		const uint32_t planeCount{ static_cast<uint32_t>(m_PlaneGeometries.size()) };
+		if (occluder < planeCount) {
+			return GeometryUtils::HitTest_Plane(m_PlaneGeometries[occluder], ray);
+		}
+		return OcclusionTest_TopLevelPrimitive(m_TopLevelPrimitives[occluder - planeCount], ray);
+	}
+
+	bool Scene::OcclusionTest_TopLevelPrimitive(const TopLevelPrimitive& primitive, const Ray& ray) const
+	{
+		switch (primitive.type)
+		{
+		case PrimitiveType::Sphere:
+			return GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], ray);
+		case PrimitiveType::TriangleMesh:
+			return GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitive.index], ray);
+		case PrimitiveType::TriangleMeshInstance:
+			return GeometryUtils::HitTest_TriangleMeshInstance(m_TriangleMeshInstances[primitive.index], ray);
+		case PrimitiveType::Triangle:
+			return GeometryUtils::HitTest_Triangle(m_Triangles[primitive.index], ray);
+		default:
+			return false;
+		}
+	}
+
+	void Scene::TraverseTopLevelPacket(const RayPacket& packet, RayPacketHit& hit) const
+	{
+		const std::vector<BVHNode>& nodes{ m_TopLevelBVH.GetNodes() };
+		if (nodes.empty()) {
+			return;
+		}
+
+		const std::vector<uint32_t>& primitiveIndices{ m_TopLevelBVH.GetPrimitiveIndices() };
+
+		float entry{};
+		uint32_t mask{ GeometryUtils::SlabTest_BVHNodePacket(nodes[0], packet, hit.t, (1u << RayPacket::Width) - 1, entry) };
+		if (mask == 0) {
+			return;
+		}
+
+		struct StackEntry
+		{
+			uint32_t nodeIndex{};
+			uint32_t mask{};
+		};
+
+		StackEntry stack[BVH::MaxDepth];
+		uint32_t stackSize{};
+		uint32_t nodeIndex{};
+
+		while (true)
+		{
+			const BVHNode& node{ nodes[nodeIndex] };
+
+			if (node.IsLeaf())
+			{
+				for (uint32_t i{}; i < node.primitiveCount; ++i)
+				{
+					const TopLevelPrimitive& primitive{ m_TopLevelPrimitives[primitiveIndices[node.leftFirst + i]] };
+					HitTest_TopLevelPrimitivePacket(primitive, packet, mask, hit);
+				}
+			}
+			else if (std::popcount(mask) == 1)
+			{
+				// the packet diverged, a single ray is cheaper than carrying the empty lanes along
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+				TraverseTopLevel(packet.GetRay(lane), hit.records[lane], nodeIndex);
+				hit.t[lane] = hit.records[lane].t;
+			}
+			else
+			{
+				uint32_t nearIndex{ node.leftFirst };
+				uint32_t farIndex{ node.leftFirst + 1 };
+
+				float nearDistance{}, farDistance{};
+				uint32_t nearMask{ GeometryUtils::SlabTest_BVHNodePacket(nodes[nearIndex], packet, hit.t, mask, nearDistance) };
+				uint32_t farMask{ GeometryUtils::SlabTest_BVHNodePacket(nodes[farIndex], packet, hit.t, mask, farDistance) };
+
+				if (farDistance < nearDistance) {
+					std::swap(nearIndex, farIndex);
+					std::swap(nearMask, farMask);
+				}
+
+				if (nearMask != 0)
+				{
+					nodeIndex = nearIndex;
+					mask = nearMask;
+					if (farMask != 0) {
+						stack[stackSize++] = { farIndex, farMask };
+					}
+					continue;
+				}
+			}
+
+			if (stackSize == 0) {
+				break;
+			}
+			--stackSize;
+			nodeIndex = stack[stackSize].nodeIndex;
+			mask = stack[stackSize].mask;
+		}
+	}
+
+	uint32_t Scene::HitTest_TopLevelPrimitivePacket(const TopLevelPrimitive& primitive, const RayPacket& packet, uint32_t activeMask, RayPacketHit& hit) const
+	{
+		switch (primitive.type)
+		{
+		case PrimitiveType::Sphere:
+			return GeometryUtils::HitTest_SpherePacket(m_SphereGeometries[primitive.index], packet, activeMask, hit);
+		case PrimitiveType::TriangleMesh:
+			return GeometryUtils::HitTest_TriangleMeshPacket(m_TriangleMeshGeometries[primitive.index], packet, activeMask, hit);
+		case PrimitiveType::TriangleMeshInstance:
+			return GeometryUtils::HitTest_TriangleMeshInstancePacket(m_TriangleMeshInstances[primitive.index], packet, activeMask, hit);
+		default:
+		{
+			// loose triangles have no packet kernel, test lane by lane
+			uint32_t hitMask{};
+			for (uint32_t mask{ activeMask }; mask != 0; mask &= mask - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+				if (HitTest_TopLevelPrimitive(primitive, packet.GetRay(lane), hit.records[lane]))
+				{
+					hit.t[lane] = hit.records[lane].t;
+					hitMask |= 1u << lane;
+				}
+			}
+			return hitMask;
+		}
+		}
+	}
+
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
@@ -113,6 +489,26 @@ namespace dae {
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	TriangleMesh* Scene::AddInstancedMesh(TriangleCullMode cullMode)
+	{
+		TriangleMesh m{};
+		m.cullMode = cullMode;
+
+		m_InstancedMeshes.emplace_back(m);
+		return &m_InstancedMeshes.back();
+	}
+
+	TriangleMeshInstance* Scene::AddTriangleMeshInstance(const TriangleMesh* pMesh, const Matrix& transform, unsigned char materialIndex)
+	{
+		TriangleMeshInstance i{};
+		i.pMesh = pMesh;
+		i.materialIndex = materialIndex;
+		i.SetTransform(transform);
+
+		m_TriangleMeshInstances.emplace_back(i);
+		return &m_TriangleMeshInstances.back();
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -137,11 +533,6 @@ namespace dae {
 		return &m_Lights.back();
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
-	{
-		m_Materials.push_back(pMaterial);
-		return static_cast<unsigned char>(m_Materials.size() - 1);
-	}
 #pragma endregion
 #pragma endregion
 
@@ -150,11 +541,11 @@ namespace dae {
 	{
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue    = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue    = AddMaterial(Material_SolidColor{ colors::Blue });
 
-		const unsigned char matId_Solid_Yellow  = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green   = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow  = AddMaterial(Material_SolidColor{ colors::Yellow });
+		const unsigned char matId_Solid_Green   = AddMaterial(Material_SolidColor{ colors::Green });
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material_SolidColor{ colors::Magenta });
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -177,11 +568,11 @@ namespace dae {
 
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue    = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue    = AddMaterial(Material_SolidColor{ colors::Blue });
 
-		const unsigned char matId_Solid_Yellow  = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green   = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow  = AddMaterial(Material_SolidColor{ colors::Yellow });
+		const unsigned char matId_Solid_Green   = AddMaterial(Material_SolidColor{ colors::Green });
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material_SolidColor{ colors::Magenta });
 
 		//Spheres
 		AddSphere({ -1.75f, 1.f, 0.f }, .75f, matId_Solid_Red);
@@ -210,21 +601,21 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;		
 
 		//metals
-		const auto matCT_GrayRoughMetal  = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughMetal  = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
 		
 		//non-metals
-		const auto matCT_GrayRoughPlastic  = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughPlastic  = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
 
 		//Lambert-Phong Spheres & Materials
-		//const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
-		//const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
-		//const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
+		//const auto matLambertPhong1 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
+		//const auto matLambertPhong2 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
+		//const auto matLambertPhong3 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
 		//
 		//AddSphere(Vector3{ -1.75f, 1.f, 0.f }, .75f, matLambertPhong1);
 		//AddSphere(Vector3{ 0.f, 1.f, 0.f }, .75f, matLambertPhong2);
@@ -258,8 +649,8 @@ namespace dae {
 		m_Camera.origin   = { 0.f, 3.f, -9.f };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
-		const auto matLambert_White    = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const auto matLambert_White    = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		//Plane
 		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f,0.f }, matLambert_GrayBlue);	//LEFT
@@ -288,7 +679,7 @@ namespace dae {
 			0, 2, 3  // triangle 2
 		};
 
-		//Utils::ParseOBJ("resources/lowpoly_bunny.obj", 
+		//MeshIO::LoadOBJ("resources/lowpoly_bunny.obj", 
 		//	pMesh->positions, 
 		//	pMesh->normals, 
 		//	pMesh->indices);
@@ -301,6 +692,7 @@ namespace dae {
 		pMesh->Translate({ 0.f, 1.5f, 0.f });
 		pMesh->RotateY(45);
 
+		pMesh->UpdateAABB();
 		pMesh->UpdateTransforms();
 
 		//Light
@@ -313,9 +705,11 @@ namespace dae {
 	{
 		Scene::Update(pTimer);
 
+		// object space positions don't change, UpdateTransforms refits the mesh BVH
 		pMesh->RotateY(PI_DIV_2 * pTimer->GetTotal());
-		pMesh->UpdateAABB();
 		pMesh->UpdateTransforms();
+
+		m_TopLevelDirty = true;
 	}
 #pragma endregion
 
@@ -327,17 +721,17 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//metals
-		const auto matCT_GrayRoughMetal  = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughMetal  = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
 
 		//non-metals
-		const auto matCT_GrayRoughPlastic  = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughPlastic  = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
-		const auto matLambert_White    = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const auto matLambert_White    = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f,0.f }, matLambert_GrayBlue);	//LEFT
@@ -359,16 +753,19 @@ namespace dae {
 
 		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
 		m_Meshes[0]->AppendTriangle(baseTriangle, true);
+		m_Meshes[0]->UpdateAABB();
 		m_Meshes[0]->Translate({ -1.75f, 4.5f, 0.f });
 		m_Meshes[0]->UpdateTransforms();
 
 		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
 		m_Meshes[1]->AppendTriangle(baseTriangle, true);
+		m_Meshes[1]->UpdateAABB();
 		m_Meshes[1]->Translate({ 0.f, 4.5f, 0.f });
 		m_Meshes[1]->UpdateTransforms();
 
 		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
 		m_Meshes[2]->AppendTriangle(baseTriangle, true);
+		m_Meshes[2]->UpdateAABB();
 		m_Meshes[2]->Translate({ 1.75f, 4.5f, 0.f });
 		m_Meshes[2]->UpdateTransforms();
 
@@ -385,9 +782,10 @@ namespace dae {
 		for (const auto& pMesh : m_Meshes)
 		{
 			pMesh->RotateY(yawAngle);
-			pMesh->UpdateAABB();
 			pMesh->UpdateTransforms();
 		}
+
+		m_TopLevelDirty = true;
 	}
 #pragma endregion
 
@@ -398,8 +796,8 @@ namespace dae {
 		m_Camera.origin   = { 0.f, 3.f, -9.f };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
-		const auto matLambert_White    = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const auto matLambert_White    = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		//Plane
 		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f,0.f }, matLambert_GrayBlue);	//LEFT
@@ -408,18 +806,22 @@ namespace dae {
 		AddPlane(Vector3{ 0.f, 10.f, 0.f }, Vector3{ 0.f, -1.f,0.f }, matLambert_GrayBlue);	//TOP
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f,-1.f }, matLambert_GrayBlue);	//BACK
 
-		//bunny mesh
-		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		//bunny mesh, instanced so the geometry isn't copied into world space
+		pMesh = AddInstancedMesh(TriangleCullMode::BackFaceCulling);
 
-		Utils::ParseOBJ("resources/lowpoly_bunny.obj",
-			pMesh->positions,
-			pMesh->normals,
-			pMesh->indices);
-
-		pMesh->Scale({ 2.f, 2.f, 2.f });
+		// parsed and prepared once, later starts map the cache next to the OBJ
+		MeshIO::LoadStatistics loadStatistics{};
+		if (MeshIO::LoadInstancedOBJ("resources/lowpoly_bunny.obj", *pMesh, &loadStatistics))
+		{
+			std::cout << "Loaded lowpoly_bunny.obj" << (loadStatistics.isFromCache ? " from its cache: " : ": ") << loadStatistics.triangleCount
+				<< " triangles in " << loadStatistics.seconds * 1000.0 << "ms (" << loadStatistics.GetMegabytesPerSecond() << " MB/s)" << std::endl;
+		}
+		else
+		{
+			std::cout << "Something went wrong. lowpoly_bunny.obj not loaded!" << std::endl;
+		}
 
-		pMesh->UpdateAABB();
-		pMesh->UpdateTransforms();
+		AddTriangleMeshInstance(pMesh, Matrix::CreateScale({ 2.f, 2.f, 2.f }), matLambert_White);
 
 		//Light
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f });		//backlight
@@ -427,5 +829,16 @@ namespace dae {
 		AddPointLight(Vector3{ 2.5f, 2.5f, -5.f }, 50.f, ColorRGB{ .34f, .47f, .68f });
 	}
 #pragma endregion
+
+	Scene* CreateScene(const std::string& sceneName)
+	{
+		if (sceneName == "W1") return new Scene_W1();
+		if (sceneName == "W2") return new Scene_W2();
+		if (sceneName == "W3") return new Scene_W3();
+		if (sceneName == "W4") return new Scene_W4();
+		if (sceneName == "ReferenceScene") return new Scene_W4_ReferenceScene();
+		if (sceneName == "BunnyScene") return new Scene_W4_BunnyScene();
+		return nullptr;
+	}
 }
 
@@ -1,20 +1,32 @@
 #pragma once
+#include <deque>
 #include <string>
 #include <vector>
 
 #include "Maths.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "Material.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
 
+	//Last primitive that blocked a shadow ray towards each light, neighbouring pixels are usually blocked by the same one
+	//Not thread safe, the renderer keeps one per tile so it never leaves the thread rendering that tile
+	struct ShadowCache
+	{
+		static constexpr uint32_t NoOccluder{ UINT32_MAX };
+
+		std::vector<uint32_t> lastOccluders{};
+		uint64_t queryCount{};
+		uint64_t hitCount{};
+	};
+
 	//Scene Base Class
 	class Scene
 	{
@@ -36,11 +48,20 @@ namespace dae
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
 		bool DoesHit(const Ray& ray) const;
+		//Tests the primitive that blocked the previous ray towards lightIndex first, then the whole scene
+		bool DoesHit(const Ray& ray, ShadowCache& shadowCache, uint32_t lightIndex) const;
+		//Closest hit of every lane of a coherent packet, hit has to be default constructed (or hold earlier hits)
+		void GetClosestHits(const RayPacket& packet, RayPacketHit& hit) const;
+
+		//Rebuilds the top level BVH when primitives were added, refits it when something moved
+		void UpdateAccelerationStructure();
+		//True when primitives were added or moved since the last UpdateAccelerationStructure
+		bool IsDirty() const { return m_TopLevelDirty; }
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const MaterialTable& GetMaterials() const { return m_Materials; }
 
 	protected:
 		std::string	sceneName;
@@ -48,21 +69,63 @@ namespace dae
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		//Deques, instances keep pointers to their meshes and scenes keep pointers to their instances,
+		//adding one must not move the others
+		std::deque<TriangleMesh> m_InstancedMeshes{};
+		std::deque<TriangleMeshInstance> m_TriangleMeshInstances{};
 		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		MaterialTable m_Materials{};
 
 		//temp 
 		std::vector<Triangle> m_Triangles{};
 
 		Camera m_Camera{};
 
+		//Set by scenes that move geometry in Update, the top level BVH gets refitted before the next render
+		bool m_TopLevelDirty{ true };
+
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		TriangleMesh* AddInstancedMesh(TriangleCullMode cullMode);
+		TriangleMeshInstance* AddTriangleMeshInstance(const TriangleMesh* pMesh, const Matrix& transform, unsigned char materialIndex = 0);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		template<typename TMaterial>
+		unsigned char AddMaterial(const TMaterial& material) { return m_Materials.Add(material); }
+
+	private:
+		enum class PrimitiveType : uint32_t
+		{
+			Sphere,
+			TriangleMesh,
+			TriangleMeshInstance,
+			Triangle
+		};
+
+		struct TopLevelPrimitive
+		{
+			PrimitiveType type{};
+			uint32_t index{};
+		};
+
+		//Top level BVH over every bounded primitive, infinite planes are tested separately
+		BVH m_TopLevelBVH{};
+		std::vector<TopLevelPrimitive> m_TopLevelPrimitives{};
+		float m_TopLevelBuildArea{};
+
+		void GatherTopLevelBounds(std::vector<AABB>& bounds) const;
+		bool TraverseTopLevel(const Ray& ray, HitRecord& hitRecord, uint32_t startNodeIndex = 0) const;
+		bool HitTest_TopLevelPrimitive(const TopLevelPrimitive& primitive, const Ray& ray, HitRecord& hitRecord) const;
+
+		//Occluders are numbered planes first, then top level primitives
+		bool FindOccluder(const Ray& ray, uint32_t& occluder) const;
+		bool TraverseTopLevelOcclusion(const Ray& ray, uint32_t& primitiveIndex) const;
+		bool OcclusionTest_TopLevelPrimitive(const TopLevelPrimitive& primitive, const Ray& ray) const;
+		bool OcclusionTest_Occluder(uint32_t occluder, const Ray& ray) const;
+		void TraverseTopLevelPacket(const RayPacket& packet, RayPacketHit& hit) const;
+		uint32_t HitTest_TopLevelPrimitivePacket(const TopLevelPrimitive& primitive, const RayPacket& packet, uint32_t activeMask, RayPacketHit& hit) const;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -172,4 +235,7 @@ namespace dae
 	private:
 		TriangleMesh* pMesh{ nullptr };
 	};
+
+	//Creates a scene by name: W1, W2, W3, W4, ReferenceScene or BunnyScene, nullptr for anything else
+	Scene* CreateScene(const std::string& sceneName);
 }
@@ -0,0 +1,146 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		m_Queues.reserve(threadCount);
+		for (uint32_t i{}; i < threadCount; ++i)
+		{
+			m_Queues.emplace_back(std::make_unique<JobQueue>());
+		}
+
+		// queue 0 belongs to the thread calling ParallelFor
+		m_Workers.reserve(threadCount - 1);
+		for (uint32_t i{ 1 }; i < threadCount; ++i)
+		{
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_Stop = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(uint32_t jobCount, const std::function<void(uint32_t)>& job)
+	{
+		if (jobCount == 0)
+			return;
+
+		// publish the job before any index becomes visible, a worker still stealing from the last call may pick one up right away
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_pJob = &job;
+			m_RemainingJobs = jobCount;
+		}
+
+		const uint32_t queueCount{ GetThreadCount() };
+		for (uint32_t queueIndex{}; queueIndex < queueCount; ++queueIndex)
+		{
+			const uint32_t first{ static_cast<uint32_t>(uint64_t(jobCount) * queueIndex / queueCount) };
+			const uint32_t last{ static_cast<uint32_t>(uint64_t(jobCount) * (queueIndex + 1) / queueCount) };
+
+			JobQueue& queue{ *m_Queues[queueIndex] };
+			std::lock_guard lock{ queue.mutex };
+			for (uint32_t jobIndex{ first }; jobIndex < last; ++jobIndex)
+			{
+				queue.jobs.push_back(jobIndex);
+			}
+		}
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		RunJobs(0);
+
+		std::unique_lock lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_RemainingJobs == 0; });
+		m_pJob = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t queueIndex)
+	{
+		uint64_t generation{};
+
+		while (true)
+		{
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [&] { return m_Stop || m_Generation != generation; });
+
+				if (m_Stop)
+					return;
+
+				generation = m_Generation;
+			}
+
+			RunJobs(queueIndex);
+		}
+	}
+
+	void ThreadPool::RunJobs(uint32_t queueIndex)
+	{
+		uint32_t jobIndex{};
+		while (PopJob(queueIndex, jobIndex) || StealJob(queueIndex, jobIndex))
+		{
+			(*m_pJob)(jobIndex);
+
+			if (m_RemainingJobs.fetch_sub(1) == 1)
+			{
+				std::lock_guard lock{ m_Mutex };
+				m_DoneCondition.notify_all();
+			}
+		}
+	}
+
+	bool ThreadPool::PopJob(uint32_t queueIndex, uint32_t& jobIndex)
+	{
+		JobQueue& queue{ *m_Queues[queueIndex] };
+		std::lock_guard lock{ queue.mutex };
+
+		if (queue.jobs.empty())
+			return false;
+
+		// the owner works front to back, in the order the jobs were handed out
+		jobIndex = queue.jobs.front();
+		queue.jobs.pop_front();
+		return true;
+	}
+
+	bool ThreadPool::StealJob(uint32_t queueIndex, uint32_t& jobIndex)
+	{
+		const uint32_t queueCount{ GetThreadCount() };
+		for (uint32_t offset{ 1 }; offset < queueCount; ++offset)
+		{
+			JobQueue& victim{ *m_Queues[(queueIndex + offset) % queueCount] };
+			std::lock_guard lock{ victim.mutex };
+
+			if (victim.jobs.empty())
+				continue;
+
+			// thieves take from the back, furthest away from what the owner is working on
+			jobIndex = victim.jobs.back();
+			victim.jobs.pop_back();
+			return true;
+		}
+		return false;
+	}
+}
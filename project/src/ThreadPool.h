@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	//Persistent pool of worker threads, every thread owns a job queue and steals from the others once its own runs dry
+	//The thread calling ParallelFor works along, so a pool of N threads starts N - 1 workers
+	class ThreadPool final
+	{
+	public:
+		//0 uses every hardware thread
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		//Calls job(index) for every index in [0, jobCount) and blocks until all of them are done
+		//Every queue starts with a contiguous range of indices, so neighbouring jobs stay on one thread until stolen
+		void ParallelFor(uint32_t jobCount, const std::function<void(uint32_t)>& job);
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Queues.size()); }
+
+	private:
+		struct JobQueue
+		{
+			std::mutex mutex{};
+			std::deque<uint32_t> jobs{};
+		};
+
+		std::vector<std::thread> m_Workers{};
+		std::vector<std::unique_ptr<JobQueue>> m_Queues{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+
+		const std::function<void(uint32_t)>* m_pJob{};
+		std::atomic<uint32_t> m_RemainingJobs{};
+		uint64_t m_Generation{};
+		bool m_Stop{ false };
+
+		void WorkerLoop(uint32_t queueIndex);
+		void RunJobs(uint32_t queueIndex);
+		bool PopJob(uint32_t queueIndex, uint32_t& jobIndex);
+		bool StealJob(uint32_t queueIndex, uint32_t& jobIndex);
+	};
+}
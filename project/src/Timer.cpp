@@ -24,6 +24,7 @@ void Timer::Reset()
 	m_StopTime = 0;
 	m_FPSTimer = 0.0f;
 	m_FPSCount = 0;
+	m_FixedStepCount = 0;
 	m_IsStopped = false;
 }
 
@@ -90,6 +91,13 @@ void Timer::Update()
 
 	m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
 
+	//Fixed steps make animated scenes deterministic, frame N always shows the same state
+	if (m_FixedTimeStep > 0.0f)
+	{
+		m_ElapsedTime = m_FixedTimeStep;
+		m_TotalTime = m_FixedTimeStep * static_cast<float>(++m_FixedStepCount);
+	}
+
 	//FPS LOGIC
 	m_FPSTimer += m_ElapsedTime;
 	++m_FPSCount;
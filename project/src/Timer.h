@@ -18,6 +18,8 @@ namespace dae
 		Timer& operator=(Timer&&) noexcept = delete;
 
 		void StartBenchmark(int numFrames = 10);
+		//Every Update advances exactly this many seconds instead of the measured time, 0 goes back to real time
+		void SetFixedTimeStep(float timeStep) { m_FixedTimeStep = timeStep; }
 
 		void Reset();
 		void Start();
@@ -46,6 +48,8 @@ namespace dae
 		float m_SecondsPerCount = 0.0f;
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
+		float m_FixedTimeStep = 0.0f;
+		uint64_t m_FixedStepCount = 0;
 
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
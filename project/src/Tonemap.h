@@ -0,0 +1,298 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ColorRGB.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	enum class Tonemapper
+	{
+		Clamp,		// colors brighter than 1 are scaled down until their brightest channel is 1, keeps the hue, the original look
+		Reinhard,	// c / (1 + c) per channel, nothing clips but everything gets darker
+		ACES		// Narkowicz's fit of the ACES filmic curve, a toe and a soft shoulder
+	};
+
+	inline const char* GetTonemapperName(Tonemapper tonemapper)
+	{
+		switch (tonemapper)
+		{
+		case Tonemapper::Reinhard: return "Reinhard";
+		case Tonemapper::ACES: return "ACES";
+		default: return "Clamp";
+		}
+	}
+
+	//"clamp", "reinhard" or "aces", anything else is Clamp
+	inline Tonemapper ParseTonemapper(const std::string& name)
+	{
+		if (name == "reinhard") return Tonemapper::Reinhard;
+		if (name == "aces") return Tonemapper::ACES;
+		return Tonemapper::Clamp;
+	}
+
+	//Where the 8 bit channels go in a 32 bit pixel, read from the surface format once instead of calling SDL_MapRGB per pixel
+	struct PixelPacking
+	{
+		uint32_t redShift{ 16 };
+		uint32_t greenShift{ 8 };
+		uint32_t blueShift{ 0 };
+		uint32_t alphaMask{}; //set in every pixel, opaque
+	};
+
+	namespace ColorUtils
+	{
+		// the kernels read colors as a flat float array
+		static_assert(sizeof(ColorRGB) == 3 * sizeof(float));
+
+		//Linear color of a framebuffer to the [0, 1] range of the display, negative and NaN channels become 0
+		//A template so the kernels loop over one tonemapper without a switch per pixel
+		template<Tonemapper tonemapper>
+		inline ColorRGB ApplyTonemapper(ColorRGB color)
+		{
+			// std::max(0.f, NaN) is 0, like _mm_max_ps(NaN, 0) in the SIMD kernels
+			color = { std::max(0.f, color.r), std::max(0.f, color.g), std::max(0.f, color.b) };
+
+			if constexpr (tonemapper == Tonemapper::Clamp)
+			{
+				color.MaxToOne();
+			}
+			else if constexpr (tonemapper == Tonemapper::Reinhard)
+			{
+				color = { color.r / (1.f + color.r), color.g / (1.f + color.g), color.b / (1.f + color.b) };
+			}
+			else
+			{
+				const auto aces = [](float x) { return (x * (2.51f * x + .03f)) / (x * (2.43f * x + .59f) + .14f); };
+				color = { aces(color.r), aces(color.g), aces(color.b) };
+			}
+
+			return { std::min(1.f, color.r), std::min(1.f, color.g), std::min(1.f, color.b) };
+		}
+
+		inline ColorRGB ApplyTonemapper(const ColorRGB& color, Tonemapper tonemapper)
+		{
+			switch (tonemapper)
+			{
+			case Tonemapper::Reinhard: return ApplyTonemapper<Tonemapper::Reinhard>(color);
+			case Tonemapper::ACES: return ApplyTonemapper<Tonemapper::ACES>(color);
+			default: return ApplyTonemapper<Tonemapper::Clamp>(color);
+			}
+		}
+
+		inline float EncodeSRGB(float linear)
+		{
+			return linear <= .0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.f / 2.4f) - .055f;
+		}
+
+		//The sRGB curve is looked up instead of evaluated, SRGBTableSize linear steps are finer than the 8 bit steps they map to
+		constexpr uint32_t SRGBTableSize{ 4096 };
+
+		//8 bit sRGB value of the linear value index / (SRGBTableSize - 1), 32 bit entries so AVX2 can gather them
+		inline const std::array<uint32_t, SRGBTableSize>& GetSRGBTable()
+		{
+			static const std::array<uint32_t, SRGBTableSize> table{ [] {
+				std::array<uint32_t, SRGBTableSize> values{};
+				for (uint32_t i{}; i < SRGBTableSize; ++i)
+				{
+					values[i] = static_cast<uint32_t>(EncodeSRGB(float(i) / float(SRGBTableSize - 1)) * 255.f + .5f);
+				}
+				return values;
+				}() };
+			return table;
+		}
+
+		//value in [0, 1], rounded to the nearest 8 bit step
+		inline uint32_t QuantizeChannel(float value, bool isSRGB)
+		{
+			if (isSRGB)
+				return GetSRGBTable()[static_cast<uint32_t>(value * float(SRGBTableSize - 1) + .5f)];
+			return static_cast<uint32_t>(value * 255.f + .5f);
+		}
+
+		template<Tonemapper tonemapper, bool isSRGB>
+		inline void TonemapPixels_Scalar(const ColorRGB* pColors, uint32_t* pPixels, size_t count, const PixelPacking& packing)
+		{
+			for (size_t i{}; i < count; ++i)
+			{
+				const ColorRGB color{ ApplyTonemapper<tonemapper>(pColors[i]) };
+				pPixels[i] = (QuantizeChannel(color.r, isSRGB) << packing.redShift)
+					| (QuantizeChannel(color.g, isSRGB) << packing.greenShift)
+					| (QuantizeChannel(color.b, isSRGB) << packing.blueShift)
+					| packing.alphaMask;
+			}
+		}
+
+		//Tonemaps count linear colors, encodes them and packs them into pixels
+		//Every kernel does the same float operations in the same order, so the pixels do not depend on the SIMD level
+		inline void TonemapPixels_Scalar(const ColorRGB* pColors, uint32_t* pPixels, size_t count, Tonemapper tonemapper, bool isSRGB, const PixelPacking& packing)
+		{
+			const auto tonemap = [&]<Tonemapper curve>() {
+				if (isSRGB)
+					TonemapPixels_Scalar<curve, true>(pColors, pPixels, count, packing);
+				else
+					TonemapPixels_Scalar<curve, false>(pColors, pPixels, count, packing);
+				};
+
+			switch (tonemapper)
+			{
+			case Tonemapper::Reinhard: tonemap.template operator()<Tonemapper::Reinhard>(); break;
+			case Tonemapper::ACES: tonemap.template operator()<Tonemapper::ACES>(); break;
+			default: tonemap.template operator()<Tonemapper::Clamp>(); break;
+			}
+		}
+
+#if defined(DAE_SIMD_SSE)
+		//Splits 4 consecutive ColorRGB (r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3) into a register per channel
+		inline void LoadColors_SSE(const ColorRGB* pColors, __m128& r, __m128& g, __m128& b)
+		{
+			const float* pFloats{ &pColors->r };
+			const __m128 x0{ _mm_loadu_ps(pFloats) };
+			const __m128 x1{ _mm_loadu_ps(pFloats + 4) };
+			const __m128 x2{ _mm_loadu_ps(pFloats + 8) };
+
+			r = _mm_shuffle_ps(x0, _mm_shuffle_ps(x1, x2, _MM_SHUFFLE(1, 0, 0, 2)), _MM_SHUFFLE(3, 0, 3, 0));
+			g = _mm_shuffle_ps(_mm_shuffle_ps(x0, x1, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(x1, x2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			b = _mm_shuffle_ps(_mm_shuffle_ps(x0, x1, _MM_SHUFFLE(1, 1, 2, 2)), x2, _MM_SHUFFLE(3, 0, 2, 0));
+		}
+
+		inline __m128 ApplyCurve_SSE(__m128 x, Tonemapper tonemapper)
+		{
+			const __m128 one{ _mm_set1_ps(1.f) };
+			if (tonemapper == Tonemapper::Reinhard)
+				return _mm_div_ps(x, _mm_add_ps(one, x));
+
+			const __m128 numerator{ _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), x), _mm_set1_ps(.03f))) };
+			const __m128 denominator{ _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), x), _mm_set1_ps(.59f))), _mm_set1_ps(.14f)) };
+			return _mm_div_ps(numerator, denominator);
+		}
+
+		inline __m128i QuantizeChannel_SSE(__m128 value, bool isSRGB)
+		{
+			if (!isSRGB)
+				return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.f)), _mm_set1_ps(.5f)));
+
+			// SSE has no gather
+			alignas(16) int32_t indices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices),
+				_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(float(SRGBTableSize - 1))), _mm_set1_ps(.5f))));
+			const auto& table{ GetSRGBTable() };
+			return _mm_setr_epi32(int(table[indices[0]]), int(table[indices[1]]), int(table[indices[2]]), int(table[indices[3]]));
+		}
+
+		inline void TonemapPixels_SSE(const ColorRGB* pColors, uint32_t* pPixels, size_t count, Tonemapper tonemapper, bool isSRGB, const PixelPacking& packing)
+		{
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128i redShift{ _mm_cvtsi32_si128(int(packing.redShift)) };
+			const __m128i greenShift{ _mm_cvtsi32_si128(int(packing.greenShift)) };
+			const __m128i blueShift{ _mm_cvtsi32_si128(int(packing.blueShift)) };
+			const __m128i alpha{ _mm_set1_epi32(int(packing.alphaMask)) };
+
+			size_t i{};
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 r{}, g{}, b{};
+				LoadColors_SSE(pColors + i, r, g, b);
+				r = _mm_max_ps(r, zero);
+				g = _mm_max_ps(g, zero);
+				b = _mm_max_ps(b, zero);
+
+				if (tonemapper == Tonemapper::Clamp)
+				{
+					// dividing by 1 leaves the colors that fit alone, like MaxToOne
+					const __m128 scale{ _mm_max_ps(_mm_max_ps(r, _mm_max_ps(g, b)), one) };
+					r = _mm_div_ps(r, scale);
+					g = _mm_div_ps(g, scale);
+					b = _mm_div_ps(b, scale);
+				}
+				else
+				{
+					r = ApplyCurve_SSE(r, tonemapper);
+					g = ApplyCurve_SSE(g, tonemapper);
+					b = ApplyCurve_SSE(b, tonemapper);
+				}
+
+				const __m128i pixels{ _mm_or_si128(
+					_mm_or_si128(_mm_sll_epi32(QuantizeChannel_SSE(_mm_min_ps(r, one), isSRGB), redShift),
+						_mm_sll_epi32(QuantizeChannel_SSE(_mm_min_ps(g, one), isSRGB), greenShift)),
+					_mm_or_si128(_mm_sll_epi32(QuantizeChannel_SSE(_mm_min_ps(b, one), isSRGB), blueShift), alpha)) };
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + i), pixels);
+			}
+
+			TonemapPixels_Scalar(pColors + i, pPixels + i, count - i, tonemapper, isSRGB, packing);
+		}
+#endif
+
+#if defined(DAE_SIMD_AVX2) || defined(DAE_SIMD_RUNTIME_DISPATCH)
+		DAE_TARGET_AVX2 inline __m256 ApplyCurve_AVX2(__m256 x, Tonemapper tonemapper)
+		{
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			if (tonemapper == Tonemapper::Reinhard)
+				return _mm256_div_ps(x, _mm256_add_ps(one, x));
+
+			const __m256 numerator{ _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.51f), x), _mm256_set1_ps(.03f))) };
+			const __m256 denominator{ _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.43f), x), _mm256_set1_ps(.59f))), _mm256_set1_ps(.14f)) };
+			return _mm256_div_ps(numerator, denominator);
+		}
+
+		DAE_TARGET_AVX2 inline __m256i QuantizeChannel_AVX2(__m256 value, bool isSRGB)
+		{
+			if (!isSRGB)
+				return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.f)), _mm256_set1_ps(.5f)));
+
+			const __m256i indices{ _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(float(SRGBTableSize - 1))), _mm256_set1_ps(.5f))) };
+			return _mm256_i32gather_epi32(reinterpret_cast<const int*>(GetSRGBTable().data()), indices, 4);
+		}
+
+		DAE_TARGET_AVX2 inline void TonemapPixels_AVX2(const ColorRGB* pColors, uint32_t* pPixels, size_t count, Tonemapper tonemapper, bool isSRGB, const PixelPacking& packing)
+		{
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			const __m128i redShift{ _mm_cvtsi32_si128(int(packing.redShift)) };
+			const __m128i greenShift{ _mm_cvtsi32_si128(int(packing.greenShift)) };
+			const __m128i blueShift{ _mm_cvtsi32_si128(int(packing.blueShift)) };
+			const __m256i alpha{ _mm256_set1_epi32(int(packing.alphaMask)) };
+
+			size_t i{};
+			for (; i + 8 <= count; i += 8)
+			{
+				// two SSE deinterleaves, crossing the 128 bit lanes costs more than it saves
+				__m128 lowR{}, lowG{}, lowB{}, highR{}, highG{}, highB{};
+				LoadColors_SSE(pColors + i, lowR, lowG, lowB);
+				LoadColors_SSE(pColors + i + 4, highR, highG, highB);
+				__m256 r{ _mm256_max_ps(_mm256_set_m128(highR, lowR), zero) };
+				__m256 g{ _mm256_max_ps(_mm256_set_m128(highG, lowG), zero) };
+				__m256 b{ _mm256_max_ps(_mm256_set_m128(highB, lowB), zero) };
+
+				if (tonemapper == Tonemapper::Clamp)
+				{
+					const __m256 scale{ _mm256_max_ps(_mm256_max_ps(r, _mm256_max_ps(g, b)), one) };
+					r = _mm256_div_ps(r, scale);
+					g = _mm256_div_ps(g, scale);
+					b = _mm256_div_ps(b, scale);
+				}
+				else
+				{
+					r = ApplyCurve_AVX2(r, tonemapper);
+					g = ApplyCurve_AVX2(g, tonemapper);
+					b = ApplyCurve_AVX2(b, tonemapper);
+				}
+
+				const __m256i pixels{ _mm256_or_si256(
+					_mm256_or_si256(_mm256_sll_epi32(QuantizeChannel_AVX2(_mm256_min_ps(r, one), isSRGB), redShift),
+						_mm256_sll_epi32(QuantizeChannel_AVX2(_mm256_min_ps(g, one), isSRGB), greenShift)),
+					_mm256_or_si256(_mm256_sll_epi32(QuantizeChannel_AVX2(_mm256_min_ps(b, one), isSRGB), blueShift), alpha)) };
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + i), pixels);
+			}
+
+			TonemapPixels_Scalar(pColors + i, pPixels + i, count - i, tonemapper, isSRGB, packing);
+		}
+#endif
+	}
+}
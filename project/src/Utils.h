@@ -1,7 +1,11 @@
 #pragma once
-#include <fstream>
 #include "Maths.h"
+#include "BRDFs.h"
 #include "DataTypes.h"
+#include "SIMD.h"
+#include "Tonemap.h"
+
+#include <bit>
 
 #include <iostream>
 
@@ -47,10 +51,22 @@ namespace dae
 			return false;
 		}
 
+		//Occlusion test, only tells whether the ray hits the sphere within [ray.min, ray.max]
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Sphere(sphere, ray, temp, true);
+			const Vector3 RayToSphere{ ray.origin - sphere.origin };
+
+			const float a{ Vector3::Dot(ray.direction, ray.direction) };
+			const float b{ 2.f * Vector3::Dot(ray.direction, RayToSphere) };
+			const float c{ Vector3::Dot(RayToSphere, RayToSphere) - Square(sphere.radius) };
+
+			const float discriminant{ Square(b) - 4.f * a * c };
+			if (discriminant <= 0) {
+				return false;
+			}
+
+			const float t = (-b - sqrt(discriminant)) / (2.f * a);
+			return t < ray.max && t > ray.min;
 		}
 #pragma endregion
 #pragma region Plane HitTest
@@ -78,27 +94,29 @@ namespace dae
 			return false;
 		}
 
+		//Occlusion test, only tells whether the ray hits the plane within [ray.min, ray.max]
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Plane(plane, ray, temp, true);
+			const float t{
+				(Vector3::Dot(plane.origin - ray.origin, plane.normal)) /
+				(Vector3::Dot(ray.direction, plane.normal)) };
+
+			return t < ray.max && t > ray.min;
 		}
 #pragma endregion
 #pragma region Triangle HitTest
 		//TRIANGLE HIT-TESTS
-		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		//Möller-Trumbore kernel, culling is decided by the given normal like the rest of the triangle tests
+		inline bool HitTest_Triangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Vector3& normal,
+			TriangleCullMode cullMode, const Ray& ray, float& t)
 		{
-			////todo W5
-			//throw std::runtime_error("Not Implemented Yet");
-			//return false;
+			const float dot{ Vector3::Dot(normal, ray.direction) };
 
-			const float dot{ Vector3::Dot(triangle.normal, ray.direction) };
-			
-			if (triangle.cullMode == TriangleCullMode::BackFaceCulling && dot > 0.f)
+			if (cullMode == TriangleCullMode::BackFaceCulling && dot > 0.f)
 			{
 				return false;
 			}
-			if (triangle.cullMode == TriangleCullMode::FrontFaceCulling && dot < 0.f)
+			if (cullMode == TriangleCullMode::FrontFaceCulling && dot < 0.f)
 			{
 				return false;
 			}
@@ -106,37 +124,59 @@ namespace dae
 			{
 				return false;
 			}
-			
-			const Vector3 L{triangle.v0 - ray.origin};
-			const float t{ Vector3::Dot(L, triangle.normal) / dot };
-			
-			if (t < ray.min || t > ray.max) {
+
+			const Vector3 edge1{ v1 - v0 };
+			const Vector3 edge2{ v2 - v0 };
+
+			const Vector3 p{ Vector3::Cross(ray.direction, edge2) };
+			const float determinant{ Vector3::Dot(edge1, p) };
+			if (determinant == 0.f)
+			{
 				return false;
 			}
-			
-			const Vector3 P{ ray.origin + ray.direction * t };
-			
-			const std::vector<Vector3> vertices = { {triangle.v0}, {triangle.v1}, {triangle.v2} };
 
-			for(uint16_t i{}; i < vertices.size(); ++i )
+			const float invDeterminant{ 1.f / determinant };
+
+			// barycentric coordinates of the intersection
+			const Vector3 s{ ray.origin - v0 };
+			const float u{ Vector3::Dot(s, p) * invDeterminant };
+			if (u < 0.f || u > 1.f)
 			{
-				Vector3 e{};
-				if (i < 2) {
-					e = vertices[i + 1] - vertices[i];
-				}
-				else {
-					e = vertices[0] - vertices[i];
-				}
-			
-				Vector3 p{ P - vertices[i] };
-			
-				if (Vector3::Dot(Vector3::Cross(e, p), triangle.normal) < 0.f) {
-					return false;
-				}
+				return false;
 			}
-			
+
+			const Vector3 q{ Vector3::Cross(s, edge1) };
+			const float v{ Vector3::Dot(ray.direction, q) * invDeterminant };
+			if (v < 0.f || u + v > 1.f)
+			{
+				return false;
+			}
+
+			const float distance{ Vector3::Dot(edge2, q) * invDeterminant };
+			if (distance < ray.min || distance > ray.max)
+			{
+				return false;
+			}
+
+			t = distance;
+			return true;
+		}
+
+		//Always fills hitRecord on a hit, callers compare its t; shadow rays use the overload without a HitRecord
+		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord)
+		{
+			////todo W5
+			//throw std::runtime_error("Not Implemented Yet");
+			//return false;
+
+			float t{};
+			if (!HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.normal, triangle.cullMode, ray, t))
+			{
+				return false;
+			}
+
 			hitRecord.t = t;
-			hitRecord.origin = P;
+			hitRecord.origin = ray.origin + ray.direction * t;
 			hitRecord.normal = triangle.normal;
 			hitRecord.didHit = true;
 			hitRecord.materialIndex = triangle.materialIndex;
@@ -144,10 +184,318 @@ namespace dae
 			return true;
 		}
 
+		//Occlusion test, only tells whether the ray hits the triangle within [ray.min, ray.max]
 		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Triangle(triangle, ray, temp, true);
+			float t{};
+			return HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.normal, triangle.cullMode, ray, t);
+		}
+#pragma endregion
+#pragma region TrianglePack HitTest
+		//All pack kernels test one ray against every lane of a pack. They return the closest lane that is hit
+		//before closestT (closestT is updated) or -1 when no lane is hit. Culling follows HitTest_Triangle.
+		inline int HitTest_TrianglePack_Scalar(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray, float& closestT)
+		{
+			int closestLane{ -1 };
+			for (uint32_t lane{}; lane < TrianglePack::Width; ++lane)
+			{
+				const Vector3 v0{ pack.v0x[lane], pack.v0y[lane], pack.v0z[lane] };
+				const Vector3 v1{ v0 + Vector3{ pack.edge1x[lane], pack.edge1y[lane], pack.edge1z[lane] } };
+				const Vector3 v2{ v0 + Vector3{ pack.edge2x[lane], pack.edge2y[lane], pack.edge2z[lane] } };
+				const Vector3 normal{ pack.normalx[lane], pack.normaly[lane], pack.normalz[lane] };
+
+				float t{};
+				if (HitTest_Triangle(v0, v1, v2, normal, cullMode, ray, t) && t < closestT)
+				{
+					closestT = t;
+					closestLane = static_cast<int>(lane);
+				}
+			}
+			return closestLane;
+		}
+
+		inline bool OcclusionTest_TrianglePack_Scalar(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray)
+		{
+			for (uint32_t lane{}; lane < TrianglePack::Width; ++lane)
+			{
+				const Vector3 v0{ pack.v0x[lane], pack.v0y[lane], pack.v0z[lane] };
+				const Vector3 v1{ v0 + Vector3{ pack.edge1x[lane], pack.edge1y[lane], pack.edge1z[lane] } };
+				const Vector3 v2{ v0 + Vector3{ pack.edge2x[lane], pack.edge2y[lane], pack.edge2z[lane] } };
+				const Vector3 normal{ pack.normalx[lane], pack.normaly[lane], pack.normalz[lane] };
+
+				float t{};
+				if (HitTest_Triangle(v0, v1, v2, normal, cullMode, ray, t))
+					return true;
+			}
+			return false;
+		}
+
+#if defined(DAE_SIMD_SSE)
+		//Lanes [offset, offset + 4) of the pack that are hit within [ray.min, ray.max] and before closestT, as a movemask
+		inline int HitTest_TrianglePackMask_SSE(const TrianglePack& pack, uint32_t offset, TriangleCullMode cullMode, const Ray& ray, float closestT, __m128& t)
+		{
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+
+			const __m128 directionX{ _mm_set1_ps(ray.direction.x) };
+			const __m128 directionY{ _mm_set1_ps(ray.direction.y) };
+			const __m128 directionZ{ _mm_set1_ps(ray.direction.z) };
+			const __m128 originX{ _mm_set1_ps(ray.origin.x) };
+			const __m128 originY{ _mm_set1_ps(ray.origin.y) };
+			const __m128 originZ{ _mm_set1_ps(ray.origin.z) };
+			const __m128 rayMin{ _mm_set1_ps(ray.min) };
+			const __m128 rayMax{ _mm_set1_ps(ray.max) };
+
+			const __m128 normalDot{ _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_load_ps(pack.normalx + offset), directionX),
+				_mm_mul_ps(_mm_load_ps(pack.normaly + offset), directionY)),
+				_mm_mul_ps(_mm_load_ps(pack.normalz + offset), directionZ)) };
+
+			__m128 valid{};
+			switch (cullMode)
+			{
+			case TriangleCullMode::BackFaceCulling:
+				valid = _mm_cmplt_ps(normalDot, zero);
+				break;
+			case TriangleCullMode::FrontFaceCulling:
+				valid = _mm_cmpgt_ps(normalDot, zero);
+				break;
+			default:
+				valid = _mm_cmpneq_ps(normalDot, zero);
+				break;
+			}
+
+			const __m128 edge1X{ _mm_load_ps(pack.edge1x + offset) };
+			const __m128 edge1Y{ _mm_load_ps(pack.edge1y + offset) };
+			const __m128 edge1Z{ _mm_load_ps(pack.edge1z + offset) };
+			const __m128 edge2X{ _mm_load_ps(pack.edge2x + offset) };
+			const __m128 edge2Y{ _mm_load_ps(pack.edge2y + offset) };
+			const __m128 edge2Z{ _mm_load_ps(pack.edge2z + offset) };
+
+			// p = direction x edge2
+			const __m128 pX{ _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y)) };
+			const __m128 pY{ _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z)) };
+			const __m128 pZ{ _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X)) };
+
+			const __m128 determinant{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ)) };
+			valid = _mm_and_ps(valid, _mm_cmpneq_ps(determinant, zero));
+
+			const __m128 invDeterminant{ _mm_div_ps(one, determinant) };
+
+			const __m128 sX{ _mm_sub_ps(originX, _mm_load_ps(pack.v0x + offset)) };
+			const __m128 sY{ _mm_sub_ps(originY, _mm_load_ps(pack.v0y + offset)) };
+			const __m128 sZ{ _mm_sub_ps(originZ, _mm_load_ps(pack.v0z + offset)) };
+
+			const __m128 u{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), invDeterminant) };
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+			// q = s x edge1
+			const __m128 qX{ _mm_sub_ps(_mm_mul_ps(sY, edge1Z), _mm_mul_ps(sZ, edge1Y)) };
+			const __m128 qY{ _mm_sub_ps(_mm_mul_ps(sZ, edge1X), _mm_mul_ps(sX, edge1Z)) };
+			const __m128 qZ{ _mm_sub_ps(_mm_mul_ps(sX, edge1Y), _mm_mul_ps(sY, edge1X)) };
+
+			const __m128 v{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), invDeterminant) };
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+			t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), invDeterminant);
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, rayMin), _mm_cmple_ps(t, rayMax)));
+			valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(closestT)));
+
+			return _mm_movemask_ps(valid);
+		}
+
+		inline int HitTest_TrianglePack_SSE(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray, float& closestT)
+		{
+			int closestLane{ -1 };
+			for (uint32_t offset{}; offset < TrianglePack::Width; offset += 4)
+			{
+				__m128 t{};
+				const int mask{ HitTest_TrianglePackMask_SSE(pack, offset, cullMode, ray, closestT, t) };
+				if (mask == 0)
+					continue;
+
+				alignas(16) float distances[4];
+				_mm_store_ps(distances, t);
+				for (int lane{}; lane < 4; ++lane)
+				{
+					if ((mask & (1 << lane)) && distances[lane] < closestT)
+					{
+						closestT = distances[lane];
+						closestLane = static_cast<int>(offset) + lane;
+					}
+				}
+			}
+			return closestLane;
+		}
+
+		inline bool OcclusionTest_TrianglePack_SSE(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray)
+		{
+			__m128 t{};
+			return HitTest_TrianglePackMask_SSE(pack, 0, cullMode, ray, ray.max, t) != 0
+				|| HitTest_TrianglePackMask_SSE(pack, 4, cullMode, ray, ray.max, t) != 0;
+		}
+#endif
+
+#if defined(DAE_SIMD_AVX2) || defined(DAE_SIMD_RUNTIME_DISPATCH)
+		//Lanes of the pack that are hit within [ray.min, ray.max] and before closestT, as a movemask
+		DAE_TARGET_AVX2 inline int HitTest_TrianglePackMask_AVX2(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray, float closestT, __m256& t)
+		{
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+
+			const __m256 directionX{ _mm256_set1_ps(ray.direction.x) };
+			const __m256 directionY{ _mm256_set1_ps(ray.direction.y) };
+			const __m256 directionZ{ _mm256_set1_ps(ray.direction.z) };
+
+			const __m256 normalDot{ _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(_mm256_load_ps(pack.normalx), directionX),
+				_mm256_mul_ps(_mm256_load_ps(pack.normaly), directionY)),
+				_mm256_mul_ps(_mm256_load_ps(pack.normalz), directionZ)) };
+
+			__m256 valid{};
+			switch (cullMode)
+			{
+			case TriangleCullMode::BackFaceCulling:
+				valid = _mm256_cmp_ps(normalDot, zero, _CMP_LT_OQ);
+				break;
+			case TriangleCullMode::FrontFaceCulling:
+				valid = _mm256_cmp_ps(normalDot, zero, _CMP_GT_OQ);
+				break;
+			default:
+				valid = _mm256_cmp_ps(normalDot, zero, _CMP_NEQ_UQ);
+				break;
+			}
+
+			const __m256 edge1X{ _mm256_load_ps(pack.edge1x) };
+			const __m256 edge1Y{ _mm256_load_ps(pack.edge1y) };
+			const __m256 edge1Z{ _mm256_load_ps(pack.edge1z) };
+			const __m256 edge2X{ _mm256_load_ps(pack.edge2x) };
+			const __m256 edge2Y{ _mm256_load_ps(pack.edge2y) };
+			const __m256 edge2Z{ _mm256_load_ps(pack.edge2z) };
+
+			// p = direction x edge2
+			const __m256 pX{ _mm256_sub_ps(_mm256_mul_ps(directionY, edge2Z), _mm256_mul_ps(directionZ, edge2Y)) };
+			const __m256 pY{ _mm256_sub_ps(_mm256_mul_ps(directionZ, edge2X), _mm256_mul_ps(directionX, edge2Z)) };
+			const __m256 pZ{ _mm256_sub_ps(_mm256_mul_ps(directionX, edge2Y), _mm256_mul_ps(directionY, edge2X)) };
+
+			const __m256 determinant{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge1X, pX), _mm256_mul_ps(edge1Y, pY)), _mm256_mul_ps(edge1Z, pZ)) };
+			valid = _mm256_and_ps(valid, _mm256_cmp_ps(determinant, zero, _CMP_NEQ_UQ));
+
+			const __m256 invDeterminant{ _mm256_div_ps(one, determinant) };
+
+			const __m256 sX{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(pack.v0x)) };
+			const __m256 sY{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(pack.v0y)) };
+			const __m256 sZ{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(pack.v0z)) };
+
+			const __m256 u{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sX, pX), _mm256_mul_ps(sY, pY)), _mm256_mul_ps(sZ, pZ)), invDeterminant) };
+			valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+			// q = s x edge1
+			const __m256 qX{ _mm256_sub_ps(_mm256_mul_ps(sY, edge1Z), _mm256_mul_ps(sZ, edge1Y)) };
+			const __m256 qY{ _mm256_sub_ps(_mm256_mul_ps(sZ, edge1X), _mm256_mul_ps(sX, edge1Z)) };
+			const __m256 qZ{ _mm256_sub_ps(_mm256_mul_ps(sX, edge1Y), _mm256_mul_ps(sY, edge1X)) };
+
+			const __m256 v{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(directionX, qX), _mm256_mul_ps(directionY, qY)), _mm256_mul_ps(directionZ, qZ)), invDeterminant) };
+			valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+			t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge2X, qX), _mm256_mul_ps(edge2Y, qY)), _mm256_mul_ps(edge2Z, qZ)), invDeterminant);
+			valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, _mm256_set1_ps(ray.min), _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(ray.max), _CMP_LE_OQ)));
+			valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(closestT), _CMP_LT_OQ));
+
+			return _mm256_movemask_ps(valid);
+		}
+
+		DAE_TARGET_AVX2 inline int HitTest_TrianglePack_AVX2(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray, float& closestT)
+		{
+			__m256 t{};
+			const int mask{ HitTest_TrianglePackMask_AVX2(pack, cullMode, ray, closestT, t) };
+			if (mask == 0)
+				return -1;
+
+			alignas(32) float distances[8];
+			_mm256_store_ps(distances, t);
+
+			int closestLane{ -1 };
+			for (int lane{}; lane < 8; ++lane)
+			{
+				if ((mask & (1 << lane)) && distances[lane] < closestT)
+				{
+					closestT = distances[lane];
+					closestLane = lane;
+				}
+			}
+			return closestLane;
+		}
+
+		DAE_TARGET_AVX2 inline bool OcclusionTest_TrianglePack_AVX2(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray)
+		{
+			__m256 t{};
+			return HitTest_TrianglePackMask_AVX2(pack, cullMode, ray, ray.max, t) != 0;
+		}
+#endif
+
+		//Pack and framebuffer kernels for one SIMD level, a baseline build picks the widest one the CPU supports once at startup
+		struct KernelTable
+		{
+			SIMDLevel level{ SIMDLevel::Scalar };
+			int (*hitTestTrianglePack)(const TrianglePack&, TriangleCullMode, const Ray&, float&) { HitTest_TrianglePack_Scalar };
+			bool (*occlusionTestTrianglePack)(const TrianglePack&, TriangleCullMode, const Ray&) { OcclusionTest_TrianglePack_Scalar };
+			void (*tonemapPixels)(const ColorRGB*, uint32_t*, size_t, Tonemapper, bool, const PixelPacking&) { ColorUtils::TonemapPixels_Scalar };
+			void (*cookTorrence)(const BRDF::CookTorrenceParameters*, const ShadingSample*, ColorRGB*, size_t) { BRDF::CookTorrence_Scalar };
+		};
+
+		//Kernels for the requested level, or the widest one below it this build and CPU can run
+		inline KernelTable CreateKernelTable(SIMDLevel level)
+		{
+			level = std::min(level, DetectSIMDLevel());
+
+			KernelTable table{};
+#if defined(DAE_SIMD_SSE)
+			if (level >= SIMDLevel::SSE)
+				table = { SIMDLevel::SSE, HitTest_TrianglePack_SSE, OcclusionTest_TrianglePack_SSE, ColorUtils::TonemapPixels_SSE, BRDF::CookTorrence_SSE };
+#endif
+#if defined(DAE_SIMD_AVX2) || defined(DAE_SIMD_RUNTIME_DISPATCH)
+			if (level >= SIMDLevel::AVX2)
+				table = { SIMDLevel::AVX2, HitTest_TrianglePack_AVX2, OcclusionTest_TrianglePack_AVX2, ColorUtils::TonemapPixels_AVX2, BRDF::CookTorrence_AVX2 };
+#endif
+			return table;
+		}
+
+		inline KernelTable& GetKernelTable()
+		{
+			static KernelTable table{ CreateKernelTable(DetectSIMDLevel()) };
+			return table;
+		}
+
+		//Forces a narrower path, for tests and benchmarks; not safe while rendering
+		//Levels the CPU lacks fall back to the widest one below, GetSIMDLevel tells which one is used
+		inline void SetSIMDLevel(SIMDLevel level)
+		{
+			GetKernelTable() = CreateKernelTable(level);
+		}
+
+		inline SIMDLevel GetSIMDLevel()
+		{
+			return GetKernelTable().level;
+		}
+
+		inline int HitTest_TrianglePack(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray, float& closestT)
+		{
+#if defined(DAE_SIMD_SSE)
+			return GetKernelTable().hitTestTrianglePack(pack, cullMode, ray, closestT);
+#else
+			return HitTest_TrianglePack_Scalar(pack, cullMode, ray, closestT);
+#endif
+		}
+
+		//True when any lane of the pack is hit within [ray.min, ray.max], without looking for the closest one
+		inline bool OcclusionTest_TrianglePack(const TrianglePack& pack, TriangleCullMode cullMode, const Ray& ray)
+		{
+#if defined(DAE_SIMD_SSE)
+			return GetKernelTable().occlusionTestTrianglePack(pack, cullMode, ray);
+#else
+			return OcclusionTest_TrianglePack_Scalar(pack, cullMode, ray);
+#endif
 		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
@@ -173,43 +521,618 @@ namespace dae
 			return tmax > 0 && tmax >= tmin;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		//Returns the distance at which the ray enters the node, FLT_MAX on a miss
+		inline float SlabTest_BVHNode(const BVHNode& node, const Ray& ray, const Vector3& invDirection, float tMax)
+		{
+			const float tx1 = (node.minAABB.x - ray.origin.x) * invDirection.x;
+			const float tx2 = (node.maxAABB.x - ray.origin.x) * invDirection.x;
+
+			float tmin = std::min(tx1, tx2);
+			float tmax = std::max(tx1, tx2);
+
+			const float ty1 = (node.minAABB.y - ray.origin.y) * invDirection.y;
+			const float ty2 = (node.maxAABB.y - ray.origin.y) * invDirection.y;
+
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			const float tz1 = (node.minAABB.z - ray.origin.z) * invDirection.z;
+			const float tz2 = (node.maxAABB.z - ray.origin.z) * invDirection.z;
+
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
+
+			if (tmax >= tmin && tmax > ray.min && tmin < tMax)
+				return tmin;
+
+			return FLT_MAX;
+		}
+
+		//Traverses the mesh BVH and its triangle packs from the given node, closestT and closestTriangle are only written on a closer hit
+		//anyHit stops at the first triangle closer than closestT without writing either, that is all shadow queries need
+		inline bool TraverseTriangleMeshBVH(const TriangleMesh& mesh, const Ray& ray, const Vector3& invDirection, uint32_t startNodeIndex,
+			float& closestT, uint32_t& closestTriangle, bool anyHit)
+		{
+			const std::vector<BVHNode>& nodes{ mesh.bvh.GetNodes() };
+
+			// slabtest of the start node, for the root this replaces the slabtest against the mesh AABB
+			if (SlabTest_BVHNode(nodes[startNodeIndex], ray, invDirection, closestT) == FLT_MAX) {
+				return false;
+			}
+
+			bool didHit{ false };
+
+			uint32_t stack[BVH::MaxDepth];
+			uint32_t stackSize{};
+			uint32_t nodeIndex{ startNodeIndex };
+
+			while (true)
+			{
+				const BVHNode& node{ nodes[nodeIndex] };
+
+				if (node.IsLeaf())
+				{
+					const uint32_t packCount{ (node.primitiveCount + TrianglePack::Width - 1) / TrianglePack::Width };
+					const TrianglePack* pPacks{ &mesh.trianglePacks[mesh.leafPackOffsets[nodeIndex]] };
+
+					for (uint32_t i{}; i < packCount; ++i)
+					{
+						if (anyHit) {
+							if (OcclusionTest_TrianglePack(pPacks[i], mesh.cullMode, ray)) {
+								return true;
+							}
+							continue;
+						}
+
+						const int lane{ HitTest_TrianglePack(pPacks[i], mesh.cullMode, ray, closestT) };
+						if (lane >= 0)
+						{
+							closestTriangle = pPacks[i].triangleIndex[lane];
+							didHit = true;
+						}
+					}
+
+					if (stackSize == 0) {
+						break;
+					}
+					nodeIndex = stack[--stackSize];
+					continue;
+				}
+
+				// visit the nearest child first, push the other one
+				uint32_t nearIndex{ node.leftFirst };
+				uint32_t farIndex{ node.leftFirst + 1 };
+
+				float nearDistance{ SlabTest_BVHNode(nodes[nearIndex], ray, invDirection, closestT) };
+				float farDistance{ SlabTest_BVHNode(nodes[farIndex], ray, invDirection, closestT) };
+
+				if (farDistance < nearDistance) {
+					std::swap(nearIndex, farIndex);
+					std::swap(nearDistance, farDistance);
+				}
+
+				if (nearDistance == FLT_MAX) {
+					if (stackSize == 0) {
+						break;
+					}
+					nodeIndex = stack[--stackSize];
+					continue;
+				}
+
+				nodeIndex = nearIndex;
+				if (farDistance != FLT_MAX) {
+					stack[stackSize++] = farIndex;
+				}
+			}
+
+			return didHit;
+		}
+
+		//Normals have to be the ones the triangle packs were built with
+		//Always looks for the closest triangle, shadow rays use OcclusionTest_TriangleMeshBVH
+		inline bool HitTest_TriangleMeshBVH(const TriangleMesh& mesh, const std::vector<Vector3>& normals,
+			const Ray& ray, HitRecord& hitRecord)
+		{
+			if (mesh.bvh.IsEmpty()) {
+				return false;
+			}
+
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+			// only the closest triangle gets a full hit record, once traversal is done
+			float closestT{ std::min(ray.max, hitRecord.t) };
+			uint32_t closestTriangle{ UINT32_MAX };
+
+			if (!TraverseTriangleMeshBVH(mesh, ray, invDirection, 0, closestT, closestTriangle, false)) {
+				return false;
+			}
+
+			hitRecord.t = closestT;
+			hitRecord.origin = ray.origin + ray.direction * closestT;
+			hitRecord.normal = normals[closestTriangle];
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = mesh.materialIndex;
+
+			return true;
+		}
+
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord)
 		{
 			//todo W5
 			//throw std::runtime_error("Not Implemented Yet");
 
-			// slabtest
-			if (!SlabTest_TriangleMesh(mesh, ray)) {
+			return HitTest_TriangleMeshBVH(mesh, mesh.transformedNormals, ray, hitRecord);
+		}
+
+		//Occlusion test against the BVH, stops at the first triangle hit within [ray.min, ray.max]
+		inline bool OcclusionTest_TriangleMeshBVH(const TriangleMesh& mesh, const Ray& ray)
+		{
+			if (mesh.bvh.IsEmpty()) {
 				return false;
 			}
 
-			Triangle triangle{};
-			triangle.cullMode = mesh.cullMode;
-			for (size_t i{}; i < mesh.indices.size(); i += 3)
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+			float closestT{ ray.max };
+			uint32_t closestTriangle{ UINT32_MAX };
+			return TraverseTriangleMeshBVH(mesh, ray, invDirection, 0, closestT, closestTriangle, true);
+		}
+
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+		{
+			return OcclusionTest_TriangleMeshBVH(mesh, ray);
+		}
+#pragma endregion
+#pragma region TriangleMeshInstance HitTest
+		inline bool HitTest_TriangleMeshInstance(const TriangleMeshInstance& instance, const Ray& ray, HitRecord& hitRecord)
+		{
+			// The direction is deliberately not normalized, that way t is the same in object and world space
+			Ray objectRay{ ray };
+			objectRay.origin = instance.worldToObject.TransformPoint(ray.origin);
+			objectRay.direction = instance.worldToObject.TransformVector(ray.direction);
+
+			HitRecord objectHit{};
+			objectHit.t = hitRecord.t;
+
+			const TriangleMesh& mesh{ *instance.pMesh };
+			if (!HitTest_TriangleMeshBVH(mesh, mesh.normals, objectRay, objectHit)) {
+				return false;
+			}
+
+			hitRecord.t = objectHit.t;
+			hitRecord.origin = ray.origin + ray.direction * objectHit.t;
+			hitRecord.normal = instance.TransformNormal(objectHit.normal);
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = instance.materialIndex;
+
+			return true;
+		}
+
+		inline bool HitTest_TriangleMeshInstance(const TriangleMeshInstance& instance, const Ray& ray)
+		{
+			Ray objectRay{ ray };
+			objectRay.origin = instance.worldToObject.TransformPoint(ray.origin);
+			objectRay.direction = instance.worldToObject.TransformVector(ray.direction);
+
+			return OcclusionTest_TriangleMeshBVH(*instance.pMesh, objectRay);
+		}
+#pragma endregion
+#pragma region RayPacket HitTest
+		//Packet kernels only look at the lanes in activeMask and return the mask of lanes that got a closer hit,
+		//hit.t and hit.records are updated for exactly those lanes
+
+		//True when the box lies completely outside one of the packet frustum planes, no ray of the packet can hit it
+		inline bool FrustumCull_AABB(const RayPacket& packet, const Vector3& minAABB, const Vector3& maxAABB)
+		{
+			for (const Vector3& normal : packet.frustumNormals)
+			{
+				// the corner furthest along the normal, if even that one is behind the plane the whole box is
+				const Vector3 corner{
+					normal.x >= 0.f ? maxAABB.x : minAABB.x,
+					normal.y >= 0.f ? maxAABB.y : minAABB.y,
+					normal.z >= 0.f ? maxAABB.z : minAABB.z };
+
+				if (Vector3::Dot(normal, corner - packet.origin) < 0.f) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//Returns the lanes that enter the node before closestT, nearestEntry is the smallest entry distance of those lanes
+		inline uint32_t SlabTest_BVHNodePacket(const BVHNode& node, const RayPacket& packet, const float* closestT, uint32_t activeMask, float& nearestEntry)
+		{
+			nearestEntry = FLT_MAX;
+
+			if (FrustumCull_AABB(packet, node.minAABB, node.maxAABB)) {
+				return 0;
+			}
+
+			uint32_t hitMask{};
+
+#if defined(DAE_SIMD_SSE)
+			const __m128 minX{ _mm_set1_ps(node.minAABB.x - packet.origin.x) };
+			const __m128 minY{ _mm_set1_ps(node.minAABB.y - packet.origin.y) };
+			const __m128 minZ{ _mm_set1_ps(node.minAABB.z - packet.origin.z) };
+			const __m128 maxX{ _mm_set1_ps(node.maxAABB.x - packet.origin.x) };
+			const __m128 maxY{ _mm_set1_ps(node.maxAABB.y - packet.origin.y) };
+			const __m128 maxZ{ _mm_set1_ps(node.maxAABB.z - packet.origin.z) };
+			const __m128 rayMin{ _mm_set1_ps(packet.min) };
+			const __m128 rayMax{ _mm_set1_ps(packet.max) };
+			const __m128 noEntry{ _mm_set1_ps(FLT_MAX) };
+
+			__m128 entry{ noEntry };
+
+			for (uint32_t offset{}; offset < RayPacket::Width; offset += 4)
+			{
+				if (((activeMask >> offset) & 0xF) == 0)
+					continue;
+
+				const __m128 invX{ _mm_load_ps(packet.invDirectionX + offset) };
+				const __m128 invY{ _mm_load_ps(packet.invDirectionY + offset) };
+				const __m128 invZ{ _mm_load_ps(packet.invDirectionZ + offset) };
+
+				// operand order mirrors std::min/std::max in SlabTest_BVHNode so both agree on NaN lanes
+				const __m128 tx1{ _mm_mul_ps(minX, invX) };
+				const __m128 tx2{ _mm_mul_ps(maxX, invX) };
+				__m128 tmin{ _mm_min_ps(tx2, tx1) };
+				__m128 tmax{ _mm_max_ps(tx2, tx1) };
+
+				const __m128 ty1{ _mm_mul_ps(minY, invY) };
+				const __m128 ty2{ _mm_mul_ps(maxY, invY) };
+				tmin = _mm_max_ps(_mm_min_ps(ty2, ty1), tmin);
+				tmax = _mm_min_ps(_mm_max_ps(ty2, ty1), tmax);
+
+				const __m128 tz1{ _mm_mul_ps(minZ, invZ) };
+				const __m128 tz2{ _mm_mul_ps(maxZ, invZ) };
+				tmin = _mm_max_ps(_mm_min_ps(tz2, tz1), tmin);
+				tmax = _mm_min_ps(_mm_max_ps(tz2, tz1), tmax);
+
+				const __m128 tClosest{ _mm_min_ps(_mm_load_ps(closestT + offset), rayMax) };
+				const __m128 valid{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(tmax, tmin), _mm_cmpgt_ps(tmax, rayMin)), _mm_cmplt_ps(tmin, tClosest)) };
+
+				const uint32_t groupMask{ static_cast<uint32_t>(_mm_movemask_ps(valid)) & ((activeMask >> offset) & 0xF) };
+				if (groupMask == 0)
+					continue;
+
+				hitMask |= groupMask << offset;
+
+				const __m128 laneMask{ _mm_castsi128_ps(_mm_cmpgt_epi32(
+					_mm_and_si128(_mm_set1_epi32(static_cast<int>(groupMask)), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128())) };
+				entry = _mm_min_ps(entry, _mm_or_ps(_mm_and_ps(laneMask, tmin), _mm_andnot_ps(laneMask, noEntry)));
+			}
+
+			entry = _mm_min_ps(entry, _mm_shuffle_ps(entry, entry, _MM_SHUFFLE(2, 3, 0, 1)));
+			entry = _mm_min_ps(entry, _mm_shuffle_ps(entry, entry, _MM_SHUFFLE(1, 0, 3, 2)));
+			nearestEntry = _mm_cvtss_f32(entry);
+#else
+			for (uint32_t mask{ activeMask }; mask != 0; mask &= mask - 1)
 			{
-				HitRecord hitRec{};
-				triangle.v0 = mesh.transformedPositions[mesh.indices[i]];
-				triangle.v1 = mesh.transformedPositions[mesh.indices[i + 1]];
-				triangle.v2 = mesh.transformedPositions[mesh.indices[i + 2]];
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+				const Vector3 invDirection{ packet.invDirectionX[lane], packet.invDirectionY[lane], packet.invDirectionZ[lane] };
 
-				triangle.normal = mesh.transformedNormals[i / 3];
-				if (HitTest_Triangle(triangle, ray, hitRec, ignoreHitRecord))
+				const float entry{ SlabTest_BVHNode(node, packet.GetRay(lane), invDirection, std::min(packet.max, closestT[lane])) };
+				if (entry != FLT_MAX)
 				{
-					if (hitRec.t < hitRecord.t)
+					hitMask |= 1u << lane;
+					nearestEntry = std::min(nearestEntry, entry);
+				}
+			}
+#endif
+
+			return hitMask;
+		}
+
+		inline uint32_t HitTest_SpherePacket(const Sphere& sphere, const RayPacket& packet, uint32_t activeMask, RayPacketHit& hit)
+		{
+			// every lane shares the origin, so c is the same for the whole packet
+			const Vector3 rayToSphere{ packet.origin - sphere.origin };
+			const float c{ Vector3::Dot(rayToSphere, rayToSphere) - pow(sphere.radius, 2.f) };
+
+			uint32_t hitMask{};
+
+#if defined(DAE_SIMD_SSE)
+			const __m128 toSphereX{ _mm_set1_ps(rayToSphere.x) };
+			const __m128 toSphereY{ _mm_set1_ps(rayToSphere.y) };
+			const __m128 toSphereZ{ _mm_set1_ps(rayToSphere.z) };
+			const __m128 cVector{ _mm_set1_ps(c) };
+			const __m128 rayMin{ _mm_set1_ps(packet.min) };
+			const __m128 rayMax{ _mm_set1_ps(packet.max) };
+
+			alignas(16) float distances[RayPacket::Width];
+
+			for (uint32_t offset{}; offset < RayPacket::Width; offset += 4)
+			{
+				if (((activeMask >> offset) & 0xF) == 0)
+					continue;
+
+				const __m128 directionX{ _mm_load_ps(packet.directionX + offset) };
+				const __m128 directionY{ _mm_load_ps(packet.directionY + offset) };
+				const __m128 directionZ{ _mm_load_ps(packet.directionZ + offset) };
+
+				const __m128 a{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, directionX), _mm_mul_ps(directionY, directionY)), _mm_mul_ps(directionZ, directionZ)) };
+				const __m128 b{ _mm_mul_ps(_mm_set1_ps(2.f),
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, toSphereX), _mm_mul_ps(directionY, toSphereY)), _mm_mul_ps(directionZ, toSphereZ))) };
+
+				const __m128 discriminant{ _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.f), a), cVector)) };
+
+				const __m128 t{ _mm_div_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), b), _mm_sqrt_ps(discriminant)), _mm_mul_ps(_mm_set1_ps(2.f), a)) };
+
+				__m128 valid{ _mm_cmpgt_ps(discriminant, _mm_setzero_ps()) };
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmplt_ps(t, rayMax), _mm_cmpgt_ps(t, rayMin)));
+				valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_load_ps(hit.t + offset)));
+
+				hitMask |= (static_cast<uint32_t>(_mm_movemask_ps(valid)) & ((activeMask >> offset) & 0xF)) << offset;
+				_mm_store_ps(distances + offset, t);
+			}
+#else
+			float distances[RayPacket::Width]{};
+
+			for (uint32_t mask{ activeMask }; mask != 0; mask &= mask - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+				const Vector3 direction{ packet.GetDirection(lane) };
+
+				const float a{ Vector3::Dot(direction, direction) };
+				const float b{ 2.f * Vector3::Dot(direction, rayToSphere) };
+				const float discriminant{ Square(b) - 4.f * a * c };
+				if (discriminant <= 0)
+					continue;
+
+				const float t{ (-b - sqrt(discriminant)) / (2.f * a) };
+				if (t < packet.max && t > packet.min && t < hit.t[lane])
+				{
+					distances[lane] = t;
+					hitMask |= 1u << lane;
+				}
+			}
+#endif
+
+			for (uint32_t mask{ hitMask }; mask != 0; mask &= mask - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+				HitRecord& hitRecord{ hit.records[lane] };
+
+				hit.t[lane] = distances[lane];
+				hitRecord.t = distances[lane];
+				hitRecord.origin = packet.origin + packet.GetDirection(lane) * distances[lane];
+				hitRecord.normal = (hitRecord.origin - sphere.origin) / sphere.radius;
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = sphere.materialIndex;
+			}
+
+			return hitMask;
+		}
+
+		inline uint32_t HitTest_PlanePacket(const Plane& plane, const RayPacket& packet, uint32_t activeMask, RayPacketHit& hit)
+		{
+			// the numerator only depends on the shared origin
+			const float numerator{ Vector3::Dot(plane.origin - packet.origin, plane.normal) };
+
+			uint32_t hitMask{};
+
+#if defined(DAE_SIMD_SSE)
+			const __m128 normalX{ _mm_set1_ps(plane.normal.x) };
+			const __m128 normalY{ _mm_set1_ps(plane.normal.y) };
+			const __m128 normalZ{ _mm_set1_ps(plane.normal.z) };
+			const __m128 numeratorVector{ _mm_set1_ps(numerator) };
+			const __m128 rayMin{ _mm_set1_ps(packet.min) };
+			const __m128 rayMax{ _mm_set1_ps(packet.max) };
+
+			alignas(16) float distances[RayPacket::Width];
+
+			for (uint32_t offset{}; offset < RayPacket::Width; offset += 4)
+			{
+				if (((activeMask >> offset) & 0xF) == 0)
+					continue;
+
+				const __m128 denominator{ _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_load_ps(packet.directionX + offset), normalX),
+					_mm_mul_ps(_mm_load_ps(packet.directionY + offset), normalY)),
+					_mm_mul_ps(_mm_load_ps(packet.directionZ + offset), normalZ)) };
+
+				const __m128 t{ _mm_div_ps(numeratorVector, denominator) };
+
+				__m128 valid{ _mm_and_ps(_mm_cmplt_ps(t, rayMax), _mm_cmpgt_ps(t, rayMin)) };
+				valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_load_ps(hit.t + offset)));
+
+				hitMask |= (static_cast<uint32_t>(_mm_movemask_ps(valid)) & ((activeMask >> offset) & 0xF)) << offset;
+				_mm_store_ps(distances + offset, t);
+			}
+#else
+			float distances[RayPacket::Width]{};
+
+			for (uint32_t mask{ activeMask }; mask != 0; mask &= mask - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+
+				const float t{ numerator / Vector3::Dot(packet.GetDirection(lane), plane.normal) };
+				if (t < packet.max && t > packet.min && t < hit.t[lane])
+				{
+					distances[lane] = t;
+					hitMask |= 1u << lane;
+				}
+			}
+#endif
+
+			for (uint32_t mask{ hitMask }; mask != 0; mask &= mask - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+				HitRecord& hitRecord{ hit.records[lane] };
+
+				hit.t[lane] = distances[lane];
+				hitRecord.t = distances[lane];
+				hitRecord.origin = packet.origin + packet.GetDirection(lane) * distances[lane];
+				hitRecord.normal = plane.normal;
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = plane.materialIndex;
+			}
+
+			return hitMask;
+		}
+
+		//Traverses the mesh BVH with the whole packet, a subtree that only one lane still enters is finished with single ray traversal
+		//Normals have to be the ones the triangle packs were built with
+		inline uint32_t HitTest_TriangleMeshBVHPacket(const TriangleMesh& mesh, const std::vector<Vector3>& normals,
+			const RayPacket& packet, uint32_t activeMask, RayPacketHit& hit)
+		{
+			const std::vector<BVHNode>& nodes{ mesh.bvh.GetNodes() };
+			if (nodes.empty()) {
+				return 0;
+			}
+
+			alignas(16) float closestT[RayPacket::Width];
+			uint32_t closestTriangle[RayPacket::Width];
+			for (uint32_t lane{}; lane < RayPacket::Width; ++lane)
+			{
+				closestT[lane] = std::min(packet.max, hit.t[lane]);
+				closestTriangle[lane] = UINT32_MAX;
+			}
+
+			float entry{};
+			uint32_t mask{ SlabTest_BVHNodePacket(nodes[0], packet, closestT, activeMask, entry) };
+			if (mask == 0) {
+				return 0;
+			}
+
+			struct StackEntry
+			{
+				uint32_t nodeIndex{};
+				uint32_t mask{};
+			};
+
+			StackEntry stack[BVH::MaxDepth];
+			uint32_t stackSize{};
+			uint32_t nodeIndex{};
+			uint32_t hitMask{};
+
+			while (true)
+			{
+				const BVHNode& node{ nodes[nodeIndex] };
+
+				if (node.IsLeaf() || std::popcount(mask) == 1)
+				{
+					for (uint32_t laneMask{ mask }; laneMask != 0; laneMask &= laneMask - 1)
 					{
-						hitRecord = hitRec;
-						hitRecord.materialIndex = mesh.materialIndex;
-						return true;
+						const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(laneMask)) };
+						const Ray ray{ packet.GetRay(lane) };
+
+						if (!node.IsLeaf())
+						{
+							const Vector3 invDirection{ packet.invDirectionX[lane], packet.invDirectionY[lane], packet.invDirectionZ[lane] };
+							if (TraverseTriangleMeshBVH(mesh, ray, invDirection, nodeIndex, closestT[lane], closestTriangle[lane], false)) {
+								hitMask |= 1u << lane;
+							}
+							continue;
+						}
+
+						const uint32_t packCount{ (node.primitiveCount + TrianglePack::Width - 1) / TrianglePack::Width };
+						const TrianglePack* pPacks{ &mesh.trianglePacks[mesh.leafPackOffsets[nodeIndex]] };
+
+						for (uint32_t i{}; i < packCount; ++i)
+						{
+							const int triangleLane{ HitTest_TrianglePack(pPacks[i], mesh.cullMode, ray, closestT[lane]) };
+							if (triangleLane >= 0)
+							{
+								closestTriangle[lane] = pPacks[i].triangleIndex[triangleLane];
+								hitMask |= 1u << lane;
+							}
+						}
+					}
+
+					if (stackSize == 0) {
+						break;
+					}
+					--stackSize;
+					nodeIndex = stack[stackSize].nodeIndex;
+					mask = stack[stackSize].mask;
+					continue;
+				}
+
+				// visit the child the packet enters first, push the other one
+				uint32_t nearIndex{ node.leftFirst };
+				uint32_t farIndex{ node.leftFirst + 1 };
+
+				float nearDistance{}, farDistance{};
+				uint32_t nearMask{ SlabTest_BVHNodePacket(nodes[nearIndex], packet, closestT, mask, nearDistance) };
+				uint32_t farMask{ SlabTest_BVHNodePacket(nodes[farIndex], packet, closestT, mask, farDistance) };
+
+				if (farDistance < nearDistance) {
+					std::swap(nearIndex, farIndex);
+					std::swap(nearMask, farMask);
+				}
+
+				if (nearMask == 0) {
+					if (stackSize == 0) {
+						break;
 					}
+					--stackSize;
+					nodeIndex = stack[stackSize].nodeIndex;
+					mask = stack[stackSize].mask;
+					continue;
+				}
+
+				nodeIndex = nearIndex;
+				mask = nearMask;
+				if (farMask != 0) {
+					stack[stackSize++] = { farIndex, farMask };
 				}
 			}
-			return false;
+
+			for (uint32_t laneMask{ hitMask }; laneMask != 0; laneMask &= laneMask - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(laneMask)) };
+				HitRecord& hitRecord{ hit.records[lane] };
+
+				hit.t[lane] = closestT[lane];
+				hitRecord.t = closestT[lane];
+				hitRecord.origin = packet.origin + packet.GetDirection(lane) * closestT[lane];
+				hitRecord.normal = normals[closestTriangle[lane]];
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = mesh.materialIndex;
+			}
+
+			return hitMask;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+		inline uint32_t HitTest_TriangleMeshPacket(const TriangleMesh& mesh, const RayPacket& packet, uint32_t activeMask, RayPacketHit& hit)
 		{
-			HitRecord temp{};
-			return HitTest_TriangleMesh(mesh, ray, temp, true);
+			return HitTest_TriangleMeshBVHPacket(mesh, mesh.transformedNormals, packet, activeMask, hit);
+		}
+
+		inline uint32_t HitTest_TriangleMeshInstancePacket(const TriangleMeshInstance& instance, const RayPacket& packet, uint32_t activeMask, RayPacketHit& hit)
+		{
+			// same as the single ray version, directions stay unnormalized so t is shared between both spaces
+			RayPacket objectPacket{};
+			objectPacket.origin = instance.worldToObject.TransformPoint(packet.origin);
+			objectPacket.min = packet.min;
+			objectPacket.max = packet.max;
+
+			for (uint32_t lane{}; lane < RayPacket::Width; ++lane) {
+				objectPacket.SetDirection(lane, instance.worldToObject.TransformVector(packet.GetDirection(lane)));
+			}
+			objectPacket.Finalize();
+
+			RayPacketHit objectHit{};
+			std::copy(std::begin(hit.t), std::end(hit.t), std::begin(objectHit.t));
+
+			const TriangleMesh& mesh{ *instance.pMesh };
+			const uint32_t hitMask{ HitTest_TriangleMeshBVHPacket(mesh, mesh.normals, objectPacket, activeMask, objectHit) };
+
+			for (uint32_t mask{ hitMask }; mask != 0; mask &= mask - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(mask)) };
+				HitRecord& hitRecord{ hit.records[lane] };
+
+				hit.t[lane] = objectHit.t[lane];
+				hitRecord.t = objectHit.t[lane];
+				hitRecord.origin = packet.origin + packet.GetDirection(lane) * objectHit.t[lane];
+				hitRecord.normal = instance.TransformNormal(objectHit.records[lane].normal);
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = instance.materialIndex;
+			}
+
+			return hitMask;
 		}
 #pragma endregion
 	}
@@ -259,78 +1182,29 @@ namespace dae
 		}
 	}
 
-	namespace Utils
+	namespace ColorUtils
 	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+		//Picks the kernel through GeometryUtils::GetKernelTable, like the triangle pack tests
+		inline void TonemapPixels(const ColorRGB* pColors, uint32_t* pPixels, size_t count, Tonemapper tonemapper, bool isSRGB, const PixelPacking& packing)
 		{
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof())
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if (std::isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (std::isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
-			}
+#if defined(DAE_SIMD_SSE)
+			GeometryUtils::GetKernelTable().tonemapPixels(pColors, pPixels, count, tonemapper, isSRGB, packing);
+#else
+			TonemapPixels_Scalar(pColors, pPixels, count, tonemapper, isSRGB, packing);
+#endif
+		}
+	}
 
-			return true;
+	namespace BRDF
+	{
+		//Shades count samples of Cook-Torrance materials with the kernel of GeometryUtils::GetKernelTable
+		inline void CookTorrence(const CookTorrenceParameters* pMaterials, const ShadingSample* pSamples, ColorRGB* pColors, size_t count)
+		{
+#if defined(DAE_SIMD_SSE)
+			GeometryUtils::GetKernelTable().cookTorrence(pMaterials, pSamples, pColors, count);
+#else
+			CookTorrence_Scalar(pMaterials, pSamples, pColors, count);
+#endif
 		}
-#pragma warning(pop)
 	}
 }
\ No newline at end of file
@@ -1,5 +1,12 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
+#include "MathHelpers.h"
+
+//Header only, so every operator can be inlined into the hot loops
+//Vector3 stays three packed floats, meshes, packs and rays all rely on that layout, so it is plain scalar code the compiler vectorizes where it pays off
 namespace dae
 {
 	struct Vector4;
@@ -10,23 +17,89 @@ namespace dae
 		float z{};
 
 		Vector3() = default;
-		Vector3(float _x, float _y, float _z);
-		Vector3(const Vector3& from, const Vector3& to);
+		Vector3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+		Vector3(const Vector3& from, const Vector3& to) : x(to.x - from.x), y(to.y - from.y), z(to.z - from.z) {}
 		Vector3(const Vector4& v);
 
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector3 Normalized() const;
+		float Magnitude() const
+		{
+			return std::sqrt(x * x + y * y + z * z);
+		}
+
+		float SqrMagnitude() const
+		{
+			return x * x + y * y + z * z;
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			x /= m;
+			y /= m;
+			z /= m;
+
+			return m;
+		}
+
+		Vector3 Normalized() const
+		{
+			const float m = Magnitude();
+			return { x / m, y / m, z / m };
+		}
+
+		static float Dot(const Vector3& v1, const Vector3& v2)
+		{
+			////todo W1
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+			return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+		}
 
-		static float Dot(const Vector3& v1, const Vector3& v2);
-		static Vector3 Cross(const Vector3& v1, const Vector3& v2);
-		static Vector3 Project(const Vector3& v1, const Vector3& v2);
-		static Vector3 Reject(const Vector3& v1, const Vector3& v2);
-		static Vector3 Reflect(const Vector3& v1, const Vector3& v2);
+		static Vector3 Cross(const Vector3& v1, const Vector3& v2)
+		{
+			////todo W1
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
 
-		static Vector3 Max(const Vector3& v1, const Vector3& v2);
-		static Vector3 Min(const Vector3& v1, const Vector3& v2);
+			return Vector3(
+				v1.y * v2.z - v1.z * v2.y,
+				v1.z * v2.x - v1.x * v2.z,
+				v1.x * v2.y - v1.y * v2.x);
+		}
+
+		static Vector3 Project(const Vector3& v1, const Vector3& v2)
+		{
+			return (v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
+
+		static Vector3 Reject(const Vector3& v1, const Vector3& v2)
+		{
+			return (v1 - v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
+
+		static Vector3 Reflect(const Vector3& v1, const Vector3& v2)
+		{
+			return v1 - (v2 * (2.f * Dot(v1, v2)));
+		}
+
+		static Vector3 Max(const Vector3& v1, const Vector3& v2)
+		{
+			return {
+				std::max(v1.x, v2.x),
+				std::max(v1.y, v2.y),
+				std::max(v1.z, v2.z)
+			};
+		}
+
+		static Vector3 Min(const Vector3& v1, const Vector3& v2)
+		{
+			return {
+				std::min(v1.x, v2.x),
+				std::min(v1.y, v2.y),
+				std::min(v1.z, v2.z)
+			};
+		}
 
 		static Vector3 Lico(float f1, const Vector3& v1, float f2, const Vector3& v2, float f3, const Vector3& v3);
 
@@ -34,19 +107,86 @@ namespace dae
 		Vector4 ToVector4() const;
 
 		//Member Operators
-		Vector3 operator*(float scale) const;
-		Vector3 operator/(float scale) const;
-		Vector3 operator+(const Vector3& v) const;
-		Vector3 operator-(const Vector3& v) const;
-		Vector3 operator-() const;
+		Vector3 operator*(float scale) const
+		{
+			return { x * scale, y * scale, z * scale };
+		}
+
+		Vector3 operator/(float scale) const
+		{
+			return { x / scale, y / scale, z / scale };
+		}
+
+		Vector3 operator+(const Vector3& v) const
+		{
+			return { x + v.x, y + v.y, z + v.z };
+		}
+
+		Vector3 operator-(const Vector3& v) const
+		{
+			return { x - v.x, y - v.y, z - v.z };
+		}
+
+		Vector3 operator-() const
+		{
+			return { -x ,-y,-z };
+		}
+
 		//Vector3& operator-();
-		Vector3& operator+=(const Vector3& v);
-		Vector3& operator-=(const Vector3& v);
-		Vector3& operator/=(float scale);
-		Vector3& operator*=(float scale);
-		float& operator[](int index);
-		float operator[](int index) const;
-		bool operator==(const Vector3& v) const;
+		Vector3& operator+=(const Vector3& v)
+		{
+			x += v.x;
+			y += v.y;
+			z += v.z;
+			return *this;
+		}
+
+		Vector3& operator-=(const Vector3& v)
+		{
+			x -= v.x;
+			y -= v.y;
+			z -= v.z;
+			return *this;
+		}
+
+		Vector3& operator/=(float scale)
+		{
+			x /= scale;
+			y /= scale;
+			z /= scale;
+			return *this;
+		}
+
+		Vector3& operator*=(float scale)
+		{
+			x *= scale;
+			y *= scale;
+			z *= scale;
+			return *this;
+		}
+
+		float& operator[](int index)
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
+
+		float operator[](int index) const
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
+
+		bool operator==(const Vector3& v) const
+		{
+			return AreEqual(x, v.x) && AreEqual(y, v.y) && AreEqual(z, v.z);
+		}
 
 		static const Vector3 UnitX;
 		static const Vector3 UnitY;
@@ -54,9 +194,17 @@ namespace dae
 		static const Vector3 Zero;
 	};
 
+	inline const Vector3 Vector3::UnitX = Vector3{ 1, 0, 0 };
+	inline const Vector3 Vector3::UnitY = Vector3{ 0, 1, 0 };
+	inline const Vector3 Vector3::UnitZ = Vector3{ 0, 0, 1 };
+	inline const Vector3 Vector3::Zero = Vector3{ 0, 0, 0 };
+
 	//Global Operators
 	inline Vector3 operator*(float scale, const Vector3& v)
 	{
 		return { v.x * scale, v.y * scale, v.z * scale };
 	}
 }
+
+//The conversions to and from Vector4 are defined there
+#include "Vector4.h"
@@ -1,9 +1,16 @@
 #pragma once
+#include <cassert>
+#include <cmath>
 
+#include "MathHelpers.h"
+#include "SIMD.h"
+#include "Vector3.h"
+
+//Header only, so every operator can be inlined into the hot loops
+//A Vector4 is exactly one SSE register, the arithmetic runs on SSE with a scalar fallback (see SIMD.h)
 namespace dae
 {
-	struct Vector3;
-	struct Vector4
+	struct alignas(16) Vector4
 	{
 		float x;
 		float y;
@@ -11,23 +18,126 @@ namespace dae
 		float w;
 
 		Vector4() = default;
-		Vector4(float _x, float _y, float _z, float _w);
-		Vector4(const Vector3& v, float _w);
+		Vector4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+		Vector4(const Vector3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+
+#if defined(DAE_SIMD_SSE)
+		explicit Vector4(__m128 v) { _mm_store_ps(&x, v); }
+		__m128 ToSIMD() const { return _mm_load_ps(&x); }
+#endif
+
+		float Magnitude() const
+		{
+			return std::sqrt(SqrMagnitude());
+		}
+
+		float SqrMagnitude() const
+		{
+			return Dot(*this, *this);
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			x /= m;
+			y /= m;
+			z /= m;
+			w /= m;
 
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector4 Normalized() const;
+			return m;
+		}
 
-		static float Dot(const Vector4& v1, const Vector4& v2);
+		Vector4 Normalized() const
+		{
+			const float m = Magnitude();
+			return { x / m, y / m, z / m, w / m };
+		}
+
+		static float Dot(const Vector4& v1, const Vector4& v2)
+		{
+			////todo W1
+			//throw std::runtime_error("Not Implemented Yet");
+			//return {};
+
+#if defined(DAE_SIMD_SSE)
+			const __m128 product{ _mm_mul_ps(v1.ToSIMD(), v2.ToSIMD()) };
+			const __m128 pairs{ _mm_add_ps(product, _mm_movehl_ps(product, product)) };
+			return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+#else
+			return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w;
+#endif
+		}
 
 		// operator overloading
-		Vector4 operator*(float scale) const;
-		Vector4 operator+(const Vector4& v) const;
-		Vector4 operator-(const Vector4& v) const;
-		Vector4& operator+=(const Vector4& v);
-		float& operator[](int index);
-		float operator[](int index) const;
-		bool operator==(const Vector4& v) const;
+		Vector4 operator*(float scale) const
+		{
+#if defined(DAE_SIMD_SSE)
+			return Vector4{ _mm_mul_ps(ToSIMD(), _mm_set1_ps(scale)) };
+#else
+			return { x * scale, y * scale, z * scale, w * scale };
+#endif
+		}
+
+		Vector4 operator+(const Vector4& v) const
+		{
+#if defined(DAE_SIMD_SSE)
+			return Vector4{ _mm_add_ps(ToSIMD(), v.ToSIMD()) };
+#else
+			return { x + v.x, y + v.y, z + v.z, w + v.w };
+#endif
+		}
+
+		Vector4 operator-(const Vector4& v) const
+		{
+#if defined(DAE_SIMD_SSE)
+			return Vector4{ _mm_sub_ps(ToSIMD(), v.ToSIMD()) };
+#else
+			return { x - v.x, y - v.y, z - v.z, w - v.w };
+#endif
+		}
+
+		Vector4& operator+=(const Vector4& v)
+		{
+			*this = *this + v;
+			return *this;
+		}
+
+		float& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
+
+		float operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
+
+		bool operator==(const Vector4& v) const
+		{
+			return AreEqual(x, v.x, .000001f) && AreEqual(y, v.y, .000001f) && AreEqual(z, v.z, .000001f) && AreEqual(w, v.w, .000001f);
+		}
 	};
+
+	//Vector3 conversions, they need both types complete
+	inline Vector3::Vector3(const Vector4& v) : x(v.x), y(v.y), z(v.z) {}
+
+	inline Vector4 Vector3::ToPoint4() const
+	{
+		return { x, y, z, 1 };
+	}
+
+	inline Vector4 Vector3::ToVector4() const
+	{
+		return { x, y, z, 0 };
+	}
 }
@@ -7,12 +7,17 @@
 #undef main
 
 //Standard includes
+#include <algorithm>
 #include <iostream>
+#include <string>
 
 //Project includes
+#include "CommandLine.h"
+#include "ImageIO.h"
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "Utils.h"
 
 using namespace dae;
 
@@ -22,11 +27,150 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+struct HeadlessSettings
+{
+	std::string sceneName{ "ReferenceScene" };
+	int width{ 640 };
+	int height{ 480 };
+	int frames{ 1 };
+	std::string outputPrefix{ "RayTracing_Frame" };
+	bool wavefront{ false };
+	Renderer::AntiAliasingMode antiAliasing{ Renderer::AntiAliasingMode::Off };
+	//Renders in bands of streamRows rows straight into a PPM instead of holding the whole frame, 0 saves whole frames
+	int streamRows{ 0 };
+	//Format of the whole frames, also used for screenshots of the window
+	ImageFormat imageFormat{ ImageFormat::PNG8 };
+	Tonemapper tonemapper{ Tonemapper::Clamp };
+	bool isSRGB{ false };
+};
+
+//Renders without a window or input, every frame is written to <outputPrefix>_<frame>.<extension>
+//Whole frames are written by an AsyncImageWriter while the next frame renders
+int RunHeadless(const HeadlessSettings& settings)
+{
+	const auto pScene = CreateScene(settings.sceneName);
+	if (!pScene)
+	{
+		std::cout << "Unknown scene: " << settings.sceneName << std::endl;
+		return 1;
+	}
+
+	pScene->Initialize();
+	pScene->GetCamera().isInputEnabled = false;
+
+	const auto pTimer = new Timer();
+	// a streamed frame only ever holds one band
+	const auto pRenderer = new Renderer(settings.width, settings.streamRows > 0 ? std::min(settings.height, settings.streamRows) : settings.height);
+	pRenderer->SetWavefrontEnabled(settings.wavefront);
+	pRenderer->SetAntiAliasingMode(settings.antiAliasing);
+	pRenderer->SetTonemapper(settings.tonemapper);
+	pRenderer->SetSRGBEnabled(settings.isSRGB);
+	// PFM keeps the linear colors, the other formats get what the surface shows
+	const bool isLinearOutput{ settings.imageFormat == ImageFormat::PFM };
+
+	AsyncImageWriter imageWriter{};
+
+	pTimer->Start();
+
+	int result{ 0 };
+	for (int frame{}; frame < settings.frames; ++frame)
+	{
+		std::string frameNumber{ std::to_string(frame) };
+		frameNumber.insert(0, frameNumber.size() < 4 ? 4 - frameNumber.size() : 0, '0');
+
+		pScene->Update(pTimer);
+
+		bool isSaved{};
+		std::string fileName{ settings.outputPrefix + "_" + frameNumber };
+		if (settings.streamRows > 0)
+		{
+			fileName += ".ppm";
+			isSaved = pRenderer->RenderToPPM(pScene, fileName, settings.height);
+		}
+		else
+		{
+			fileName += std::string{ "." } + GetImageFormatExtension(settings.imageFormat);
+			pRenderer->Render(pScene);
+			imageWriter.Submit(pRenderer->CaptureImage(isLinearOutput), fileName, settings.imageFormat);
+			// a failed write is only known once the writer gets to it, stop at the first one reported
+			isSaved = imageWriter.GetFailedCount() == 0;
+		}
+		pTimer->Update();
+
+		if (!isSaved)
+		{
+			if (settings.streamRows > 0)
+				std::cout << "Something went wrong. " << fileName << " not saved!" << std::endl;
+			result = 1;
+			break;
+		}
+	}
+
+	imageWriter.Flush();
+	for (const std::string& failedFileName : imageWriter.TakeFailedFileNames())
+	{
+		std::cout << "Something went wrong. " << failedFileName << " not saved!" << std::endl;
+		result = 1;
+	}
+
+	std::cout << "Rendered " << settings.frames << " frames of " << settings.sceneName << " at "
+		<< settings.width << "x" << settings.height << " in " << pTimer->GetTotal() << "s" << std::endl;
+	pTimer->Stop();
+
+	delete pScene;
+	delete pRenderer;
+	delete pTimer;
+
+	return result;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Command line, --headless renders to disk instead of opening a window
+	bool isHeadless{ false };
+	HeadlessSettings headlessSettings{};
+	// levels the CPU lacks fall back to a narrower one, the SIMD path printed below is the one used
+	SIMDLevel simdLevel{};
+	// windowed only, headless frames have no time budget
+	float targetFrameMs{ 0.f };
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		if (argument == "--headless") isHeadless = true;
+		else if (argument == "--scene" && hasValue) headlessSettings.sceneName = args[++i];
+		else if (argument == "--width" && hasValue && ParseArgument(args[++i], 1, headlessSettings.width)) continue;
+		else if (argument == "--height" && hasValue && ParseArgument(args[++i], 1, headlessSettings.height)) continue;
+		else if (argument == "--frames" && hasValue && ParseArgument(args[++i], 1, headlessSettings.frames)) continue;
+		else if (argument == "--output" && hasValue) headlessSettings.outputPrefix = args[++i];
+		else if (argument == "--wavefront") headlessSettings.wavefront = true;
+		else if (argument == "--stream" && hasValue && ParseArgument(args[++i], 0, headlessSettings.streamRows)) continue;
+		else if (argument == "--image-format" && hasValue) headlessSettings.imageFormat = ParseImageFormat(args[++i]);
+		else if (argument == "--tonemap" && hasValue) headlessSettings.tonemapper = ParseTonemapper(args[++i]);
+		else if (argument == "--srgb") headlessSettings.isSRGB = true;
+		else if (argument == "--target-ms" && hasValue && ParseArgument(args[++i], 0.f, targetFrameMs)) continue;
+		else if (argument == "--aa" && hasValue) headlessSettings.antiAliasing = Renderer::ParseAntiAliasingMode(args[++i]);
+		else if (argument == "--simd" && hasValue && ParseSIMDLevel(args[++i], simdLevel)) GeometryUtils::SetSIMDLevel(simdLevel);
+		else
+		{
+			// unknown options, values that do not parse and numbers out of range
+			std::cout << "Usage: " << args[0] << " [--headless] [--scene W1|W2|W3|W4|ReferenceScene|BunnyScene]"
+				<< " [--width 640] [--height 480] [--frames 1] [--output RayTracing_Frame] [--wavefront] [--aa off|adaptive|full] [--simd scalar|sse|avx2]"
+				<< " [--target-ms 0] [--stream rows] [--image-format png|png16|pfm|ppm]"
+				<< " [--tonemap clamp|reinhard|aces] [--srgb]" << std::endl;
+			return 1;
+		}
+	}
+
+	const float targetFrameTime{ targetFrameMs / 1000.f };
+
+	std::cout << "SIMD path: " << GetSIMDLevelName(GeometryUtils::GetSIMDLevel())
+		<< " (CPU supports " << GetSIMDLevelName(DetectSIMDLevel()) << ")" << std::endl;
+
+	if (isHeadless)
+		return RunHeadless(headlessSettings);
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -46,6 +190,14 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
+	// a static view keeps refining instead of rendering the same frame again
+	pRenderer->SetProgressiveEnabled(true);
+	pRenderer->SetTargetFrameTime(targetFrameTime);
+	pRenderer->SetTonemapper(headlessSettings.tonemapper);
+	pRenderer->SetSRGBEnabled(headlessSettings.isSRGB);
+	// screenshots are encoded and written in the background, the window keeps rendering meanwhile
+	AsyncImageWriter imageWriter{};
+	const std::string screenshotName{ std::string{ "RayTracing_Buffer." } + GetImageFormatExtension(headlessSettings.imageFormat) };
 
 	//const auto pScene = new Scene_W1();
 	//const auto pScene = new Scene_W2();
@@ -89,6 +241,33 @@ int main(int argc, char* args[])
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F3) {
 					pRenderer->CycleLightingMode();
 				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F4) {
+					pRenderer->TogglePacketTracing();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F5) {
+					pRenderer->ToggleShadowCache();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F6) {
+					pRenderer->ToggleWavefront();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F7) {
+					pRenderer->ToggleProgressive();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F8) {
+					pRenderer->CycleAntiAliasing();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F9) {
+					// 30 fps unless the command line asked for another target
+					const float target{ targetFrameTime > 0.f ? targetFrameTime : 1.f / 30.f };
+					pRenderer->SetTargetFrameTime(pRenderer->GetTargetFrameTime() > 0.f ? 0.f : target);
+					std::cout << "Dynamic resolution " << (pRenderer->GetTargetFrameTime() > 0.f ? "ON" : "OFF") << std::endl;
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F10) {
+					pRenderer->CycleTonemapper();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F11) {
+					pRenderer->ToggleSRGB();
+				}
 				break;
 			}
 		}
@@ -99,24 +278,37 @@ int main(int argc, char* args[])
 		//--------- Render ---------
 		pRenderer->Render(pScene);
 
+		// nothing left to refine, sleep until there is input instead of spinning
+		if (pRenderer->IsIdle()) {
+			SDL_WaitEventTimeout(nullptr, 16);
+		}
+
 		//--------- Timer ---------
 		pTimer->Update();
+		pRenderer->UpdateResolutionScale(pTimer->GetElapsed());
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "Shadow cache hit rate: " << pRenderer->GetShadowCacheHitRate() * 100.f << "%" << std::endl;
+			if (pRenderer->GetTargetFrameTime() > 0.f) {
+				std::cout << "Render size: " << pRenderer->GetRenderWidth() << "x" << pRenderer->GetRenderHeight() << std::endl;
+			}
+			pRenderer->ResetRayCount();
 		}
 
 		//Save screenshot after full render
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			imageWriter.Submit(pRenderer->CaptureImage(headlessSettings.imageFormat == ImageFormat::PFM), screenshotName, headlessSettings.imageFormat);
+			std::cout << "Saving screenshot to " << screenshotName << std::endl;
 			takeScreenshot = false;
 		}
+		for (const std::string& failedFileName : imageWriter.TakeFailedFileNames())
+		{
+			std::cout << "Something went wrong. " << failedFileName << " not saved!" << std::endl;
+		}
 	}
 	pTimer->Stop();
 
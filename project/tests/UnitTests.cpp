@@ -2,6 +2,19 @@
 #include "../src/Vector3.h"
 #include "../src/Vector4.h"
 #include "../src/Matrix.h"
+#include "../src/Utils.h"
+#include "../src/ThreadPool.h"
+#include "../src/ImageIO.h"
+#include "../src/Material.h"
+#include "../src/MeshIO.h"
+#include "../src/Renderer.h"
+#include "../src/Scene.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
 
 namespace dae
 {
@@ -37,6 +50,1037 @@ namespace dae
 
 	// W1
 
+	// W2
+	TEST(Matrix, ComposesTransforms) {
+		const Matrix scale{ Matrix::CreateScale(2.f, 3.f, 4.f) };
+		const Matrix rotation{ Matrix::CreateRotation(.3f, -1.2f, .7f) };
+		const Matrix translation{ Matrix::CreateTranslation(5.f, -6.f, 7.f) };
+
+		// row vectors, p * A * B applies A first
+		const Matrix combined{ scale * rotation * translation };
+		const Vector3 point{ 1.f, -2.f, 3.f };
+		const Vector3 expected{ translation.TransformPoint(rotation.TransformPoint(scale.TransformPoint(point))) };
+		EXPECT_EQ(expected, combined.TransformPoint(point));
+		EXPECT_EQ(1.f, combined[3].w);
+
+		const Vector3 roundTrip{ Matrix::Inverse(combined).TransformPoint(combined.TransformPoint(point)) };
+		EXPECT_NEAR(point.x, roundTrip.x, 1e-4f);
+		EXPECT_NEAR(point.y, roundTrip.y, 1e-4f);
+		EXPECT_NEAR(point.z, roundTrip.z, 1e-4f);
+		EXPECT_EQ(rotation, Matrix::Transpose(Matrix::Transpose(rotation)));
+		EXPECT_EQ(Matrix{}, rotation * Matrix::Transpose(rotation));
+	}
+
+	// W5
+	static TriangleMesh CreateRandomTriangleSoup(std::mt19937& rng, int triangleCount)
+	{
+		std::uniform_real_distribution<float> position{ -5.f, 5.f };
+		std::uniform_real_distribution<float> offset{ -.5f, .5f };
+
+		TriangleMesh mesh{};
+		mesh.cullMode = TriangleCullMode::NoCulling;
+		for (int i{}; i < triangleCount; ++i)
+		{
+			const Vector3 v0{ position(rng), position(rng), position(rng) };
+			const Vector3 v1{ v0 + Vector3{ offset(rng), offset(rng), offset(rng) } };
+			const Vector3 v2{ v0 + Vector3{ offset(rng), offset(rng), offset(rng) } };
+			mesh.AppendTriangle(Triangle{ v0, v1, v2 }, true);
+		}
+		mesh.UpdateAABB();
+		mesh.UpdateTransforms();
+
+		return mesh;
+	}
+
+	static void ExpectBVHMatchesBruteForce(const TriangleMesh& mesh, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position{ -5.f, 5.f };
+		std::uniform_real_distribution<float> offset{ -.5f, .5f };
+
+		for (int i{}; i < 1000; ++i)
+		{
+			Ray ray{};
+			ray.origin = { position(rng), position(rng), -10.f };
+			ray.direction = Vector3{ offset(rng), offset(rng), 1.f }.Normalized();
+
+			HitRecord bruteForce{};
+			for (size_t t{}; t < mesh.indices.size(); t += 3)
+			{
+				Triangle triangle{ mesh.transformedPositions[mesh.indices[t]], mesh.transformedPositions[mesh.indices[t + 1]],
+					mesh.transformedPositions[mesh.indices[t + 2]], mesh.transformedNormals[t / 3] };
+				triangle.cullMode = mesh.cullMode;
+
+				HitRecord hit{};
+				if (GeometryUtils::HitTest_Triangle(triangle, ray, hit) && hit.t < bruteForce.t)
+					bruteForce = hit;
+			}
+
+			HitRecord traversal{};
+			GeometryUtils::HitTest_TriangleMesh(mesh, ray, traversal);
+
+			EXPECT_EQ(bruteForce.didHit, traversal.didHit);
+			EXPECT_FLOAT_EQ(bruteForce.t, traversal.t);
+			EXPECT_EQ(bruteForce.didHit, GeometryUtils::HitTest_TriangleMesh(mesh, ray));
+		}
+	}
+
+	// W5
+	TEST(BVH, ClosestHitMatchesBruteForce) {
+		std::mt19937 rng{ 1337 };
+		const TriangleMesh mesh{ CreateRandomTriangleSoup(rng, 500) };
+
+		ExpectBVHMatchesBruteForce(mesh, rng);
+	}
+
+	// W5
+	TEST(BVH, RefitMatchesBruteForce) {
+		std::mt19937 rng{ 7331 };
+		TriangleMesh mesh{ CreateRandomTriangleSoup(rng, 500) };
+		const size_t nodeCount{ mesh.bvh.GetNodes().size() };
+
+		mesh.RotateY(1.f);
+		mesh.Translate({ 1.f, .5f, 0.f });
+		mesh.UpdateTransforms();
+
+		EXPECT_EQ(nodeCount, mesh.bvh.GetNodes().size());
+		ExpectBVHMatchesBruteForce(mesh, rng);
+	}
+
+	// W5
+	TEST(BVH, InstanceMatchesTransformedMesh) {
+		std::mt19937 rng{ 4242 };
+		TriangleMesh mesh{ CreateRandomTriangleSoup(rng, 200) };
+		TriangleMesh source{ mesh };
+
+		mesh.Scale({ 1.5f, 1.5f, 1.5f });
+		mesh.RotateY(.7f);
+		mesh.Translate({ 1.f, 0.f, 2.f });
+		mesh.UpdateTransforms();
+
+		source.PrepareForInstancing();
+
+		TriangleMeshInstance instance{};
+		instance.pMesh = &source;
+		instance.SetTransform(mesh.translationTransform * mesh.rotationTransform * mesh.scaleTransform);
+
+		std::uniform_real_distribution<float> position{ -5.f, 5.f };
+		std::uniform_real_distribution<float> offset{ -.5f, .5f };
+		for (int i{}; i < 1000; ++i)
+		{
+			Ray ray{};
+			ray.origin = { position(rng), position(rng), -10.f };
+			ray.direction = Vector3{ offset(rng), offset(rng), 1.f }.Normalized();
+
+			HitRecord meshHit{};
+			HitRecord instanceHit{};
+			GeometryUtils::HitTest_TriangleMesh(mesh, ray, meshHit);
+			GeometryUtils::HitTest_TriangleMeshInstance(instance, ray, instanceHit);
+
+			EXPECT_EQ(meshHit.didHit, instanceHit.didHit);
+			if (meshHit.didHit && instanceHit.didHit)
+			{
+				EXPECT_NEAR(meshHit.t, instanceHit.t, 1e-3f);
+				EXPECT_NEAR(meshHit.origin.x, instanceHit.origin.x, 1e-3f);
+			}
+		}
+	}
+
+	//Adds more instanced meshes and instances than any scene does, the first ones must not move
+	class ManyInstancedMeshesScene final : public Scene
+	{
+	public:
+		void Initialize() override
+		{
+			m_pFirstMesh = AddInstancedMesh(TriangleCullMode::NoCulling);
+			m_pFirstInstance = AddTriangleMeshInstance(m_pFirstMesh, Matrix::CreateTranslation({ 1.f, 2.f, 3.f }));
+			for (int i{}; i < 100; ++i)
+			{
+				AddTriangleMeshInstance(AddInstancedMesh(TriangleCullMode::NoCulling), Matrix::CreateTranslation({ float(i), 0.f, 0.f }));
+			}
+		}
+
+		bool IsFirstMeshInPlace() const { return m_pFirstMesh == &m_InstancedMeshes.front(); }
+		bool IsFirstInstanceInPlace() const { return m_pFirstInstance == &m_TriangleMeshInstances.front(); }
+		const TriangleMeshInstance& GetFirstInstance() const { return *m_pFirstInstance; }
+
+	private:
+		const TriangleMesh* m_pFirstMesh{};
+		const TriangleMeshInstance* m_pFirstInstance{};
+	};
+
+	TEST(Scene, InstancedMeshesKeepTheirAddress) {
+		ManyInstancedMeshesScene scene{};
+		scene.Initialize();
+		EXPECT_TRUE(scene.IsFirstMeshInPlace());
+		EXPECT_TRUE(scene.IsFirstInstanceInPlace());
+		EXPECT_EQ(Vector3(-1.f, -2.f, -3.f), scene.GetFirstInstance().worldToObject.TransformPoint({}));
+	}
+
+	// W5
+	TEST(RayPacket, MatchesSingleRays) {
+		std::mt19937 rng{ 2024 };
+		const TriangleMesh mesh{ CreateRandomTriangleSoup(rng, 500) };
+
+		const Sphere sphere{ { 0.f, 0.f, 2.f }, 2.f };
+		const Plane plane{ { 0.f, 0.f, 6.f }, { 0.f, 0.f, -1.f } };
+
+		std::uniform_real_distribution<float> position{ -5.f, 5.f };
+		std::uniform_real_distribution<float> offset{ -.5f, .5f };
+		for (int i{}; i < 100; ++i)
+		{
+			// a small grid of directions, like a block of camera rays
+			RayPacket packet{};
+			packet.origin = { position(rng), position(rng), -10.f };
+
+			const Vector3 corner{ offset(rng), offset(rng), 1.f };
+			for (uint32_t lane{}; lane < RayPacket::Width; ++lane)
+			{
+				const Vector3 step{ float(lane % RayPacket::Size) * .02f, float(lane / RayPacket::Size) * -.02f, 0.f };
+				packet.SetDirection(lane, (corner + step).Normalized());
+			}
+			packet.Finalize();
+
+			constexpr uint32_t allLanes{ (1u << RayPacket::Width) - 1 };
+			RayPacketHit hit{};
+			GeometryUtils::HitTest_PlanePacket(plane, packet, allLanes, hit);
+			GeometryUtils::HitTest_SpherePacket(sphere, packet, allLanes, hit);
+			GeometryUtils::HitTest_TriangleMeshPacket(mesh, packet, allLanes, hit);
+
+			for (uint32_t lane{}; lane < RayPacket::Width; ++lane)
+			{
+				const Ray ray{ packet.GetRay(lane) };
+
+				HitRecord single{};
+				GeometryUtils::HitTest_Plane(plane, ray, single);
+				GeometryUtils::HitTest_Sphere(sphere, ray, single);
+				GeometryUtils::HitTest_TriangleMesh(mesh, ray, single);
+
+				EXPECT_EQ(single.didHit, hit.records[lane].didHit);
+				EXPECT_FLOAT_EQ(single.t, hit.records[lane].t);
+				EXPECT_FLOAT_EQ(single.t, hit.t[lane]);
+			}
+		}
+	}
+
+	// W5
+	TEST(Occlusion, MatchesClosestHit) {
+		std::mt19937 rng{ 9001 };
+		TriangleMesh mesh{ CreateRandomTriangleSoup(rng, 500) };
+		mesh.cullMode = TriangleCullMode::BackFaceCulling;
+
+		TriangleMesh source{ mesh };
+		source.PrepareForInstancing();
+
+		TriangleMeshInstance instance{};
+		instance.pMesh = &source;
+		instance.SetTransform(Matrix::CreateTranslation({ .5f, 0.f, 1.f }) * Matrix::CreateRotationY(.3f));
+
+		const Sphere sphere{ { 0.f, 0.f, 2.f }, 2.f };
+		const Plane plane{ { 0.f, 0.f, 6.f }, { 0.f, 0.f, -1.f } };
+		Triangle triangle{ { -3.f, -3.f, 0.f }, { 3.f, -3.f, 0.f }, { 0.f, 3.f, 0.f } };
+		triangle.cullMode = TriangleCullMode::NoCulling;
+
+		std::uniform_real_distribution<float> position{ -5.f, 5.f };
+		std::uniform_real_distribution<float> offset{ -.5f, .5f };
+		std::uniform_real_distribution<float> length{ 1.f, 20.f };
+		for (int i{}; i < 1000; ++i)
+		{
+			// shadow rays end at the light, so only occluders before ray.max count
+			Ray ray{};
+			ray.origin = { position(rng), position(rng), -10.f };
+			ray.direction = Vector3{ offset(rng), offset(rng), 1.f }.Normalized();
+			ray.max = length(rng);
+
+			HitRecord sphereHit{}, planeHit{}, triangleHit{}, meshHit{}, instanceHit{};
+			GeometryUtils::HitTest_Sphere(sphere, ray, sphereHit);
+			GeometryUtils::HitTest_Plane(plane, ray, planeHit);
+			GeometryUtils::HitTest_Triangle(triangle, ray, triangleHit);
+			GeometryUtils::HitTest_TriangleMesh(mesh, ray, meshHit);
+			GeometryUtils::HitTest_TriangleMeshInstance(instance, ray, instanceHit);
+
+			EXPECT_EQ(sphereHit.didHit, GeometryUtils::HitTest_Sphere(sphere, ray));
+			EXPECT_EQ(planeHit.didHit, GeometryUtils::HitTest_Plane(plane, ray));
+			EXPECT_EQ(triangleHit.didHit, GeometryUtils::HitTest_Triangle(triangle, ray));
+			EXPECT_EQ(meshHit.didHit, GeometryUtils::HitTest_TriangleMesh(mesh, ray));
+			EXPECT_EQ(instanceHit.didHit, GeometryUtils::HitTest_TriangleMeshInstance(instance, ray));
+		}
+	}
+
+	//Loose triangles next to a sphere, no scene builds them otherwise
+	class LooseTriangleScene final : public Scene
+	{
+	public:
+		void Initialize() override
+		{
+			AddSphere({ 2.f, 0.f, 3.f }, 1.5f);
+			for (float z : { 0.f, 4.f })
+			{
+				Triangle& triangle{ m_Triangles.emplace_back(Vector3{ -3.f, -3.f, z }, Vector3{ 3.f, -3.f, z }, Vector3{ 0.f, 3.f, z }) };
+				triangle.cullMode = TriangleCullMode::NoCulling;
+			}
+		}
+	};
+
+	TEST(Occlusion, SceneMatchesClosestHit) {
+		LooseTriangleScene scene{};
+		scene.Initialize();
+		scene.UpdateAccelerationStructure();
+
+		std::mt19937 rng{ 505 };
+		std::uniform_real_distribution<float> position{ -3.f, 3.f };
+		std::uniform_real_distribution<float> offset{ -.5f, .5f };
+		std::uniform_real_distribution<float> length{ 1.f, 10.f };
+		ShadowCache shadowCache{};
+		int occludedCount{};
+		for (int i{}; i < 1000; ++i)
+		{
+			Ray ray{};
+			ray.origin = { position(rng), position(rng), -2.f };
+			ray.direction = Vector3{ offset(rng), offset(rng), 1.f }.Normalized();
+			ray.max = length(rng);
+
+			HitRecord hit{};
+			scene.GetClosestHit(ray, hit);
+			EXPECT_EQ(hit.didHit, scene.DoesHit(ray)) << i;
+			EXPECT_EQ(hit.didHit, scene.DoesHit(ray, shadowCache, 0)) << i;
+			occludedCount += hit.didHit;
+		}
+
+		// the triangles have to be in the way of some of the rays and miss others
+		EXPECT_GT(occludedCount, 100);
+		EXPECT_LT(occludedCount, 900);
+	}
+
+	TEST(KernelTable, EveryLevelMatchesScalar) {
+		std::mt19937 rng{ 4242 };
+		TriangleMesh mesh{ CreateRandomTriangleSoup(rng, 200) };
+		ASSERT_FALSE(mesh.trianglePacks.empty());
+
+		const GeometryUtils::KernelTable scalar{ GeometryUtils::CreateKernelTable(SIMDLevel::Scalar) };
+		EXPECT_EQ(SIMDLevel::Scalar, scalar.level);
+
+		std::uniform_real_distribution<float> position{ -5.f, 5.f };
+		std::uniform_real_distribution<float> offset{ -.5f, .5f };
+		for (SIMDLevel level : { SIMDLevel::SSE, SIMDLevel::AVX2 })
+		{
+			// levels the CPU lacks fall back to a narrower table
+			const GeometryUtils::KernelTable kernels{ GeometryUtils::CreateKernelTable(level) };
+			EXPECT_LE(kernels.level, DetectSIMDLevel());
+
+			for (int i{}; i < 500; ++i)
+			{
+				Ray ray{};
+				ray.origin = { position(rng), position(rng), -10.f };
+				ray.direction = Vector3{ offset(rng), offset(rng), 1.f }.Normalized();
+
+				for (TriangleCullMode cullMode : { TriangleCullMode::NoCulling, TriangleCullMode::BackFaceCulling })
+				{
+					for (const TrianglePack& pack : mesh.trianglePacks)
+					{
+						float expectedT{ FLT_MAX }, t{ FLT_MAX };
+						EXPECT_EQ(scalar.hitTestTrianglePack(pack, cullMode, ray, expectedT), kernels.hitTestTrianglePack(pack, cullMode, ray, t));
+						EXPECT_NEAR(expectedT, t, 1e-4f);
+						EXPECT_EQ(scalar.occlusionTestTrianglePack(pack, cullMode, ray), kernels.occlusionTestTrianglePack(pack, cullMode, ray));
+					}
+				}
+			}
+		}
+	}
+
+	TEST(KernelTable, TonemapMatchesScalar) {
+		// odd count for the scalar tail, out of range and NaN channels included
+		std::mt19937 rng{ 77 };
+		std::uniform_real_distribution<float> channel{ -.5f, 6.f };
+		std::vector<ColorRGB> colors(1001);
+		for (ColorRGB& color : colors)
+		{
+			color = { channel(rng), channel(rng), channel(rng) };
+		}
+		colors[0] = { 2.f, 1.f, .5f };
+		colors[1] = { NAN, -1.f, 1e30f };
+
+		// the channels of an ABGR surface
+		const PixelPacking packing{ 0, 8, 16, 0xFF000000 };
+		const GeometryUtils::KernelTable scalar{ GeometryUtils::CreateKernelTable(SIMDLevel::Scalar) };
+
+		for (Tonemapper tonemapper : { Tonemapper::Clamp, Tonemapper::Reinhard, Tonemapper::ACES })
+		{
+			for (bool isSRGB : { false, true })
+			{
+				std::vector<uint32_t> expected(colors.size());
+				scalar.tonemapPixels(colors.data(), expected.data(), colors.size(), tonemapper, isSRGB, packing);
+
+				for (SIMDLevel level : { SIMDLevel::SSE, SIMDLevel::AVX2 })
+				{
+					std::vector<uint32_t> pixels(colors.size());
+					GeometryUtils::CreateKernelTable(level).tonemapPixels(colors.data(), pixels.data(), colors.size(), tonemapper, isSRGB, packing);
+					EXPECT_EQ(expected, pixels) << GetTonemapperName(tonemapper) << (isSRGB ? " sRGB " : " linear ") << GetSIMDLevelName(level);
+				}
+
+				// NaN and negative channels are black, the rest of the HDR range saturates without wrapping
+				EXPECT_EQ(0xFF000000u, expected[1] & 0xFF00FFFFu);
+				EXPECT_GT((expected[1] >> 16) & 0xFF, 200u);
+			}
+		}
+
+		// Clamp scales the brightest channel down to 1 and keeps the ratios
+		std::vector<uint32_t> pixel(1);
+		ColorUtils::TonemapPixels(colors.data(), pixel.data(), 1, Tonemapper::Clamp, false, packing);
+		EXPECT_EQ(0xFF000000u | (64u << 16) | (128u << 8) | 255u, pixel[0]);
+	}
+
+	TEST(KernelTable, CookTorrenceMatchesScalar) {
+		// metals, dielectrics and the in between case that has neither diffuse nor albedo tinted specular
+		const std::vector<BRDF::CookTorrenceParameters> materials{
+			{ { .972f, .960f, .915f }, 1.f, 1.f },
+			{ { .75f, .75f, .75f }, 0.f, .1f },
+			{ { .955f, .637f, .538f }, .5f, .6f }
+		};
+
+		// odd count for the scalar tail, directions on the side of the normal like the renderer sends them
+		std::mt19937 rng{ 91 };
+		std::uniform_real_distribution<float> direction{ -1.f, 1.f };
+		std::vector<ShadingSample> samples(1003);
+		for (size_t i{}; i < samples.size(); ++i)
+		{
+			const Vector3 n{ Vector3{ direction(rng), direction(rng), direction(rng) }.Normalized() };
+			const auto onSideOf = [&](const Vector3& normal) {
+				const Vector3 candidate{ Vector3{ direction(rng), direction(rng), direction(rng) }.Normalized() };
+				return Vector3::Dot(candidate, normal) < .05f ? (candidate + normal * 1.5f).Normalized() : candidate;
+				};
+			samples[i] = { static_cast<uint32_t>(i % materials.size()), n, onSideOf(n), onSideOf(n) };
+		}
+
+		std::vector<ColorRGB> expected(samples.size());
+		GeometryUtils::CreateKernelTable(SIMDLevel::Scalar).cookTorrence(materials.data(), samples.data(), expected.data(), samples.size());
+		for (size_t i{}; i < samples.size(); ++i)
+		{
+			const ShadingSample& sample{ samples[i] };
+			const ColorRGB direct{ BRDF::CookTorrence(materials[sample.materialIndex], sample.normal, sample.l, sample.v) };
+			ASSERT_EQ(direct.r, expected[i].r);
+			ASSERT_EQ(direct.g, expected[i].g);
+			ASSERT_EQ(direct.b, expected[i].b);
+		}
+
+		for (SIMDLevel level : { SIMDLevel::SSE, SIMDLevel::AVX2 })
+		{
+			std::vector<ColorRGB> colors(samples.size());
+			GeometryUtils::CreateKernelTable(level).cookTorrence(materials.data(), samples.data(), colors.data(), samples.size());
+			for (size_t i{}; i < samples.size(); ++i)
+			{
+				// Schlick's fifth power is multiplied out instead of calling powf
+				const float tolerance{ 1e-5f * std::max(1.f, std::abs(expected[i].r) + std::abs(expected[i].g) + std::abs(expected[i].b)) };
+				ASSERT_NEAR(expected[i].r, colors[i].r, tolerance) << i << ' ' << GetSIMDLevelName(level);
+				ASSERT_NEAR(expected[i].g, colors[i].g, tolerance) << i << ' ' << GetSIMDLevelName(level);
+				ASSERT_NEAR(expected[i].b, colors[i].b, tolerance) << i << ' ' << GetSIMDLevelName(level);
+			}
+		}
+	}
+
+	TEST(Material, BatchMatchesDirectShading) {
+		MaterialTable table{};
+		const Material_Lambert lambert{ { .49f, .57f, .57f }, 1.f };
+		const Material_LambertPhong phong{ colors::Blue, .5f, .5f, 15.f };
+		const Material_CookTorrence metal{ { .972f, .960f, .915f }, 1.f, .6f };
+		const Material_CookTorrence plastic{ { .75f, .75f, .75f }, 0.f, .1f };
+
+		// ids follow insertion order across types, handles index the array of their own type
+		EXPECT_EQ(0, table.Add(lambert));
+		EXPECT_EQ(1, table.Add(metal));
+		EXPECT_EQ(2, table.Add(phong));
+		EXPECT_EQ(3, table.Add(plastic));
+		EXPECT_EQ(MaterialType::CookTorrence, table.GetHandle(3).type);
+		EXPECT_EQ(1u, table.GetHandle(3).index);
+
+		std::mt19937 rng{ 77 };
+		std::uniform_real_distribution<float> direction{ -1.f, 1.f };
+
+		ShadingBatch batch{};
+		std::vector<ShadingSlot> slots{};
+		std::vector<ColorRGB> expected{};
+		for (int i{}; i < 64; ++i)
+		{
+			const unsigned char materialId{ static_cast<unsigned char>(i % 4) };
+			const Vector3 n{ Vector3{ direction(rng), 1.f, direction(rng) }.Normalized() };
+			const Vector3 l{ Vector3{ direction(rng), 1.f, direction(rng) }.Normalized() };
+			const Vector3 v{ Vector3{ direction(rng), 1.f, direction(rng) }.Normalized() };
+
+			slots.push_back(batch.Add(table, materialId, n, l, v));
+			switch (materialId)
+			{
+			case 0: expected.push_back(lambert.Shade(n, l, v)); break;
+			case 1: expected.push_back(metal.Shade(n, l, v)); break;
+			case 2: expected.push_back(phong.Shade(n, l, v)); break;
+			default: expected.push_back(plastic.Shade(n, l, v)); break;
+			}
+		}
+		batch.Shade(table);
+
+		for (size_t i{}; i < slots.size(); ++i)
+		{
+			// the Cook-Torrance samples go through the wide kernel of this CPU
+			const ColorRGB& color{ batch.GetColor(slots[i]) };
+			const float tolerance{ 1e-5f * std::max(1.f, std::abs(expected[i].r) + std::abs(expected[i].g) + std::abs(expected[i].b)) };
+			EXPECT_NEAR(expected[i].r, color.r, tolerance);
+			EXPECT_NEAR(expected[i].g, color.g, tolerance);
+			EXPECT_NEAR(expected[i].b, color.b, tolerance);
+		}
+	}
+
+	TEST(Renderer, WavefrontMatchesTiles) {
+		for (const char* sceneName : { "W3", "ReferenceScene" })
+		{
+			Scene* pScene{ CreateScene(sceneName) };
+			ASSERT_NE(nullptr, pScene);
+			pScene->Initialize();
+
+			// an odd size leaves partial tiles and screen blocks on the edges
+			Renderer renderer{ 123, 77 };
+			renderer.Render(pScene);
+			const std::vector<uint32_t> tiles(renderer.GetPixels(), renderer.GetPixels() + 123 * 77);
+
+			renderer.SetWavefrontEnabled(true);
+			renderer.Render(pScene);
+			const std::vector<uint32_t> wavefront(renderer.GetPixels(), renderer.GetPixels() + 123 * 77);
+
+			EXPECT_EQ(tiles, wavefront) << sceneName;
+			delete pScene;
+		}
+	}
+
+	TEST(Renderer, ShadowCacheKeepsPixels) {
+		Scene* pScene{ CreateScene("ReferenceScene") };
+		ASSERT_NE(nullptr, pScene);
+		pScene->Initialize();
+
+		for (bool isWavefront : { false, true })
+		{
+			Renderer renderer{ 123, 77 };
+			renderer.SetWavefrontEnabled(isWavefront);
+
+			// on by default, neighboring shadow rays mostly hit the occluder of the last one
+			renderer.Render(pScene);
+			const std::vector<uint32_t> cached(renderer.GetPixels(), renderer.GetPixels() + 123 * 77);
+			EXPECT_GT(renderer.GetShadowCacheHitRate(), 0.f) << isWavefront;
+
+			renderer.ToggleShadowCache();
+			renderer.ResetRayCount();
+			renderer.Render(pScene);
+			const std::vector<uint32_t> uncached(renderer.GetPixels(), renderer.GetPixels() + 123 * 77);
+			EXPECT_EQ(0.f, renderer.GetShadowCacheHitRate()) << isWavefront;
+
+			EXPECT_EQ(cached, uncached) << isWavefront;
+		}
+
+		delete pScene;
+	}
+
+	TEST(Renderer, ProgressiveResetsOnChange) {
+		Scene* pScene{ CreateScene("W3") };
+		ASSERT_NE(nullptr, pScene);
+		pScene->Initialize();
+
+		Renderer renderer{ 32, 24 };
+		renderer.Render(pScene);
+		const std::vector<uint32_t> singleSample(renderer.GetPixels(), renderer.GetPixels() + 32 * 24);
+
+		// the first sample goes through the pixel centers, like a frame without accumulation
+		renderer.SetProgressiveEnabled(true);
+		renderer.Render(pScene);
+		EXPECT_EQ(singleSample, std::vector<uint32_t>(renderer.GetPixels(), renderer.GetPixels() + 32 * 24));
+
+		renderer.Render(pScene);
+		renderer.Render(pScene);
+		EXPECT_EQ(3u, renderer.GetSampleCount());
+
+		pScene->GetCamera().origin.x += 1.f;
+		renderer.Render(pScene);
+		EXPECT_EQ(1u, renderer.GetSampleCount());
+
+		renderer.ToggleShadows();
+		renderer.Render(pScene);
+		EXPECT_EQ(1u, renderer.GetSampleCount());
+
+		for (uint32_t frame{ 1 }; frame < Renderer::MaxProgressiveSamples; ++frame)
+		{
+			renderer.Render(pScene);
+			EXPECT_FALSE(renderer.IsIdle());
+		}
+		renderer.Render(pScene);
+		EXPECT_TRUE(renderer.IsIdle());
+		EXPECT_EQ(Renderer::MaxProgressiveSamples, renderer.GetSampleCount());
+
+		delete pScene;
+	}
+
+	TEST(Renderer, AdaptiveAntiAliasingRefinesEdgesOnly) {
+		Scene* pScene{ CreateScene("W4") };
+		ASSERT_NE(nullptr, pScene);
+		pScene->Initialize();
+
+		const auto render = [&](Renderer& renderer, Renderer::AntiAliasingMode mode) {
+			renderer.SetAntiAliasingMode(mode);
+			renderer.ResetRayCount();
+			renderer.Render(pScene);
+			return std::vector<uint32_t>(renderer.GetPixels(), renderer.GetPixels() + 64 * 48);
+			};
+
+		Renderer renderer{ 64, 48 };
+		const std::vector<uint32_t> aliased{ render(renderer, Renderer::AntiAliasingMode::Off) };
+		EXPECT_EQ(0u, renderer.GetSupersampleCount());
+
+		const std::vector<uint32_t> full{ render(renderer, Renderer::AntiAliasingMode::Full) };
+		EXPECT_EQ(64u * 48u * 8u, renderer.GetSupersampleCount());
+
+		const std::vector<uint32_t> adaptive{ render(renderer, Renderer::AntiAliasingMode::Adaptive) };
+		EXPECT_GT(renderer.GetSupersampleCount(), 0u);
+		EXPECT_LT(renderer.GetSupersampleCount(), 64u * 48u * 8u / 2u);
+		EXPECT_NE(aliased, adaptive);
+
+		// the flat areas Adaptive skips are flat in Full as well
+		int maxDifference{};
+		for (size_t i{}; i < full.size(); ++i)
+		{
+			for (uint32_t shift : { 0u, 8u, 16u })
+			{
+				const int difference{ std::abs(int((full[i] >> shift) & 0xFF) - int((adaptive[i] >> shift) & 0xFF)) };
+				maxDifference = std::max(maxDifference, difference);
+			}
+		}
+		EXPECT_LT(maxDifference, 48);
+
+		delete pScene;
+	}
+
+	TEST(Renderer, DynamicResolutionHoldsTarget) {
+		Scene* pScene{ CreateScene("W4") };
+		ASSERT_NE(nullptr, pScene);
+		pScene->Initialize();
+
+		Renderer renderer{ 64, 48 };
+		renderer.Render(pScene);
+		const std::vector<uint32_t> native(renderer.GetPixels(), renderer.GetPixels() + 64 * 48);
+
+		// half the size on both axes, upscaled back to the full output
+		renderer.SetResolutionScale(.5f);
+		EXPECT_EQ(32, renderer.GetRenderWidth());
+		EXPECT_EQ(24, renderer.GetRenderHeight());
+		renderer.Render(pScene);
+		EXPECT_EQ(64, renderer.GetWidth());
+
+		// close on average, only the edges differ much
+		double totalDifference{};
+		for (size_t i{}; i < native.size(); ++i)
+		{
+			for (uint32_t shift : { 0u, 8u, 16u })
+			{
+				totalDifference += std::abs(int((native[i] >> shift) & 0xFF) - int((renderer.GetPixels()[i] >> shift) & 0xFF));
+			}
+		}
+		EXPECT_LT(totalDifference / double(native.size() * 3), 8.0);
+
+		renderer.SetResolutionScale(1.f);
+		renderer.Render(pScene);
+		EXPECT_EQ(native, std::vector<uint32_t>(renderer.GetPixels(), renderer.GetPixels() + 64 * 48));
+
+		// four times over budget halves both axes, well under budget grows back
+		renderer.SetTargetFrameTime(.01f);
+		renderer.UpdateResolutionScale(.04f);
+		EXPECT_FLOAT_EQ(.5f, renderer.GetResolutionScale());
+		for (int frame{}; frame < 20; ++frame)
+		{
+			renderer.UpdateResolutionScale(.002f);
+		}
+		EXPECT_FLOAT_EQ(1.f, renderer.GetResolutionScale());
+
+		renderer.UpdateResolutionScale(1.f);
+		EXPECT_FLOAT_EQ(Renderer::MinResolutionScale, renderer.GetResolutionScale());
+		renderer.SetTargetFrameTime(0.f);
+		EXPECT_FLOAT_EQ(1.f, renderer.GetResolutionScale());
+
+		delete pScene;
+	}
+
+	TEST(Renderer, TonemapsTheLinearFramebuffer) {
+		Scene* pScene{ CreateScene("W2") };
+		ASSERT_NE(nullptr, pScene);
+		pScene->Initialize();
+
+		Renderer renderer{ 64, 48 };
+		renderer.SetProgressiveEnabled(true);
+		renderer.Render(pScene);
+
+		// the lights of W2 saturate the planes, those pixels stay above 1 until they are tonemapped
+		const std::vector<ColorRGB> hdrPixels{ renderer.GetHDRPixels() };
+		ASSERT_EQ(64u * 48u, hdrPixels.size());
+		EXPECT_TRUE(std::any_of(hdrPixels.begin(), hdrPixels.end(), [](const ColorRGB& color) { return std::max(color.r, std::max(color.g, color.b)) > 1.f; }));
+
+		for (Tonemapper tonemapper : { Tonemapper::ACES, Tonemapper::Reinhard })
+		{
+			renderer.SetTonemapper(tonemapper);
+			renderer.SetSRGBEnabled(tonemapper == Tonemapper::ACES);
+
+			// a finished progressive frame is only tonemapped again, not traced
+			for (uint32_t sample{ renderer.GetSampleCount() }; sample < Renderer::MaxProgressiveSamples; ++sample)
+			{
+				renderer.Render(pScene);
+			}
+			renderer.ResetRayCount();
+			renderer.Render(pScene);
+			EXPECT_TRUE(renderer.IsIdle());
+			EXPECT_EQ(0u, renderer.GetRayCount());
+
+			std::vector<uint32_t> expected(hdrPixels.size());
+			ColorUtils::TonemapPixels_Scalar(renderer.GetHDRPixels().data(), expected.data(), expected.size(), tonemapper,
+				renderer.IsSRGBEnabled(), PixelPacking{ 16, 8, 0, 0 });
+			for (size_t i{}; i < expected.size(); ++i)
+			{
+				ASSERT_EQ(expected[i], renderer.GetPixels()[i] & 0xFFFFFF) << i;
+			}
+		}
+
+		delete pScene;
+	}
+
+	TEST(Renderer, StreamedBandsMatchWholeFrame) {
+		Scene* pScene{ CreateScene("ReferenceScene") };
+		ASSERT_NE(nullptr, pScene);
+		pScene->Initialize();
+
+		Renderer whole{ 64, 50 };
+		whole.Render(pScene);
+
+		// 50 rows in bands of 16, the last band only has 2 rows inside the image
+		const std::filesystem::path path{ std::filesystem::temp_directory_path() / "dae_streamed.ppm" };
+		Renderer band{ 64, 16 };
+		ASSERT_TRUE(band.RenderToPPM(pScene, path.string(), 50));
+
+		std::ifstream file{ path, std::ios::binary };
+		std::string magic{};
+		int width{}, height{}, maxValue{};
+		file >> magic >> width >> height >> maxValue;
+		file.get();
+		EXPECT_EQ("P6", magic);
+		EXPECT_EQ(64, width);
+		EXPECT_EQ(50, height);
+
+		std::vector<uint8_t> rgb(64 * 50 * 3);
+		file.read(reinterpret_cast<char*>(rgb.data()), std::streamsize(rgb.size()));
+		ASSERT_TRUE(file);
+		EXPECT_EQ(EOF, file.get());
+
+		for (size_t i{}; i < 64 * 50; ++i)
+		{
+			const uint32_t pixel{ whole.GetPixels()[i] };
+			ASSERT_EQ(uint8_t(pixel >> 16), rgb[i * 3]) << i;
+			ASSERT_EQ(uint8_t(pixel >> 8), rgb[i * 3 + 1]) << i;
+			ASSERT_EQ(uint8_t(pixel), rgb[i * 3 + 2]) << i;
+		}
+
+		file.close();
+		std::filesystem::remove(path);
+		delete pScene;
+	}
+
+	TEST(ImageIO, WritesPNGChunksAndFloatPFM) {
+		Image image{ 5, 3 };
+		for (uint32_t i{}; i < 15; ++i)
+		{
+			image.pixels.emplace_back(float(i) / 14.f, .25f, i % 2 ? 1.5f : -.5f);
+		}
+
+		const auto readFile = [](const std::filesystem::path& path) {
+			std::ifstream file{ path, std::ios::binary };
+			return std::vector<uint8_t>{ std::istreambuf_iterator<char>{ file }, {} };
+			};
+		const auto readBigEndian = [](const uint8_t* pBytes) {
+			return (uint32_t(pBytes[0]) << 24) | (uint32_t(pBytes[1]) << 16) | (uint32_t(pBytes[2]) << 8) | pBytes[3];
+			};
+
+		const std::filesystem::path pngPath{ std::filesystem::temp_directory_path() / "dae_image.png" };
+		for (const ImageFormat format : { ImageFormat::PNG8, ImageFormat::PNG16 })
+		{
+			ASSERT_TRUE(WriteImage(pngPath.string(), image, format));
+			const std::vector<uint8_t> bytes{ readFile(pngPath) };
+			ASSERT_GT(bytes.size(), 8u);
+			EXPECT_EQ(0, std::memcmp(bytes.data(), "\x89PNG\r\n\x1A\n", 8));
+
+			// every chunk's CRC covers its type and data
+			std::vector<std::string> chunkTypes{};
+			for (size_t offset{ 8 }; offset + 12 <= bytes.size();)
+			{
+				const uint32_t length{ readBigEndian(&bytes[offset]) };
+				ASSERT_LE(offset + 12 + length, bytes.size());
+				chunkTypes.emplace_back(reinterpret_cast<const char*>(&bytes[offset + 4]), 4);
+
+				uint32_t crc{ 0xFFFFFFFFu };
+				for (size_t i{ offset + 4 }; i < offset + 8 + length; ++i)
+				{
+					crc ^= bytes[i];
+					for (int k{}; k < 8; ++k)
+						crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+				}
+				EXPECT_EQ(crc ^ 0xFFFFFFFFu, readBigEndian(&bytes[offset + 8 + length])) << chunkTypes.back();
+				offset += 12 + length;
+			}
+			EXPECT_EQ((std::vector<std::string>{ "IHDR", "IDAT", "IEND" }), chunkTypes);
+			EXPECT_EQ(5u, readBigEndian(&bytes[16]));
+			EXPECT_EQ(3u, readBigEndian(&bytes[20]));
+			EXPECT_EQ(format == ImageFormat::PNG16 ? 16 : 8, bytes[24]);
+		}
+		std::filesystem::remove(pngPath);
+
+		// PFM keeps the floats as they are, out of range values included, with the bottom row first
+		const std::filesystem::path pfmPath{ std::filesystem::temp_directory_path() / "dae_image.pfm" };
+		ASSERT_TRUE(WriteImage(pfmPath.string(), image, ImageFormat::PFM));
+		std::ifstream file{ pfmPath, std::ios::binary };
+		std::string magic{};
+		uint32_t width{}, height{};
+		float scale{};
+		file >> magic >> width >> height >> scale;
+		file.get();
+		EXPECT_EQ("PF", magic);
+		EXPECT_EQ(5u, width);
+		EXPECT_EQ(3u, height);
+		EXPECT_LT(scale, 0.f);
+
+		std::vector<float> values(15 * 3);
+		file.read(reinterpret_cast<char*>(values.data()), std::streamsize(values.size() * sizeof(float)));
+		ASSERT_TRUE(file);
+		for (uint32_t y{}; y < 3; ++y)
+		{
+			for (uint32_t x{}; x < 5; ++x)
+			{
+				const ColorRGB& color{ image.pixels[(2 - y) * 5 + x] };
+				EXPECT_EQ(color.r, values[(y * 5 + x) * 3]);
+				EXPECT_EQ(color.g, values[(y * 5 + x) * 3 + 1]);
+				EXPECT_EQ(color.b, values[(y * 5 + x) * 3 + 2]);
+			}
+		}
+		file.close();
+		std::filesystem::remove(pfmPath);
+	}
+
+	TEST(ImageIO, AsyncWriterWritesEverySubmittedFrame) {
+		Scene* pScene{ CreateScene("ReferenceScene") };
+		ASSERT_NE(nullptr, pScene);
+		pScene->Initialize();
+
+		Renderer renderer{ 32, 24 };
+		renderer.Render(pScene);
+		const Image image{ renderer.CaptureImage() };
+		ASSERT_EQ(32u * 24u, image.pixels.size());
+		// the tonemapped floats, the surface holds them rounded to 8 bits
+		EXPECT_EQ(uint8_t(renderer.GetPixels()[0] >> 16), uint8_t(image.pixels[0].r * 255.f + .5f));
+
+		const std::filesystem::path directory{ std::filesystem::temp_directory_path() };
+		std::vector<std::filesystem::path> paths{};
+		{
+			// a queue of one makes Submit wait for the writer
+			AsyncImageWriter writer{ 1 };
+			for (int frame{}; frame < 6; ++frame)
+			{
+				paths.emplace_back(directory / ("dae_async_" + std::to_string(frame) + ".ppm"));
+				writer.Submit(image, paths.back().string(), ImageFormat::PPM);
+			}
+			writer.Submit(image, (directory / "missing_directory" / "frame.ppm").string(), ImageFormat::PPM);
+			writer.Flush();
+
+			EXPECT_EQ(6u, writer.GetWrittenCount());
+			EXPECT_EQ(1u, writer.GetFailedCount());
+			EXPECT_EQ(1u, writer.TakeFailedFileNames().size());
+			EXPECT_TRUE(writer.TakeFailedFileNames().empty());
+		}
+
+		// PPM samples round to the same 8 bit values the renderer wrote
+		std::ifstream file{ paths.back(), std::ios::binary };
+		std::string magic{};
+		int width{}, height{}, maxValue{};
+		file >> magic >> width >> height >> maxValue;
+		file.get();
+		std::vector<uint8_t> rgb(32 * 24 * 3);
+		file.read(reinterpret_cast<char*>(rgb.data()), std::streamsize(rgb.size()));
+		ASSERT_TRUE(file);
+		for (size_t i{}; i < 32 * 24; ++i)
+		{
+			const uint32_t pixel{ renderer.GetPixels()[i] };
+			ASSERT_EQ(uint8_t(pixel >> 16), rgb[i * 3]) << i;
+			ASSERT_EQ(uint8_t(pixel >> 8), rgb[i * 3 + 1]) << i;
+			ASSERT_EQ(uint8_t(pixel), rgb[i * 3 + 2]) << i;
+		}
+		file.close();
+
+		for (const std::filesystem::path& path : paths)
+		{
+			std::filesystem::remove(path);
+		}
+		delete pScene;
+	}
+
+	TEST(MeshIO, LoadsEveryFaceForm) {
+		const std::filesystem::path path{ std::filesystem::temp_directory_path() / "dae_meshio_test.obj" };
+		{
+			std::ofstream file{ path, std::ios::binary };
+			file << "# comment\r\nv 0 0 0\r\nv 1 0 0\r\n  v\t1 1 0 1\nv 0 1 0\n"
+				<< "vt 0 0\nvn 0 0 1\ng quad\nusemtl none\n"
+				<< "f 1/1/1 2/1/1 3/1/1 4/1/1 # quad, two triangles\n"
+				<< "f -4//1 -3//1 -1//1\r\n"
+				<< "s off\nf 1/1 3/1 4/1\n";
+			// a long line the old parser cut off
+			file << "# " << std::string(5000, 'x') << "\nf 2 3 4";
+		}
+
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+		MeshIO::LoadStatistics statistics{};
+		ASSERT_TRUE(MeshIO::LoadOBJ(path.string(), positions, normals, indices, &statistics));
+
+		EXPECT_EQ(4u, positions.size());
+		EXPECT_EQ(Vector3(1.f, 1.f, 0.f), positions[2]);
+		EXPECT_EQ((std::vector<int>{ 0, 1, 2, 0, 2, 3, 0, 1, 3, 0, 2, 3, 1, 2, 3 }), indices);
+		ASSERT_EQ(5u, normals.size());
+		EXPECT_EQ(Vector3::UnitZ, normals[0]);
+		EXPECT_EQ(5u, statistics.triangleCount);
+		EXPECT_EQ(std::filesystem::file_size(path), statistics.byteCount);
+
+		// out of range and malformed faces fail instead of reading past the vertices
+		{
+			std::ofstream file{ path, std::ios::binary };
+			file << "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n";
+		}
+		EXPECT_FALSE(MeshIO::LoadOBJ(path.string(), positions, normals, indices));
+		EXPECT_EQ(4u, positions.size());
+		EXPECT_FALSE(MeshIO::LoadOBJ("does_not_exist.obj", positions, normals, indices));
+
+		std::filesystem::remove(path);
+	}
+
+	TEST(MeshIO, NegativeIndicesAcrossChunks) {
+		// big enough to be split, every face points back over the chunk borders with negative indices
+		const std::filesystem::path path{ std::filesystem::temp_directory_path() / "dae_meshio_chunks.obj" };
+		constexpr int QuadCount{ 40000 };
+		{
+			std::ofstream file{ path, std::ios::binary };
+			for (int quad{}; quad < QuadCount; ++quad)
+			{
+				const float x{ float(quad) };
+				file << "v " << x << " 0 0\nv " << x + 1 << " 0 0\nv " << x + 1 << " 1 0\nv " << x << " 1 0\n";
+				file << "vn 0 0 1\nvt 0.25 0.75\n";
+				file << (quad % 2 ? "f -4/-1/-1 -3/-1/-1 -2/-1/-1 -1/-1/-1\n" : "f -4 -3 -2\nf -4 -2 -1\n");
+			}
+		}
+		ASSERT_GT(std::filesystem::file_size(path), 2u << 20);
+
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+		ASSERT_TRUE(MeshIO::LoadOBJ(path.string(), positions, normals, indices));
+
+		ASSERT_EQ(size_t(QuadCount) * 4, positions.size());
+		ASSERT_EQ(size_t(QuadCount) * 6, indices.size());
+		for (int quad{}; quad < QuadCount; ++quad)
+		{
+			const int first{ quad * 4 };
+			const std::vector<int> expected{ first, first + 1, first + 2, first, first + 2, first + 3 };
+			ASSERT_TRUE(std::equal(expected.begin(), expected.end(), indices.begin() + quad * 6)) << quad;
+		}
+
+		std::filesystem::remove(path);
+	}
+
+	TEST(MeshIO, CacheMatchesParsedMesh) {
+		const std::filesystem::path path{ std::filesystem::temp_directory_path() / "dae_meshio_cache.obj" };
+		const std::string cachePath{ MeshIO::GetMeshCacheFilename(path.string()) };
+		{
+			// a bumpy grid, enough triangles for a BVH of more than one leaf
+			constexpr int GridSize{ 12 };
+			std::ofstream file{ path, std::ios::binary };
+			for (int z{}; z <= GridSize; ++z)
+			{
+				for (int x{}; x <= GridSize; ++x)
+				{
+					file << "v " << x << ' ' << ((x * 7 + z * 3) % 5) * .25f << ' ' << z << "\n";
+				}
+			}
+			for (int z{}; z < GridSize; ++z)
+			{
+				for (int x{}; x < GridSize; ++x)
+				{
+					const int first{ z * (GridSize + 1) + x + 1 };
+					file << "f " << first << ' ' << first + 1 << ' ' << first + GridSize + 2 << ' ' << first + GridSize + 1 << "\n";
+				}
+			}
+		}
+		std::filesystem::remove(cachePath);
+
+		const auto load = [&](TriangleMesh& mesh) {
+			MeshIO::LoadStatistics statistics{};
+			EXPECT_TRUE(MeshIO::LoadInstancedOBJ(path.string(), mesh, &statistics));
+			return statistics.isFromCache;
+			};
+		const auto getBytes = [](const auto& values) {
+			const char* pBytes{ reinterpret_cast<const char*>(values.data()) };
+			return std::string(pBytes, pBytes + values.size() * sizeof(values[0]));
+			};
+		const auto expectSameMesh = [&](const TriangleMesh& expected, const TriangleMesh& actual) {
+			EXPECT_EQ(getBytes(expected.positions), getBytes(actual.positions));
+			EXPECT_EQ(getBytes(expected.normals), getBytes(actual.normals));
+			EXPECT_EQ(expected.indices, actual.indices);
+			EXPECT_EQ(getBytes(expected.bvh.GetNodes()), getBytes(actual.bvh.GetNodes()));
+			EXPECT_EQ(expected.bvh.GetPrimitiveIndices(), actual.bvh.GetPrimitiveIndices());
+			EXPECT_EQ(getBytes(expected.trianglePacks), getBytes(actual.trianglePacks));
+			EXPECT_EQ(expected.leafPackOffsets, actual.leafPackOffsets);
+			EXPECT_EQ(expected.minAABB, actual.minAABB);
+			EXPECT_EQ(expected.maxAABB, actual.maxAABB);
+			};
+
+		// the first load parses and writes the cache, the second one only reads it
+		TriangleMesh parsed{};
+		EXPECT_FALSE(load(parsed));
+		ASSERT_TRUE(std::filesystem::exists(cachePath));
+		ASSERT_FALSE(parsed.bvh.IsEmpty());
+
+		TriangleMesh cached{};
+		EXPECT_TRUE(load(cached));
+		expectSameMesh(parsed, cached);
+
+		// a damaged cache is rebuilt instead of trusted
+		std::filesystem::resize_file(cachePath, std::filesystem::file_size(cachePath) - 100);
+		TriangleMesh rebuilt{};
+		EXPECT_FALSE(load(rebuilt));
+		expectSameMesh(parsed, rebuilt);
+		EXPECT_TRUE(load(rebuilt));
+
+		// so is the cache of an OBJ that changed since
+		{
+			std::ofstream file{ path, std::ios::binary | std::ios::app };
+			file << "v 0 0 0\n";
+		}
+		TriangleMesh changed{};
+		EXPECT_FALSE(load(changed));
+		EXPECT_EQ(parsed.positions.size() + 1, changed.positions.size());
+		EXPECT_TRUE(load(changed));
+
+		std::filesystem::remove(path);
+		std::filesystem::remove(cachePath);
+	}
+
+	TEST(ThreadPool, RunsEveryJobOnce) {
+		ThreadPool pool{ 4 };
+		EXPECT_EQ(4u, pool.GetThreadCount());
+
+		// reused across several calls, like the renderer does every frame
+		for (uint32_t jobCount : { 1u, 7u, 1200u, 0u, 300u })
+		{
+			std::vector<std::atomic<int>> counters(jobCount);
+			pool.ParallelFor(jobCount, [&](uint32_t jobIndex) { ++counters[jobIndex]; });
+
+			for (const std::atomic<int>& counter : counters)
+				EXPECT_EQ(1, counter.load());
+		}
+	}
+
 	int main(int argc, char** argv) {
 		::testing::InitGoogleTest(&argc, argv);
 		return RUN_ALL_TESTS();